@@ -0,0 +1,72 @@
+#include "AllocationCounter.hpp"
+#include <cstdlib>
+#include <new>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    static thread_local size_t sAllocationCount = 0;
+
+    size_t AllocationCounter::count() {
+        return sAllocationCount;
+    }
+
+#if SIMPLEPARSER_COUNT_ALLOCATIONS
+    static void *countedAllocate(size_t size) {
+        ++sAllocationCount;
+        return malloc(size ? size : 1);
+    }
+#endif
+
+}
+
+#if SIMPLEPARSER_COUNT_ALLOCATIONS
+
+// Only the plain and nothrow forms are replaced; the sized and array deletes forward to these
+// by default, and aligned allocations are rare enough not to matter for the count.
+
+void *operator new(std::size_t size) {
+    if (void *memory = simpleparser::countedAllocate(size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    return simpleparser::countedAllocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return simpleparser::countedAllocate(size);
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept {
+    std::free(memory);
+}
+
+#endif
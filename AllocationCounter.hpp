@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Counts heap allocations made by the current thread, so tests and benchmarks can check
+    //! that a hot path doesn't allocate. Counting replaces the global operator new and is only
+    //! compiled in when SIMPLEPARSER_COUNT_ALLOCATIONS is set; otherwise the count stays zero.
+    class AllocationCounter {
+    public:
+        static constexpr bool enabled() {
+#if SIMPLEPARSER_COUNT_ALLOCATIONS
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        //! Allocations made by this thread since it started.
+        static size_t count();
+    };
+
+    //! Measures the allocations made by this thread during its lifetime.
+    class AllocationScope {
+    public:
+        AllocationScope() : mStartCount(AllocationCounter::count()) {}
+
+        size_t count() const { return AllocationCounter::count() - mStartCount; }
+
+    private:
+        size_t mStartCount;
+    };
+
+}
@@ -0,0 +1,167 @@
+#include "AstCache.hpp"
+#include "MappedFile.hpp"
+#include "Parser.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    static constexpr char kEntryMagic[4] = {'S', 'P', 'A', 'C'};
+
+    //! Bump when the layout of entries changes. The FlatAST inside has its own version.
+    static constexpr uint32_t kEntryFormatVersion = 1;
+
+    //! Followed by mDiagnosticsSize bytes of diagnostics and then the serialized FlatAST.
+    struct EntryHeader {
+        char mMagic[4];
+        uint32_t mFormatVersion;
+        uint64_t mSourceSize;
+        uint64_t mKeyHigh;
+        uint64_t mKeyLow;
+        uint64_t mChecksum; // xxHash64 of everything after the header.
+        uint64_t mDiagnosticsSize;
+    };
+
+    static_assert(sizeof(EntryHeader) == 48, "EntryHeader must not contain padding.");
+
+    AstCache::AstCache(const filesystem::path &directory, uint64_t maxSize)
+            : mDirectory(directory), mMaxSize(maxSize) {
+        filesystem::create_directories(mDirectory);
+    }
+
+    ContentHash AstCache::keyFor(string_view source, uint16_t variant) {
+        return ContentHash::of(source, (uint64_t(Parser::kVersion) << 32) | (uint64_t(variant) << 16) | FlatAST::kFormatVersion);
+    }
+
+    filesystem::path AstCache::entryPath(const ContentHash &key) const {
+        // Spread over subdirectories, so none of them gets huge.
+        string name = key.toHex();
+        return mDirectory / name.substr(0, 2) / (name.substr(2) + ".ast");
+    }
+
+    optional<CachedParse> AstCache::find(string_view source, uint16_t variant) const {
+        ContentHash key = keyFor(source, variant);
+        filesystem::path path = entryPath(key);
+        error_code error;
+        if (!filesystem::is_regular_file(path, error)) {
+            ++mMissCount;
+            return nullopt;
+        }
+
+        optional<CachedParse> result;
+        try {
+            MappedFile file(path.string());
+            string_view bytes = file.contents();
+
+            EntryHeader header;
+            if (bytes.size() < sizeof(header)) {
+                throw runtime_error("Truncated cache entry.");
+            }
+            memcpy(&header, bytes.data(), sizeof(header));
+            string_view payload = bytes.substr(sizeof(header));
+            if (memcmp(header.mMagic, kEntryMagic, sizeof(kEntryMagic)) != 0
+                || header.mFormatVersion != kEntryFormatVersion
+                || header.mSourceSize != source.size()
+                || header.mKeyHigh != key.mHigh || header.mKeyLow != key.mLow
+                || header.mDiagnosticsSize > payload.size()
+                || header.mChecksum != xxHash64(payload)) {
+                throw runtime_error("Damaged or foreign cache entry.");
+            }
+
+            result.emplace();
+            result->mDiagnostics.assign(payload.substr(0, header.mDiagnosticsSize));
+            result->mAST = FlatAST::deserialize(payload.substr(header.mDiagnosticsSize));
+        } catch (exception &) {
+            filesystem::remove(path, error);
+            ++mMissCount;
+            return nullopt;
+        }
+
+        // Mark it as recently used for trim().
+        filesystem::last_write_time(path, filesystem::file_time_type::clock::now(), error);
+        ++mHitCount;
+        return result;
+    }
+
+    void AstCache::store(string_view source, const FlatAST &ast, string_view diagnostics, uint16_t variant) const {
+        ContentHash key = keyFor(source, variant);
+        string payload(diagnostics);
+        payload += ast.serialize();
+
+        EntryHeader header;
+        memcpy(header.mMagic, kEntryMagic, sizeof(kEntryMagic));
+        header.mFormatVersion = kEntryFormatVersion;
+        header.mSourceSize = source.size();
+        header.mKeyHigh = key.mHigh;
+        header.mKeyLow = key.mLow;
+        header.mChecksum = xxHash64(payload);
+        header.mDiagnosticsSize = diagnostics.size();
+
+        // Write under a name nobody else uses, then rename, so readers never see half an entry.
+        filesystem::path path = entryPath(key);
+        filesystem::path temporaryPath = path;
+        temporaryPath += "." + to_string(hash<thread::id>()(this_thread::get_id())) + "."
+                         + to_string(chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+        error_code error;
+        filesystem::create_directories(path.parent_path(), error);
+        {
+            ofstream out(temporaryPath, ios::binary | ios::trunc);
+            out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            out.write(payload.data(), streamsize(payload.size()));
+            if (!out) {
+                out.close();
+                filesystem::remove(temporaryPath, error);
+                return;
+            }
+        }
+        filesystem::rename(temporaryPath, path, error);
+        if (error) {
+            filesystem::remove(temporaryPath, error);
+        }
+    }
+
+    void AstCache::trim() const {
+        struct Entry {
+            filesystem::path mPath;
+            uint64_t mSize;
+            filesystem::file_time_type mLastUsed;
+        };
+        vector<Entry> entries;
+        uint64_t totalSize = 0;
+
+        error_code error;
+        for (filesystem::recursive_directory_iterator iterator(mDirectory, error), end; !error && iterator != end;
+             iterator.increment(error)) {
+            if (!iterator->is_regular_file(error) || iterator->path().extension() != ".ast") {
+                continue;
+            }
+            Entry entry{iterator->path(), iterator->file_size(error), iterator->last_write_time(error)};
+            if (!error) {
+                totalSize += entry.mSize;
+                entries.push_back(std::move(entry));
+            }
+        }
+        if (totalSize <= mMaxSize) {
+            return;
+        }
+
+        sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.mLastUsed < b.mLastUsed; });
+        for (const Entry &entry : entries) {
+            if (totalSize <= mMaxSize) {
+                break;
+            }
+            if (filesystem::remove(entry.mPath, error)) {
+                totalSize -= entry.mSize;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "ContentHash.hpp"
+#include "FlatAST.hpp"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! What parsing a source gave, as read back from an AstCache.
+    class CachedParse {
+    public:
+        FlatAST mAST;
+        string mDiagnostics;
+    };
+
+    //! Parse results on disk, keyed by a hash of the source bytes and the parser version, so
+    //! an unchanged file is read back instead of parsed again. Entries carry a checksum, and
+    //! the least recently used ones are deleted when the cache outgrows its size limit.
+    //! Several threads and processes may use the same directory at once.
+    class AstCache {
+    public:
+        static constexpr uint64_t kDefaultMaxSize = uint64_t(1) << 30;
+
+        //! Throws a filesystem_error if directory doesn't exist and can't be created.
+        explicit AstCache(const filesystem::path &directory, uint64_t maxSize = kDefaultMaxSize);
+
+        //! Entries that are damaged or from another version are deleted and count as misses.
+        //! Results of differently processed parses of the same source, e.g. optimized by
+        //! different passes, are told apart by variant.
+        optional<CachedParse> find(string_view source, uint16_t variant = 0) const;
+
+        //! The cache is only an optimization, so failing to write an entry is ignored.
+        void store(string_view source, const FlatAST &ast, string_view diagnostics, uint16_t variant = 0) const;
+
+        //! Deletes the least recently used entries until the rest fit in the size limit.
+        void trim() const;
+
+        size_t hitCount() const { return mHitCount; }
+
+        size_t missCount() const { return mMissCount; }
+
+    private:
+        static ContentHash keyFor(string_view source, uint16_t variant);
+
+        filesystem::path entryPath(const ContentHash &key) const;
+
+        filesystem::path mDirectory;
+        uint64_t mMaxSize;
+        mutable atomic<size_t> mHitCount{0};
+        mutable atomic<size_t> mMissCount{0};
+    };
+
+}
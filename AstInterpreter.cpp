@@ -0,0 +1,236 @@
+#include "AstInterpreter.hpp"
+#include "NativeFunctions.hpp"
+#include "VirtualMachine.hpp"
+#include <stdexcept>
+#include <utility>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    AstInterpreter::AstInterpreter(const map<string, FunctionDefinition> &functions, ostream &out)
+            : mFunctions(functions), mOut(&out) {
+    }
+
+    Value AstInterpreter::run(string_view functionName, span<const Value> arguments) {
+        auto foundFunction = mFunctions.find(string(functionName));
+        if (foundFunction == mFunctions.end()) {
+            throw runtime_error("No function named " + string(functionName) + ".");
+        }
+        const FunctionDefinition &function = foundFunction->second;
+        if (arguments.size() != function.mParameters.size()) {
+            throw runtime_error(function.mName + " takes " + to_string(function.mParameters.size()) + " arguments, not "
+                                + to_string(arguments.size()) + ".");
+        }
+        vector<TypedValue> typedArguments;
+        for (size_t index = 0; index < arguments.size(); ++index) {
+            optional<ValueKind> kind = storageKind(function.mParameters[index].mType.builtin());
+            typedArguments.push_back(TypedValue{kind.value_or(ValueKind::INTEGER), arguments[index]});
+        }
+        mScopes.clear();
+        mCallDepth = 0;
+        return call(function, std::move(typedArguments)).mValue;
+    }
+
+    AstInterpreter::TypedValue AstInterpreter::call(const FunctionDefinition &function, vector<TypedValue> arguments) {
+        if (mCallDepth >= VirtualMachine::kMaxCallDepth) {
+            throw runtime_error("Calls nested too deeply in " + function.mName + ".");
+        }
+        vector<Scope> callerScopes = std::move(mScopes);
+        const FunctionDefinition *caller = mFunction;
+        ++mCallDepth;
+        mFunction = &function;
+        mScopes.assign(1, Scope());
+        for (size_t index = 0; index < arguments.size(); ++index) {
+            const ParameterDefinition &param = function.mParameters[index];
+            mScopes.back()[param.mName] = Variable{param.mType.builtin(), arguments[index]};
+        }
+
+        for (const Statement &statement : function.mStatements) {
+            execute(statement);
+        }
+
+        --mCallDepth;
+        mFunction = caller;
+        mScopes = std::move(callerScopes);
+        return TypedValue{ValueKind::INTEGER, Value::integer(0)};
+    }
+
+    void AstInterpreter::execute(const Statement &statement) {
+        if (statement.mKind == StatementKind::VARIABLE_DECLARATION) {
+            TypedValue value{ValueKind::INTEGER, Value::integer(0)};
+            if (!statement.mParameters.empty()) {
+                value = evaluate(statement.mParameters[0]);
+            }
+            if (!storageKind(statement.mType.builtin())) {
+                fail("Variable " + statement.mName + " has a type that can't hold a value");
+            }
+            value = convertForStorage(value, statement.mType.builtin(), "variable " + statement.mName);
+            mScopes.back()[statement.mName] = Variable{statement.mType.builtin(), value};
+        } else if (statement.mKind == StatementKind::WHILE_LOOP) {
+            while (true) {
+                TypedValue condition = evaluate(statement.mParameters[0]);
+                if (condition.mKind == ValueKind::STRING) {
+                    fail("A string can't be a loop condition");
+                }
+                if ((condition.mKind == ValueKind::DOUBLE) ? condition.mValue.mDouble == 0 : condition.mValue.mInteger == 0) {
+                    break;
+                }
+                mScopes.emplace_back();
+                for (size_t index = 1; index < statement.mParameters.size(); ++index) {
+                    execute(statement.mParameters[index]);
+                }
+                mScopes.pop_back();
+            }
+        } else {
+            evaluate(statement);
+        }
+    }
+
+    AstInterpreter::TypedValue AstInterpreter::evaluate(const Statement &expression) {
+        switch (expression.mKind) {
+            case StatementKind::LITERAL:
+                if (expression.mType.builtin() == DOUBLE) {
+                    return TypedValue{ValueKind::DOUBLE, Value::floating(expression.mDoubleValue)};
+                }
+                if (expression.mType.builtin() == INT32) {
+                    return TypedValue{ValueKind::INTEGER, Value::integer(wrapToInt32(expression.mIntegerValue))};
+                }
+                return TypedValue{ValueKind::STRING, Value::text(&expression.mName)};
+            case StatementKind::VARIABLE_NAME:
+                return findVariable(expression.mName).mValue;
+            case StatementKind::OPERATOR_CALL:
+                return evaluateOperator(expression);
+            case StatementKind::FUNCTION_CALL:
+                return evaluateCall(expression);
+            default:
+                fail(string(sStatementKindStrings[int(expression.mKind)]) + " used as a value");
+        }
+    }
+
+    AstInterpreter::TypedValue AstInterpreter::evaluateOperator(const Statement &expression) {
+        const string &op = expression.mName;
+        if (op == "=") {
+            if (expression.mParameters.size() != 2 || expression.mParameters[0].mKind != StatementKind::VARIABLE_NAME) {
+                fail("Can only assign to a variable");
+            }
+            TypedValue value = evaluate(expression.mParameters[1]);
+            Variable &variable = findVariable(expression.mParameters[0].mName);
+            variable.mValue = convertForStorage(value, variable.mType, "variable " + expression.mParameters[0].mName);
+            return variable.mValue;
+        }
+
+        if (expression.mParameters.size() == 1) {
+            TypedValue operand = evaluate(expression.mParameters[0]);
+            if (operand.mKind == ValueKind::STRING) {
+                fail("A string can't be an operand of '" + op + "'");
+            }
+            if (op == "-") {
+                if (operand.mKind == ValueKind::DOUBLE) {
+                    operand.mValue.mDouble = -operand.mValue.mDouble;
+                } else {
+                    operand.mValue.mInteger = wrapToInt32(-int64_t(operand.mValue.mInteger));
+                }
+            } else if (op != "+") {
+                fail("Unknown unary operator '" + op + "'");
+            }
+            return operand;
+        }
+        if (expression.mParameters.size() != 2) {
+            fail("Operator '" + op + "' with " + to_string(expression.mParameters.size()) + " operands");
+        }
+
+        TypedValue lhs = evaluate(expression.mParameters[0]);
+        TypedValue rhs = evaluate(expression.mParameters[1]);
+        if (lhs.mKind == ValueKind::STRING || rhs.mKind == ValueKind::STRING) {
+            fail("A string can't be an operand of '" + op + "'");
+        }
+        if (lhs.mKind == ValueKind::DOUBLE || rhs.mKind == ValueKind::DOUBLE) {
+            double a = (lhs.mKind == ValueKind::DOUBLE) ? lhs.mValue.mDouble : double(lhs.mValue.mInteger);
+            double b = (rhs.mKind == ValueKind::DOUBLE) ? rhs.mValue.mDouble : double(rhs.mValue.mInteger);
+            if (op == "+") { return TypedValue{ValueKind::DOUBLE, Value::floating(a + b)}; }
+            if (op == "-") { return TypedValue{ValueKind::DOUBLE, Value::floating(a - b)}; }
+            if (op == "*") { return TypedValue{ValueKind::DOUBLE, Value::floating(a * b)}; }
+            if (op == "/") { return TypedValue{ValueKind::DOUBLE, Value::floating(a / b)}; }
+            if (op == "<") { return TypedValue{ValueKind::INTEGER, Value::integer(a < b ? 1 : 0)}; }
+        } else {
+            int64_t a = lhs.mValue.mInteger;
+            int64_t b = rhs.mValue.mInteger;
+            if (op == "+") { return TypedValue{ValueKind::INTEGER, Value::integer(wrapToInt32(a + b))}; }
+            if (op == "-") { return TypedValue{ValueKind::INTEGER, Value::integer(wrapToInt32(a - b))}; }
+            if (op == "*") { return TypedValue{ValueKind::INTEGER, Value::integer(wrapToInt32(a * b))}; }
+            if (op == "/") {
+                return TypedValue{ValueKind::INTEGER, Value::integer(divideIntegers(int32_t(a), int32_t(b), mFunction->mName))};
+            }
+            if (op == "<") { return TypedValue{ValueKind::INTEGER, Value::integer(a < b ? 1 : 0)}; }
+        }
+        fail("Unknown operator '" + op + "'");
+    }
+
+    AstInterpreter::TypedValue AstInterpreter::evaluateCall(const Statement &expression) {
+        auto foundFunction = mFunctions.find(expression.mName);
+        if (foundFunction != mFunctions.end()) {
+            const FunctionDefinition &callee = foundFunction->second;
+            if (callee.mParameters.size() != expression.mParameters.size()) {
+                fail(callee.mName + " takes " + to_string(callee.mParameters.size()) + " arguments, not "
+                     + to_string(expression.mParameters.size()) + ",");
+            }
+            vector<TypedValue> arguments;
+            for (size_t index = 0; index < expression.mParameters.size(); ++index) {
+                arguments.push_back(convertForStorage(evaluate(expression.mParameters[index]), callee.mParameters[index].mType.builtin(),
+                                                      "parameter " + to_string(index + 1) + " of " + callee.mName));
+            }
+            return call(callee, std::move(arguments));
+        }
+
+        const NativeFunction *native = NativeFunction::find(expression.mName);
+        if (!native) {
+            fail("Unknown function " + expression.mName);
+        }
+        if (expression.mParameters.size() < native->mMinimumArgumentCount) {
+            fail(expression.mName + " needs at least " + to_string(native->mMinimumArgumentCount) + " arguments,");
+        }
+        vector<Value> arguments;
+        vector<ValueKind> kinds;
+        for (const Statement &argument : expression.mParameters) {
+            TypedValue value = evaluate(argument);
+            arguments.push_back(value.mValue);
+            kinds.push_back(value.mKind);
+        }
+        return TypedValue{native->mResultKind, native->mCall(arguments, kinds, *mOut)};
+    }
+
+    AstInterpreter::Variable &AstInterpreter::findVariable(string_view name) {
+        for (auto scope = mScopes.rbegin(); scope != mScopes.rend(); ++scope) {
+            auto found = scope->find(name);
+            if (found != scope->end()) {
+                return found->second;
+            }
+        }
+        fail("Unknown variable " + string(name));
+    }
+
+    AstInterpreter::TypedValue AstInterpreter::convertForStorage(TypedValue value, BUILTIN_TYPE type, string_view what) const {
+        optional<ValueKind> storedKind = storageKind(type);
+        if (!storedKind) {
+            fail(string(what) + " has a type that can't hold a value");
+        }
+        if (value.mKind == ValueKind::STRING) {
+            fail("A string can't be stored in " + string(what));
+        }
+        if (value.mKind == ValueKind::INTEGER && *storedKind == ValueKind::DOUBLE) {
+            value = TypedValue{ValueKind::DOUBLE, Value::floating(double(value.mValue.mInteger))};
+        } else if (value.mKind == ValueKind::DOUBLE && *storedKind == ValueKind::INTEGER) {
+            value = TypedValue{ValueKind::INTEGER, Value::integer(doubleToInteger(value.mValue.mDouble))};
+        }
+        if (*storedKind == ValueKind::INTEGER) {
+            value.mValue.mInteger = narrowInteger(type, value.mValue.mInteger);
+        }
+        return value;
+    }
+
+    void AstInterpreter::fail(const string &message) const {
+        throw runtime_error(message + " in function " + mFunction->mName + ".");
+    }
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "FunctionDefinition.hpp"
+#include "Statement.hpp"
+#include "Value.hpp"
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Runs parsed functions by walking their Statement trees, looking up every variable and
+    //! function by name as it goes, the way a first evaluator would. It follows the same rules as
+    //! BytecodeCompiler and VirtualMachine and gives the same output, but it is many times
+    //! slower, and only kept as the baseline simpleparser_bench measures the VirtualMachine
+    //! against. Unlike the compiler, it only notices unknown names when it gets to them.
+    class AstInterpreter {
+    public:
+        //! Native functions like printf write to out. functions must outlive the interpreter.
+        explicit AstInterpreter(const map<string, FunctionDefinition> &functions, ostream &out = cout);
+
+        //! Runs the function with arguments of the kinds of its parameters. Throws a
+        //! runtime_error if the function fails, e.g. divides by zero.
+        Value run(string_view functionName, span<const Value> arguments = {});
+
+    private:
+        class TypedValue {
+        public:
+            ValueKind mKind{ValueKind::INTEGER};
+            Value mValue{};
+        };
+
+        class Variable {
+        public:
+            BUILTIN_TYPE mType{INT32};
+            TypedValue mValue;
+        };
+
+        using Scope = map<string, Variable, less<>>;
+
+        TypedValue call(const FunctionDefinition &function, vector<TypedValue> arguments);
+
+        void execute(const Statement &statement);
+
+        TypedValue evaluate(const Statement &expression);
+
+        TypedValue evaluateOperator(const Statement &expression);
+
+        TypedValue evaluateCall(const Statement &expression);
+
+        Variable &findVariable(string_view name);
+
+        TypedValue convertForStorage(TypedValue value, BUILTIN_TYPE type, string_view what) const;
+
+        [[noreturn]] void fail(const string &message) const;
+
+        const map<string, FunctionDefinition> &mFunctions;
+        ostream *mOut;
+        vector<Scope> mScopes; // Of the running function, innermost last.
+        const FunctionDefinition *mFunction{nullptr};
+        size_t mCallDepth{0};
+    };
+
+}
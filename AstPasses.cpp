@@ -0,0 +1,283 @@
+#include "AstPasses.hpp"
+#include "AstWalker.hpp"
+#include "ConstantValue.hpp"
+#include "Value.hpp"
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Replaces statement with the literal it computes, if its operands are literals already.
+    static bool foldOperator(Statement &statement) {
+        if (statement.mKind != StatementKind::OPERATOR_CALL) {
+            return false;
+        }
+
+        optional<ConstantValue> result;
+        if (statement.mParameters.size() == 2) {
+            optional<ConstantValue> lhs = ConstantValue::of(statement.mParameters[0]);
+            optional<ConstantValue> rhs = ConstantValue::of(statement.mParameters[1]);
+            if (lhs && rhs) {
+                result = ConstantValue::applyBinary(statement.mName, *lhs, *rhs);
+            }
+        } else if (statement.mParameters.size() == 1) {
+            if (optional<ConstantValue> operand = ConstantValue::of(statement.mParameters[0])) {
+                result = ConstantValue::applyUnary(statement.mName, *operand);
+            }
+        }
+        if (!result) {
+            return false;
+        }
+        statement = result->toLiteral();
+        return true;
+    }
+
+    bool ConstantFoldingPass::run(FunctionDefinition &function) const {
+        // Operands are left before the operators that use them, so they're folded first.
+        class Visitor {
+        public:
+            bool mChanged{false};
+
+            void enter(Statement &, size_t) {}
+
+            void leave(Statement &statement, size_t) {
+                mChanged |= foldOperator(statement);
+            }
+        };
+        Visitor visitor;
+        AstWalker<Statement>().walk(function.mStatements, statementChildren, visitor);
+        return visitor.mChanged;
+    }
+
+    //! The declared types of the variables in scope, innermost last, so lookups find the
+    //! declaration that shadows the others.
+    class VariableTypes {
+    public:
+        void declare(string_view name, BUILTIN_TYPE type) { mVariables.emplace_back(name, type); }
+
+        size_t mark() const { return mVariables.size(); }
+
+        void leave(size_t mark) { mVariables.resize(mark); }
+
+        optional<BUILTIN_TYPE> find(string_view name) const {
+            for (auto variable = mVariables.rbegin(); variable != mVariables.rend(); ++variable) {
+                if (variable->first == name) {
+                    return variable->second;
+                }
+            }
+            return nullopt;
+        }
+
+        //! nullopt if it depends on something unknown, like what a function returns.
+        optional<BUILTIN_TYPE> typeOf(const Statement &expression) const {
+            const Statement *assigned = valueOf(expression);
+            if (!assigned) {
+                return nullopt;
+            }
+            if (assigned->mKind != StatementKind::OPERATOR_CALL) {
+                return leafType(*assigned);
+            }
+
+            // Arithmetic is done in INT32 unless some operand is a double, and an operand's own
+            // operands only matter for whether they are. Comparisons are always INT32.
+            BUILTIN_TYPE result = INT32;
+            vector<const Statement *> pending{assigned};
+            while (!pending.empty()) {
+                const Statement *operand = valueOf(*pending.back());
+                pending.pop_back();
+                if (!operand) {
+                    return nullopt;
+                }
+                if (operand->mKind == StatementKind::OPERATOR_CALL) {
+                    if (operand->mName != "<") {
+                        for (const Statement &child : operand->mParameters) {
+                            pending.push_back(&child);
+                        }
+                    }
+                    continue;
+                }
+                optional<BUILTIN_TYPE> operandType = leafType(*operand);
+                if (!operandType) {
+                    return nullopt;
+                }
+                if (*operandType == DOUBLE) {
+                    result = DOUBLE;
+                }
+            }
+            return result;
+        }
+
+    private:
+        //! What an assignment's value is that of, i.e. its target, through any number of
+        //! assignments. nullptr for an assignment without one.
+        static const Statement *valueOf(const Statement &expression) {
+            const Statement *value = &expression;
+            while (value->mKind == StatementKind::OPERATOR_CALL && value->mName == "=") {
+                if (value->mParameters.empty()) {
+                    return nullptr;
+                }
+                value = &value->mParameters[0];
+            }
+            return value;
+        }
+
+        //! The type of anything but an operator.
+        optional<BUILTIN_TYPE> leafType(const Statement &expression) const {
+            switch (expression.mKind) {
+                case StatementKind::LITERAL: {
+                    // Literals of any other type are strings, whatever type they're given.
+                    BUILTIN_TYPE type = expression.mType.builtin();
+                    return (type == INT32 || type == DOUBLE) ? optional(type) : nullopt;
+                }
+                case StatementKind::VARIABLE_NAME:
+                    return find(expression.mName);
+                default:
+                    return nullopt;
+            }
+        }
+
+        vector<pair<string_view, BUILTIN_TYPE>> mVariables;
+    };
+
+    static bool isIntegerLiteral(const Statement &statement, int64_t value) {
+        return statement.mKind == StatementKind::LITERAL && statement.mType.builtin() == INT32 && statement.mIntegerValue == value;
+    }
+
+    static bool isKnownIntegral(const VariableTypes &variables, const Statement &expression) {
+        optional<BUILTIN_TYPE> type = variables.typeOf(expression);
+        return type && storageKind(*type) == ValueKind::INTEGER;
+    }
+
+    //! Whether expression gives a number, so that an identity operator can be dropped without
+    //! changing what the program does. Operators and calls give one or fail by themselves.
+    static bool isKnownNumeric(const VariableTypes &variables, const Statement &expression) {
+        switch (expression.mKind) {
+            case StatementKind::OPERATOR_CALL:
+            case StatementKind::FUNCTION_CALL:
+                return true;
+            case StatementKind::LITERAL:
+            case StatementKind::VARIABLE_NAME: {
+                optional<BUILTIN_TYPE> type = variables.typeOf(expression);
+                return type && storageKind(*type).has_value();
+            }
+            default:
+                return false;
+        }
+    }
+
+    //! Replaces statement with the operand that it leaves unchanged, if there is one.
+    static bool simplifyOperator(const VariableTypes &variables, Statement &statement) {
+        if (statement.mKind != StatementKind::OPERATOR_CALL || statement.mParameters.size() != 2) {
+            return false;
+        }
+
+        const Statement &lhs = statement.mParameters[0];
+        const Statement &rhs = statement.mParameters[1];
+        optional<size_t> kept;
+        if (statement.mName == "*") {
+            if (isIntegerLiteral(rhs, 1) && isKnownNumeric(variables, lhs)) {
+                kept = 0;
+            } else if (isIntegerLiteral(lhs, 1) && isKnownNumeric(variables, rhs)) {
+                kept = 1;
+            }
+        } else if (statement.mName == "/") {
+            if (isIntegerLiteral(rhs, 1) && isKnownNumeric(variables, lhs)) {
+                kept = 0;
+            }
+        } else if (statement.mName == "-") {
+            if (isIntegerLiteral(rhs, 0) && isKnownNumeric(variables, lhs)) {
+                kept = 0;
+            }
+        } else if (statement.mName == "+") {
+            if (isIntegerLiteral(rhs, 0) && isKnownIntegral(variables, lhs)) {
+                kept = 0;
+            } else if (isIntegerLiteral(lhs, 0) && isKnownIntegral(variables, rhs)) {
+                kept = 1;
+            }
+        }
+        if (!kept) {
+            return false;
+        }
+        Statement operand = std::move(statement.mParameters[*kept]);
+        statement = std::move(operand);
+        return true;
+    }
+
+    //! Simplifies statement and everything below it, operands first.
+    static bool simplifyIdentities(const VariableTypes &variables, AstWalker<Statement> &walker, Statement &statement) {
+        class Visitor {
+        public:
+            const VariableTypes &mVariables;
+            bool mChanged{false};
+
+            void enter(Statement &, size_t) {}
+
+            void leave(Statement &operand, size_t) {
+                mChanged |= simplifyOperator(mVariables, operand);
+            }
+        };
+        Visitor visitor{variables};
+        walker.walk(span<Statement>(&statement, 1), statementChildren, visitor);
+        return visitor.mChanged;
+    }
+
+    //! Simplifies statements[first...], keeping track of the variables they declare.
+    static bool simplifyBlock(VariableTypes &variables, AstWalker<Statement> &walker, vector<Statement> &statements, size_t first) {
+        bool changed = false;
+        size_t scope = variables.mark();
+        for (size_t index = first; index < statements.size(); ++index) {
+            Statement &statement = statements[index];
+            if (statement.mKind == StatementKind::WHILE_LOOP && !statement.mParameters.empty()) {
+                changed |= simplifyIdentities(variables, walker, statement.mParameters[0]);
+                changed |= simplifyBlock(variables, walker, statement.mParameters, 1);
+                continue;
+            }
+            changed |= simplifyIdentities(variables, walker, statement);
+            if (statement.mKind == StatementKind::VARIABLE_DECLARATION) {
+                variables.declare(statement.mName, statement.mType.builtin());
+            }
+        }
+        variables.leave(scope);
+        return changed;
+    }
+
+    bool IdentitySimplificationPass::run(FunctionDefinition &function) const {
+        VariableTypes variables;
+        for (const ParameterDefinition &param : function.mParameters) {
+            variables.declare(param.mName, param.mType.builtin());
+        }
+        AstWalker<Statement> walker;
+        return simplifyBlock(variables, walker, function.mStatements, 0);
+    }
+
+    //! Removes dead loops from statements[first...] and from the bodies of the loops that stay.
+    static bool removeDeadLoops(vector<Statement> &statements, size_t first) {
+        bool changed = false;
+        size_t kept = first;
+        for (size_t index = first; index < statements.size(); ++index) {
+            Statement &statement = statements[index];
+            if (statement.mKind == StatementKind::WHILE_LOOP && !statement.mParameters.empty()) {
+                optional<ConstantValue> condition = ConstantValue::of(statement.mParameters[0]);
+                if (condition && condition->isZero()) {
+                    changed = true;
+                    continue;
+                }
+                changed |= removeDeadLoops(statement.mParameters, 1);
+            }
+            if (kept != index) {
+                statements[kept] = std::move(statement);
+            }
+            ++kept;
+        }
+        statements.resize(kept);
+        return changed;
+    }
+
+    bool DeadLoopEliminationPass::run(FunctionDefinition &function) const {
+        return removeDeadLoops(function.mStatements, 0);
+    }
+
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Replaces operators whose operands are all number literals with the literal they
+    //! compute, following ConstantValue's arithmetic. Assignments are never folded.
+    class ConstantFoldingPass : public AstPass {
+    public:
+        string_view name() const override { return "constant-folding"; }
+
+        bool run(FunctionDefinition &function) const override;
+    };
+
+    //! Drops operands that don't change the result: x * 1, 1 * x, x / 1, x - 0, and x + 0 and
+    //! 0 + x where x is known not to be a double (for which -0.0 + 0 is 0.0, not -0.0). Only
+    //! INT32 literals count, since a double 1.0 would also convert x to double.
+    class IdentitySimplificationPass : public AstPass {
+    public:
+        string_view name() const override { return "identity-simplification"; }
+
+        bool run(FunctionDefinition &function) const override;
+    };
+
+    //! Removes while loops whose condition is a literal zero, since their bodies never run.
+    class DeadLoopEliminationPass : public AstPass {
+    public:
+        string_view name() const override { return "dead-loop-elimination"; }
+
+        bool run(FunctionDefinition &function) const override;
+    };
+
+}
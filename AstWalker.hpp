@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Statement.hpp"
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Walks trees depth-first with a stack of its own instead of recursing, so no tree is too
+    //! deep to walk. Works for any node type whose children a function can return as a span,
+    //! e.g. Statement and FlatStatement, const for walks that only read. Keeps its stack between
+    //! walks, so walking many trees with one walker allocates nothing once the deepest has been
+    //! seen.
+    //!
+    //! A node's children have all been left by the time the node is, so leave() may replace
+    //! the node, e.g. with one of its children, as long as it leaves its siblings alone.
+    template<class Node>
+    class AstWalker {
+    public:
+        //! Calls visitor.enter(node, depth) before a node's children and visitor.leave(node, depth)
+        //! after them, for each of roots in order and everything below them. Roots have depth 0.
+        template<class Children, class Visitor>
+        void walk(span<Node> roots, Children &&children, Visitor &&visitor) {
+            mStack.clear();
+            mStack.push_back(Level{roots, 0});
+            while (true) {
+                Level &level = mStack.back();
+                if (level.mNext == level.mNodes.size()) {
+                    mStack.pop_back();
+                    if (mStack.empty()) {
+                        return;
+                    }
+                    const Level &parentLevel = mStack.back();
+                    visitor.leave(parentLevel.mNodes[parentLevel.mNext - 1], mStack.size() - 1);
+                    continue;
+                }
+
+                Node &node = level.mNodes[level.mNext++];
+                size_t depth = mStack.size() - 1;
+                visitor.enter(node, depth);
+                span<Node> nodeChildren = children(node);
+                if (nodeChildren.empty()) {
+                    visitor.leave(node, depth);
+                } else {
+                    mStack.push_back(Level{nodeChildren, 0}); // level is invalid from here on.
+                }
+            }
+        }
+
+    private:
+        //! Siblings being walked, and the index of the one after the current one.
+        struct Level {
+            span<Node> mNodes;
+            size_t mNext{0};
+        };
+
+        vector<Level> mStack;
+    };
+
+    //! The children of a Statement, for AstWalker<Statement> and AstWalker<const Statement>.
+    struct StatementChildren {
+        span<const Statement> operator()(const Statement &statement) const { return statement.mParameters; }
+
+        span<Statement> operator()(Statement &statement) const { return statement.mParameters; }
+    };
+
+    inline constexpr StatementChildren statementChildren;
+
+}
@@ -0,0 +1,285 @@
+#include "AstWriter.hpp"
+
+namespace simpleparser {
+
+    using namespace std;
+
+    static const char *sStatementKindSymbols[] = {
+        "variable-declaration",
+        "function-call",
+        "literal",
+        "operator-call",
+        "variable-name",
+        "while-loop"
+    };
+
+    optional<AstFormat> astFormatNamed(string_view name) {
+        if (name == "pretty") {
+            return AstFormat::PRETTY;
+        } else if (name == "json") {
+            return AstFormat::JSON;
+        } else if (name == "sexpr") {
+            return AstFormat::S_EXPRESSION;
+        }
+        return nullopt;
+    }
+
+    unique_ptr<AstWriter> AstWriter::create(AstFormat format, ostream &out) {
+        switch (format) {
+            case AstFormat::JSON:
+                return make_unique<JsonAstWriter>(out);
+            case AstFormat::S_EXPRESSION:
+                return make_unique<SExpressionAstWriter>(out);
+            case AstFormat::PRETTY:
+                break;
+        }
+        return make_unique<PrettyAstWriter>(out);
+    }
+
+    void AstWriter::write(const map<string, FunctionDefinition> &functions, string_view source) {
+        beginDocument(source);
+        for (const auto &funcPair : functions) {
+            write(funcPair.second);
+        }
+        endDocument();
+        flush();
+    }
+
+    void AstWriter::write(const FunctionDefinition &function) {
+        beginFunction(function.mName, function.mReturnsSomething);
+        for (const ParameterDefinition &param : function.mParameters) {
+            parameter(param.mType.name(), param.mName);
+        }
+        beginBody();
+        writeStatements(function.mStatements);
+        endFunction();
+    }
+
+    void AstWriter::write(const Statement &statement) {
+        writeStatements(span<const Statement>(&statement, 1));
+    }
+
+    void AstWriter::writeStatements(span<const Statement> statements) {
+        class Visitor {
+        public:
+            AstWriter &mWriter;
+
+            void enter(const Statement &statement, size_t) {
+                mWriter.beginStatement(statement.mKind, statement.mType.name(), statement.mName);
+            }
+
+            void leave(const Statement &, size_t) {
+                mWriter.endStatement();
+            }
+        };
+        mWalker.walk(statements, statementChildren, Visitor{*this});
+    }
+
+    void PrettyAstWriter::beginFunction(string_view name, bool returnsSomething) {
+        mOut.write(returnsSomething ? "int " : "void ");
+        mOut.write(name);
+        mOut.write("(\n");
+    }
+
+    void PrettyAstWriter::parameter(string_view typeName, string_view name) {
+        mOut.put('\t');
+        mOut.write(typeName);
+        mOut.put(' ');
+        mOut.write(name);
+        mOut.put('\n');
+    }
+
+    void PrettyAstWriter::beginBody() {
+        mOut.write(") {\n");
+    }
+
+    void PrettyAstWriter::endFunction() {
+        mOut.write("}\n");
+    }
+
+    void PrettyAstWriter::beginStatement(StatementKind kind, string_view typeName, string_view name) {
+        mOut.fill('\t', mIndent);
+        mOut.write(sStatementKindStrings[int(kind)]);
+        mOut.put(' ');
+        mOut.write(typeName);
+        mOut.put(' ');
+        mOut.write(name);
+        mOut.write(" (\n");
+        ++mIndent;
+    }
+
+    void PrettyAstWriter::endStatement() {
+        --mIndent;
+        mOut.fill('\t', mIndent);
+        mOut.write(")\n");
+    }
+
+    void JsonAstWriter::beginDocument(string_view source) {
+        mOut.put('{');
+        if (!source.empty()) {
+            mOut.write("\"source\":");
+            writeString(source);
+            mOut.put(',');
+        }
+        mOut.write("\"functions\":[");
+        mFirstElement = true;
+    }
+
+    void JsonAstWriter::endDocument() {
+        mOut.write("]}\n");
+    }
+
+    void JsonAstWriter::beginFunction(string_view name, bool returnsSomething) {
+        beginElement();
+        mOut.write("{\"name\":");
+        writeString(name);
+        mOut.write(returnsSomething ? ",\"returnsSomething\":true,\"parameters\":[" : ",\"returnsSomething\":false,\"parameters\":[");
+        mFirstElement = true;
+    }
+
+    void JsonAstWriter::parameter(string_view typeName, string_view name) {
+        beginElement();
+        mOut.write("{\"type\":");
+        writeString(typeName);
+        mOut.write(",\"name\":");
+        writeString(name);
+        mOut.put('}');
+    }
+
+    void JsonAstWriter::beginBody() {
+        mOut.write("],\"statements\":[");
+        mFirstElement = true;
+    }
+
+    void JsonAstWriter::endFunction() {
+        mOut.write("]}");
+        mFirstElement = false;
+    }
+
+    void JsonAstWriter::beginStatement(StatementKind kind, string_view typeName, string_view name) {
+        beginElement();
+        mOut.write("{\"kind\":\"");
+        mOut.write(sStatementKindStrings[int(kind)]);
+        mOut.write("\",\"type\":");
+        writeString(typeName);
+        mOut.write(",\"name\":");
+        writeString(name);
+        mOut.write(",\"parameters\":[");
+        mFirstElement = true;
+    }
+
+    void JsonAstWriter::endStatement() {
+        mOut.write("]}");
+        mFirstElement = false;
+    }
+
+    void JsonAstWriter::beginElement() {
+        if (!mFirstElement) {
+            mOut.put(',');
+        }
+        mFirstElement = false;
+    }
+
+    void JsonAstWriter::writeString(string_view text) {
+        static const char *sHexDigits = "0123456789abcdef";
+        mOut.put('"');
+        size_t runStart = 0;
+        for (size_t index = 0; index < text.size(); ++index) {
+            unsigned char ch = uint8_t(text[index]);
+            if (ch >= 0x20 && ch != '"' && ch != '\\') {
+                continue;
+            }
+            mOut.write(text.substr(runStart, index - runStart));
+            runStart = index + 1;
+            mOut.put('\\');
+            switch (ch) {
+                case '"':
+                case '\\':
+                    mOut.put(char(ch));
+                    break;
+                case '\n':
+                    mOut.put('n');
+                    break;
+                case '\r':
+                    mOut.put('r');
+                    break;
+                case '\t':
+                    mOut.put('t');
+                    break;
+                default:
+                    mOut.write("u00");
+                    mOut.put(sHexDigits[ch >> 4]);
+                    mOut.put(sHexDigits[ch & 0xf]);
+                    break;
+            }
+        }
+        mOut.write(text.substr(runStart));
+        mOut.put('"');
+    }
+
+    void SExpressionAstWriter::beginDocument(string_view source) {
+        if (!source.empty()) {
+            mOut.write("; ");
+            mOut.write(source);
+            mOut.put('\n');
+        }
+    }
+
+    void SExpressionAstWriter::beginFunction(string_view name, bool returnsSomething) {
+        mOut.write("(function ");
+        writeString(name);
+        mOut.write(returnsSomething ? " \"int\" (" : " \"void\" (");
+        mFirstParameter = true;
+    }
+
+    void SExpressionAstWriter::parameter(string_view typeName, string_view name) {
+        if (!mFirstParameter) {
+            mOut.put(' ');
+        }
+        mFirstParameter = false;
+        mOut.put('(');
+        writeString(typeName);
+        mOut.put(' ');
+        writeString(name);
+        mOut.put(')');
+    }
+
+    void SExpressionAstWriter::beginBody() {
+        mOut.put(')');
+    }
+
+    void SExpressionAstWriter::endFunction() {
+        mOut.write(")\n");
+    }
+
+    void SExpressionAstWriter::beginStatement(StatementKind kind, string_view typeName, string_view name) {
+        mOut.write(" (");
+        mOut.write(sStatementKindSymbols[int(kind)]);
+        mOut.put(' ');
+        writeString(typeName);
+        mOut.put(' ');
+        writeString(name);
+    }
+
+    void SExpressionAstWriter::endStatement() {
+        mOut.put(')');
+    }
+
+    void SExpressionAstWriter::writeString(string_view text) {
+        mOut.put('"');
+        size_t runStart = 0;
+        for (size_t index = 0; index < text.size(); ++index) {
+            char ch = text[index];
+            if (ch != '"' && ch != '\\' && ch != '\n' && ch != '\r' && ch != '\t') {
+                continue;
+            }
+            mOut.write(text.substr(runStart, index - runStart));
+            runStart = index + 1;
+            mOut.put('\\');
+            mOut.put(ch == '\n' ? 'n' : ch == '\r' ? 'r' : ch == '\t' ? 't' : ch);
+        }
+        mOut.write(text.substr(runStart));
+        mOut.put('"');
+    }
+
+}
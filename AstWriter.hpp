@@ -0,0 +1,163 @@
+#pragma once
+
+#include "AstWalker.hpp"
+#include "FunctionDefinition.hpp"
+#include "OutputBuffer.hpp"
+#include "Statement.hpp"
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    enum class AstFormat {
+        PRETTY, // What debugPrint() prints.
+        JSON,
+        S_EXPRESSION
+    };
+
+    //! "pretty", "json" or "sexpr", or nullopt for anything else.
+    optional<AstFormat> astFormatNamed(string_view name);
+
+    //! Writes parsed functions in some format, through an OutputBuffer, so documents go to the
+    //! stream in large blocks. Trees are walked without recursion, however deep they are.
+    //!
+    //! Subclasses only see a sequence of events, so trees kept in other forms, like a FlatAST,
+    //! can be written by sending the events themselves: beginDocument(), then for each function
+    //! beginFunction(), parameter() for each parameter, beginBody(), beginStatement() and
+    //! endStatement() around each statement's operands, endFunction(), and endDocument().
+    class AstWriter {
+    public:
+        static unique_ptr<AstWriter> create(AstFormat format, ostream &out);
+
+        explicit AstWriter(ostream &out) : mOut(out) {}
+
+        virtual ~AstWriter() = default;
+
+        //! Writes functions as one document and flushes the buffer. source, if given, is what
+        //! they were parsed from, for formats that can say so.
+        void write(const map<string, FunctionDefinition> &functions, string_view source = {});
+
+        //! Writes one function, not as a document of its own, e.g. to print just that.
+        void write(const FunctionDefinition &function);
+
+        //! Writes one statement and its operands, not as a document of its own.
+        void write(const Statement &statement);
+
+        virtual void beginDocument(string_view /*source*/) {}
+
+        virtual void endDocument() {}
+
+        virtual void beginFunction(string_view name, bool returnsSomething) = 0;
+
+        virtual void parameter(string_view typeName, string_view name) = 0;
+
+        virtual void beginBody() = 0;
+
+        virtual void endFunction() = 0;
+
+        virtual void beginStatement(StatementKind kind, string_view typeName, string_view name) = 0;
+
+        virtual void endStatement() = 0;
+
+        void flush() { mOut.flush(); }
+
+    protected:
+        OutputBuffer mOut;
+
+    private:
+        void writeStatements(span<const Statement> statements);
+
+        AstWalker<const Statement> mWalker;
+    };
+
+    //! The indented format debugPrint() has always printed.
+    class PrettyAstWriter : public AstWriter {
+    public:
+        //! Statements start indent tabs in.
+        explicit PrettyAstWriter(ostream &out, size_t indent = 0) : AstWriter(out), mIndent(indent) {}
+
+        void beginFunction(string_view name, bool returnsSomething) override;
+
+        void parameter(string_view typeName, string_view name) override;
+
+        void beginBody() override;
+
+        void endFunction() override;
+
+        void beginStatement(StatementKind kind, string_view typeName, string_view name) override;
+
+        void endStatement() override;
+
+    private:
+        size_t mIndent;
+    };
+
+    //! One JSON object per document, on one line:
+    //! {"source": "...", "functions": [{"name": "...", "returnsSomething": true,
+    //! "parameters": [{"type": "...", "name": "..."}], "statements": [{"kind": "LITERAL",
+    //! "type": "...", "name": "...", "parameters": [...]}]}]}, without the spaces, and "source"
+    //! only if one was given. Names are written byte for byte, with only '"', '\' and control
+    //! characters escaped.
+    class JsonAstWriter : public AstWriter {
+    public:
+        using AstWriter::AstWriter;
+
+        void beginDocument(string_view source) override;
+
+        void endDocument() override;
+
+        void beginFunction(string_view name, bool returnsSomething) override;
+
+        void parameter(string_view typeName, string_view name) override;
+
+        void beginBody() override;
+
+        void endFunction() override;
+
+        void beginStatement(StatementKind kind, string_view typeName, string_view name) override;
+
+        void endStatement() override;
+
+    private:
+        void beginElement();
+
+        void writeString(string_view text);
+
+        bool mFirstElement{true}; // Of the array being written.
+    };
+
+    //! One line per function, (function "name" "int" (("type" "name") ...) statement ...),
+    //! each statement written as (kind "type" "name" operand ...) with the kind in lower case,
+    //! e.g. operator-call. A source is written as a ";" comment line before the functions.
+    class SExpressionAstWriter : public AstWriter {
+    public:
+        using AstWriter::AstWriter;
+
+        void beginDocument(string_view source) override;
+
+        void beginFunction(string_view name, bool returnsSomething) override;
+
+        void parameter(string_view typeName, string_view name) override;
+
+        void beginBody() override;
+
+        void endFunction() override;
+
+        void beginStatement(StatementKind kind, string_view typeName, string_view name) override;
+
+        void endStatement() override;
+
+    private:
+        void writeString(string_view text);
+
+        bool mFirstParameter{true};
+    };
+
+}
@@ -0,0 +1,173 @@
+#include "BatchParser.hpp"
+#include "AllocationCounter.hpp"
+#include <algorithm>
+#include <sstream>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    BatchParser::BatchParser(size_t threadCount)
+            : mScheduler(threadCount) {
+    }
+
+    vector<ParseResult> BatchParser::parse(const vector<string_view> &sources) {
+        vector<ParseResult> results(sources.size());
+
+        size_t totalSize = 0;
+        for (string_view source : sources) {
+            totalSize += source.size();
+        }
+
+        vector<size_t> order;
+        for (size_t index = 0; index < sources.size(); ++index) {
+            bool parsedAlone = (threadCount() > 1 && sources[index].size() > totalSize / threadCount());
+            bool pipelined = (mPipelined && !mKeepTokens && !(ParseStats::enabled() && mCollectStats)
+                              && !AllocationCounter::enabled() && sources[index].size() >= kMinimumPipelinedSize
+                              && (parsedAlone || sources.size() == 1));
+            if (pipelined) {
+                parseOne(sources[index], results[index], nullptr, true);
+            } else if (parsedAlone) {
+                parseOne(sources[index], results[index], &mScheduler);
+            } else {
+                order.push_back(index);
+            }
+        }
+
+        // Start the biggest sources first, so none of them is left to run on its own at the end.
+        stable_sort(order.begin(), order.end(), [&sources](size_t a, size_t b) {
+            return sources[a].size() > sources[b].size();
+        });
+
+        mScheduler.run(order.size(), [&](size_t task) {
+            size_t index = order[task];
+            parseOne(sources[index], results[index], nullptr);
+        });
+        return results;
+    }
+
+    void BatchParser::parseOne(string_view source, ParseResult &result, WorkStealingScheduler *scheduler, bool pipelined) const {
+        ParseStats *stats = (ParseStats::enabled() && mCollectStats) ? &result.mStats : nullptr;
+        if (stats) {
+            stats->mSourceCount = 1;
+        }
+
+        uint16_t cacheVariant = mPasses ? mPasses->cacheVariant() : 0;
+        const AstCache *cache = (mMaxNestingDepth == Parser::kDefaultMaxNestingDepth) ? mCache : nullptr;
+        if (cache && !mKeepTokens) {
+            if (optional<CachedParse> cached = cache->find(source, cacheVariant)) {
+                result.mCachedAST = std::move(cached->mAST);
+                result.mDiagnostics = std::move(cached->mDiagnostics);
+                result.mTokenized = true;
+                if (stats) {
+                    stats->mCachedSourceCount = 1;
+                }
+                return;
+            }
+        }
+
+        ostringstream diagnostics;
+        try {
+            AllocationScope allocations;
+
+            if (pipelined) {
+                parsePipelined(source, result, diagnostics);
+            } else {
+                result.mTokenizer.setCollectErrors(mCollectErrors);
+                {
+                    PhaseTimer timer(stats, ParsePhase::TOKENIZE);
+                    result.mTokens = result.mTokenizer.parse(source);
+                }
+                result.mTokenCount = result.mTokens.size();
+                result.mTokenized = true;
+
+                result.mParser.setDiagnosticStream(diagnostics);
+                result.mParser.setCollectErrors(mCollectErrors);
+                result.mParser.setMaxNestingDepth(mMaxNestingDepth);
+                result.mParser.setStats(stats);
+                PhaseTimer timer(stats, ParsePhase::PARSE);
+                if (scheduler) {
+                    result.mParser.parse(result.mTokens, *scheduler);
+                } else {
+                    result.mParser.parse(result.mTokens);
+                }
+            }
+            result.mParser.setStats(nullptr);
+            result.mParser.setDiagnosticStream(cerr);
+
+            if (mPasses) {
+                PhaseTimer timer(stats, ParsePhase::OPTIMIZE);
+                result.mParser.runPasses(*mPasses);
+            }
+
+            result.mAllocationCount = allocations.count();
+        } catch (exception &err) {
+            result.mParser.setStats(nullptr);
+            result.mParser.setDiagnosticStream(cerr);
+            result.mError = err.what();
+        }
+        if (stats) {
+            stats->countTokens(result.mTokens);
+            stats->countNodes(result.mParser.GetFunctions());
+        }
+        result.mDiagnostics = diagnostics.str();
+        if (mCollectErrors) {
+            // A pipelined parse has put its tokenizer errors here already.
+            result.mErrors.insert(result.mErrors.end(), result.mTokenizer.errors().begin(), result.mTokenizer.errors().end());
+            result.mErrors.insert(result.mErrors.end(), result.mParser.errors().begin(), result.mParser.errors().end());
+            // Line 0 means the end of the input.
+            stable_sort(result.mErrors.begin(), result.mErrors.end(), [](const Diagnostic &a, const Diagnostic &b) {
+                return (a.mLineNumber - 1) < (b.mLineNumber - 1);
+            });
+        }
+        if (!mKeepTokens) {
+            result.mTokens = TokenBuffer();
+        }
+
+        if (cache && result.succeeded()) {
+            cache->store(source, FlatAST(result.mParser.GetFunctions()), result.mDiagnostics, cacheVariant);
+        }
+    }
+
+    void BatchParser::parsePipelined(string_view source, ParseResult &result, ostringstream &diagnostics) const {
+        PipelinedTokenStream tokens(source, mCollectErrors);
+        result.mParser.setDiagnosticStream(diagnostics);
+        result.mParser.setCollectErrors(mCollectErrors);
+        result.mParser.setMaxNestingDepth(mMaxNestingDepth);
+        exception_ptr parseError;
+        try {
+            result.mParser.parse(tokens);
+        } catch (exception &) {
+            parseError = current_exception();
+        }
+
+        try {
+            tokens.finish();
+        } catch (exception &) {
+            // Tokenizing first would have failed before the parser saw anything.
+            result.mParser = Parser();
+            diagnostics.str("");
+            throw;
+        }
+        result.mTokenCount = tokens.tokenCount();
+        result.mTokenized = true;
+        result.mErrors = tokens.errors();
+        if (parseError) {
+            rethrow_exception(parseError);
+        }
+    }
+
+    void ParseResult::debugPrint() const {
+        PrettyAstWriter writer(cout);
+        write(writer);
+    }
+
+    void ParseResult::write(AstWriter &writer, string_view source) const {
+        if (mCachedAST) {
+            mCachedAST->write(writer, source);
+        } else {
+            writer.write(mParser.GetFunctions(), source);
+        }
+    }
+
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "AstCache.hpp"
+#include "AstWriter.hpp"
+#include "PassManager.hpp"
+#include "FlatAST.hpp"
+#include "ParseStats.hpp"
+#include "Parser.hpp"
+#include "Tokenizer.hpp"
+#include "WorkStealingScheduler.hpp"
+#include <cstddef>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Everything that came out of parsing one source of a batch.
+    class ParseResult {
+    public:
+        Parser mParser;
+        optional<FlatAST> mCachedAST; // Set instead of mParser's functions if they came from an AstCache.
+        Tokenizer mTokenizer;
+        TokenBuffer mTokens; // Only kept if the BatchParser was asked to. Points into the source.
+        size_t mTokenCount{0};
+        bool mTokenized{false}; // If not, mError is from the tokenizer.
+        size_t mAllocationCount{0}; // Zero unless AllocationCounter::enabled().
+        ParseStats mStats; // Empty unless ParseStats::enabled() and the BatchParser was asked to collect them.
+        string mDiagnostics; // What the parser reported, in order.
+        string mError; // Why the source couldn't be parsed, if it couldn't.
+        vector<Diagnostic> mErrors; // Syntax errors in source order, if the BatchParser collected them.
+
+        bool succeeded() const { return mError.empty() && mErrors.empty(); }
+
+        //! Prints the functions like Parser::debugPrint(), wherever they came from.
+        void debugPrint() const;
+
+        //! Writes the functions as one document, wherever they came from.
+        void write(AstWriter &writer, string_view source = {}) const;
+    };
+
+    //! Tokenizes and parses many sources at once, one task per source, on a
+    //! WorkStealingScheduler. Sources too big to share a thread with others are parsed one
+    //! at a time with their functions spread over all threads instead. Results come back in
+    //! the order of the sources, so the output doesn't depend on the thread count.
+    class BatchParser {
+    public:
+        //! Smaller sources are never pipelined, as they tokenize in about the time it takes
+        //! to start a thread.
+        static constexpr size_t kMinimumPipelinedSize = 256 * 1024;
+
+        explicit BatchParser(size_t threadCount = thread::hardware_concurrency());
+
+        //! Keep each source's tokens in its result, e.g. to print them. They point into the source text.
+        void setKeepTokens(bool keepTokens) { mKeepTokens = keepTokens; }
+
+        //! Look sources up in cache before parsing them, and store what was parsed. Sources whose
+        //! tokens are kept are always parsed. The cache must outlive the calls to parse().
+        void setCache(const AstCache *cache) { mCache = cache; }
+
+        //! Run passes over each source's functions after parsing them. They must outlive the
+        //! calls to parse().
+        void setPasses(const PassManager *passes) { mPasses = passes; }
+
+        //! Report all syntax errors of each source in its result's mErrors, instead of stopping
+        //! at the first one and putting it in mError.
+        void setCollectErrors(bool collectErrors) { mCollectErrors = collectErrors; }
+
+        //! See Parser::setMaxNestingDepth(). Other limits than the default bypass the cache,
+        //! whose results don't say what limit they were parsed with.
+        void setMaxNestingDepth(size_t depth) { mMaxNestingDepth = depth; }
+
+        //! Parse sources that are parsed one at a time, because they're too big to share a thread
+        //! or the only one, from a PipelinedTokenStream, so they're tokenized on a thread of
+        //! their own while being parsed, instead of first. Their functions aren't spread over the
+        //! threads then. Results are the same either way. Nothing is pipelined while tokens are
+        //! kept, or stats or allocations counted, which need all of a source's tokenizing to
+        //! happen at once on the parsing thread.
+        void setPipelined(bool pipelined) { mPipelined = pipelined; }
+
+        //! Fill each result's mStats. Only has an effect if ParseStats::enabled().
+        void setCollectStats(bool collectStats) { mCollectStats = collectStats; }
+
+        size_t threadCount() const { return mScheduler.threadCount(); }
+
+        //! The sources must outlive the results.
+        vector<ParseResult> parse(const vector<string_view> &sources);
+
+    private:
+        //! With a scheduler, the source's functions are parsed on all of its threads.
+        void parseOne(string_view source, ParseResult &result, WorkStealingScheduler *scheduler, bool pipelined = false) const;
+
+        void parsePipelined(string_view source, ParseResult &result, ostringstream &diagnostics) const;
+
+        WorkStealingScheduler mScheduler;
+        bool mKeepTokens{false};
+        bool mCollectErrors{false};
+        bool mCollectStats{false};
+        bool mPipelined{false};
+        size_t mMaxNestingDepth{Parser::kDefaultMaxNestingDepth};
+        const AstCache *mCache{nullptr};
+        const PassManager *mPasses{nullptr};
+    };
+
+}
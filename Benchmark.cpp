@@ -0,0 +1,330 @@
+#include "AstInterpreter.hpp"
+#include "AstWalker.hpp"
+#include "AstWriter.hpp"
+#include "BytecodeCompiler.hpp"
+#include "JitCompiler.hpp"
+#include "NameResolver.hpp"
+#include "ParseStats.hpp"
+#include "Parser.hpp"
+#include "PassManager.hpp"
+#include "ProgramGenerator.hpp"
+#include "Tokenizer.hpp"
+#include "VirtualMachine.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace simpleparser;
+
+// Microbenchmarks for the tokenizer, parser, passes, bytecode VM and JIT, run on generated
+// programs. Prints one JSON object, so runs on different commits can be compared by a script.
+
+struct BenchmarkOptions {
+    double mMinimumSeconds{0.5}; // Per benchmark.
+    size_t mMinimumIterations{3};
+    string mFilter; // Only run benchmarks whose name contains this.
+    uint64_t mSeed{1};
+};
+
+struct Measurement {
+    size_t mIterations{0};
+    double mTotalSeconds{0};
+    double mFastestSeconds{0};
+};
+
+//! Runs body until both minimums are reached. body returns the seconds that count, so it can
+//! leave setup and cleanup out of the measurement. The minimum time is wall time including the
+//! setup, or a fast body with a slow setup would run for ages.
+static Measurement measure(const BenchmarkOptions &options, const function<double()> &body) {
+    Measurement result;
+    auto start = chrono::steady_clock::now();
+    auto elapsed = [&] { return chrono::duration<double>(chrono::steady_clock::now() - start).count(); };
+    while (result.mIterations < options.mMinimumIterations || elapsed() < options.mMinimumSeconds) {
+        double seconds = body();
+        result.mFastestSeconds = (result.mIterations == 0) ? seconds : min(result.mFastestSeconds, seconds);
+        result.mTotalSeconds += seconds;
+        ++result.mIterations;
+    }
+    return result;
+}
+
+template<class Body>
+static double timed(Body body) {
+    auto start = chrono::steady_clock::now();
+    body();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static size_t countNodes(const map<string, FunctionDefinition> &functions) {
+    class Visitor {
+    public:
+        size_t &mCount;
+
+        void enter(const Statement &, size_t) { ++mCount; }
+
+        void leave(const Statement &, size_t) {}
+    };
+    size_t count = 0;
+    AstWalker<const Statement> walker;
+    for (const auto &funcPair : functions) {
+        count += 1 + funcPair.second.mParameters.size();
+        walker.walk(funcPair.second.mStatements, statementChildren, Visitor{count});
+    }
+    return count;
+}
+
+//! Discards everything, so the writer benchmarks measure the writers rather than a terminal or disk.
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int ch) override { return ch; }
+
+    streamsize xsputn(const char *, streamsize count) override { return count; }
+};
+
+//! to_string() prints six decimals, which rounds the fast benchmarks to zero.
+static string jsonNumber(double value) {
+    ostringstream out;
+    out << setprecision(6) << value;
+    return out.str();
+}
+
+class BenchmarkRunner {
+public:
+    explicit BenchmarkRunner(const BenchmarkOptions &options) : mOptions(options) {}
+
+    //! Runs the tokenizer, parser, pipelined parsing and teardown benchmarks on source.
+    void runAll(const string &workload, const string &source) {
+        Tokenizer tokenizer;
+        TokenBuffer tokens = tokenizer.parse(source);
+        Parser parser;
+        parser.parse(tokens);
+        size_t nodeCount = countNodes(parser.GetFunctions());
+
+        run("tokenize/" + workload, source.size(), tokens.size(), 0, [&] {
+            Tokenizer benchTokenizer;
+            return timed([&] { benchTokenizer.parse(source); });
+        });
+
+        run("parse/" + workload, source.size(), tokens.size(), nodeCount, [&] {
+            Parser benchParser;
+            return timed([&] { benchParser.parse(tokens); });
+        });
+
+        run("pipelined/" + workload, source.size(), tokens.size(), nodeCount, [&] {
+            Parser benchParser;
+            return timed([&] {
+                PipelinedTokenStream stream(source);
+                benchParser.parse(stream);
+                stream.finish();
+            });
+        });
+
+        run("teardown/" + workload, source.size(), tokens.size(), nodeCount, [&] {
+            Parser benchParser;
+            benchParser.parse(tokens);
+            map<string, FunctionDefinition> functions = benchParser.takeFunctions();
+            return timed([&] { functions.clear(); });
+        });
+
+        for (auto [formatName, format] : {pair("pretty", AstFormat::PRETTY), pair("json", AstFormat::JSON),
+                                          pair("sexpr", AstFormat::S_EXPRESSION)}) {
+            run("write-" + string(formatName) + "/" + workload, source.size(), tokens.size(), nodeCount, [&] {
+                NullBuffer nullBuffer;
+                ostream out(&nullBuffer);
+                unique_ptr<AstWriter> writer = AstWriter::create(format, out);
+                return timed([&] { writer->write(parser.GetFunctions()); });
+            });
+        }
+
+        run("optimize/" + workload, source.size(), tokens.size(), nodeCount, [&] {
+            PassManager passes = PassManager::standard();
+            map<string, FunctionDefinition> functions = parser.GetFunctions();
+            return timed([&] { passes.run(functions); });
+        });
+    }
+
+    //! Runs source's main function on the VirtualMachine and on the AstInterpreter, after
+    //! checking that both print the same.
+    void runExecution(const string &workload, const string &source) {
+        Tokenizer tokenizer;
+        TokenBuffer tokens = tokenizer.parse(source);
+        Parser parser;
+        parser.parse(tokens);
+        map<string, FunctionDefinition> functions = parser.takeFunctions();
+        size_t nodeCount = countNodes(functions);
+        vector<Diagnostic> undefinedNames = NameResolver::resolve(functions);
+        if (!undefinedNames.empty()) {
+            throw runtime_error(workload + ": " + undefinedNames[0].mMessage);
+        }
+
+        Program program = BytecodeCompiler::compile(functions);
+        ostringstream vmOutput;
+        VirtualMachine(program, vmOutput).run("main");
+        ostringstream astOutput;
+        AstInterpreter(functions, astOutput).run("main");
+        if (vmOutput.str() != astOutput.str()) {
+            throw runtime_error(workload + " prints " + vmOutput.str() + " on the VirtualMachine but "
+                                + astOutput.str() + " on the AstInterpreter.");
+        }
+        JitCode jit;
+        if (JitCompiler::available()) {
+            jit = JitCompiler::compile(program);
+            ostringstream jitOutput;
+            VirtualMachine machine(program, jitOutput);
+            machine.setJitCode(&jit);
+            machine.run("main");
+            if (jitOutput.str() != vmOutput.str()) {
+                throw runtime_error(workload + " prints " + jitOutput.str() + " with JIT code but " + vmOutput.str()
+                                    + " on the VirtualMachine.");
+            }
+        }
+
+        run("resolve/" + workload, source.size(), tokens.size(), nodeCount, [&] {
+            return timed([&] { NameResolver::resolve(functions); });
+        });
+
+        run("compile/" + workload, source.size(), tokens.size(), nodeCount, [&] {
+            return timed([&] { BytecodeCompiler::compile(functions); });
+        });
+
+        ostream discard(nullptr);
+        run("execute-vm/" + workload, 0, 0, 0, [&] {
+            VirtualMachine machine(program, discard);
+            return timed([&] { machine.run("main"); });
+        });
+
+        run("execute-ast/" + workload, 0, 0, 0, [&] {
+            AstInterpreter interpreter(functions, discard);
+            return timed([&] { interpreter.run("main"); });
+        });
+
+        if (JitCompiler::available()) {
+            run("jit-compile/" + workload, 0, 0, nodeCount, [&] {
+                return timed([&] { JitCompiler::compile(program); });
+            });
+
+            run("execute-jit/" + workload, 0, 0, 0, [&] {
+                VirtualMachine machine(program, discard);
+                machine.setJitCode(&jit);
+                return timed([&] { machine.run("main"); });
+            });
+        }
+    }
+
+    void printJSON(ostream &out) const {
+        out << "{\n  \"benchmarks\": [";
+        for (size_t index = 0; index < mResults.size(); ++index) {
+            out << (index == 0 ? "\n    " : ",\n    ") << mResults[index];
+        }
+        out << "\n  ],\n  \"peak_rss_kb\": " << ParseStats::peakResidentKilobytes() << "\n}\n";
+    }
+
+private:
+    void run(const string &name, size_t byteCount, size_t tokenCount, size_t nodeCount, const function<double()> &body) {
+        if (name.find(mOptions.mFilter) == string::npos) {
+            return;
+        }
+        Measurement measurement = measure(mOptions, body);
+        double seconds = measurement.mTotalSeconds / double(measurement.mIterations);
+
+        string json = "{\"name\": \"" + name + "\"";
+        json += ", \"iterations\": " + to_string(measurement.mIterations);
+        json += ", \"mean_seconds\": " + jsonNumber(seconds);
+        json += ", \"fastest_seconds\": " + jsonNumber(measurement.mFastestSeconds);
+        json += ", \"bytes\": " + to_string(byteCount);
+        json += ", \"tokens\": " + to_string(tokenCount);
+        json += ", \"nodes\": " + to_string(nodeCount);
+        json += ", \"mb_per_second\": " + jsonNumber(double(byteCount) / seconds / 1e6);
+        json += ", \"tokens_per_second\": " + jsonNumber(double(tokenCount) / seconds);
+        json += ", \"ns_per_node\": " + (nodeCount == 0 ? string("null") : jsonNumber(seconds * 1e9 / double(nodeCount)));
+        json += ", \"peak_rss_kb\": " + to_string(ParseStats::peakResidentKilobytes()) + "}";
+        mResults.push_back(std::move(json));
+        cerr << name << ": " << seconds * 1e3 << " ms\n"; // Progress, kept out of the JSON.
+    }
+
+    BenchmarkOptions mOptions;
+    vector<string> mResults;
+};
+
+static void printUsage(ostream &out) {
+    out << "Usage: simpleparser_bench [options]\n\n"
+        << "Prints the results as JSON. Peak RSS is that of the whole run up to each benchmark.\n\n"
+        << "  --filter <text>      Only run benchmarks whose name contains text.\n"
+        << "  --min-time <seconds> Repeat each benchmark at least this long (default 0.5).\n"
+        << "  --seed <n>           Seed for the generated programs (default 1).\n"
+        << "  -h, --help           Show this help.\n";
+}
+
+int main(int argc, const char *argv[]) {
+    BenchmarkOptions options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            string_view argument(argv[i]);
+            if ((argument == "--filter" || argument == "--min-time" || argument == "--seed") && i + 1 < argc) {
+                string value(argv[++i]);
+                if (argument == "--filter") {
+                    options.mFilter = value;
+                } else if (argument == "--min-time") {
+                    options.mMinimumSeconds = stod(value);
+                } else {
+                    options.mSeed = stoull(value);
+                }
+            } else if (argument == "-h" || argument == "--help") {
+                printUsage(cout);
+                return 0;
+            } else {
+                cerr << "Unknown option " << argument << ".\n\n";
+                printUsage(cerr);
+                return 1;
+            }
+        }
+    } catch (exception &err) {
+        cerr << "Error: " << err.what() << endl;
+        return 1;
+    }
+
+    BenchmarkRunner runner(options);
+
+    ProgramGeneratorOptions typical;
+    typical.mSeed = options.mSeed;
+    typical.mFunctionCount = 2000;
+    runner.runAll("typical", ProgramGenerator(typical).generate());
+
+    ProgramGeneratorOptions expressions = typical;
+    expressions.mFunctionCount = 300;
+    expressions.mMaxExpressionDepth = 5;
+    expressions.mMaxExpressionLength = 8;
+    expressions.mWhileLoopShare = 0;
+    runner.runAll("expressions", ProgramGenerator(expressions).generate());
+
+    ProgramGeneratorOptions literals = typical;
+    literals.mIntegerLiteralShare = 0.45;
+    literals.mDoubleLiteralShare = 0.45;
+    literals.mStringLiteralShare = 0.5;
+    runner.runAll("literals", ProgramGenerator(literals).generate());
+
+    ProgramGeneratorOptions comments = typical;
+    comments.mCommentDensity = 0.9;
+    runner.runAll("comments", ProgramGenerator(comments).generate());
+
+    runner.runAll("long-operator-chain", ProgramGenerator::longOperatorChain(5000));
+    runner.runAll("deep-parentheses", ProgramGenerator::deepParentheses(1000));
+    runner.runAll("huge-string-literal", ProgramGenerator::hugeStringLiteral(16 << 20));
+
+    runner.runExecution("arithmetic-loops", ProgramGenerator::arithmeticLoops(2000000));
+    runner.runExecution("call-loop", ProgramGenerator::callLoop(500000));
+
+    runner.printJSON(cout);
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include "Bytecode.hpp"
+#include "NativeFunctions.hpp"
+
+namespace simpleparser {
+
+    using namespace std;
+
+    optional<uint32_t> Program::findFunction(string_view name) const {
+        for (size_t index = 0; index < mFunctions.size(); ++index) {
+            if (mFunctions[index].mName == name) {
+                return uint32_t(index);
+            }
+        }
+        return nullopt;
+    }
+
+    void Program::disassemble(ostream &out) const {
+        for (const CompiledFunction &function : mFunctions) {
+            out << function.mName << ": " << function.mParameterCount << " parameters, " << function.mLocalCount
+                << " locals, stack depth " << function.mMaxStackDepth << "\n";
+            for (size_t index = 0; index < function.mCode.size(); ++index) {
+                uint32_t instruction = function.mCode[index];
+                Opcode opcode = Instruction::opcode(instruction);
+                int32_t operand = Instruction::operand(instruction);
+                out << "\t" << index << "\t" << sOpcodeStrings[size_t(opcode)];
+                switch (opcode) {
+                    case Opcode::PUSH_INTEGER:
+                    case Opcode::PUSH_CONSTANT:
+                    case Opcode::PUSH_STRING:
+                    case Opcode::LOAD:
+                    case Opcode::STORE:
+                        out << " " << operand;
+                        break;
+                    case Opcode::JUMP:
+                    case Opcode::JUMP_IF_NONZERO_I:
+                    case Opcode::JUMP_IF_NONZERO_D:
+                    case Opcode::JUMP_IF_LESS_I:
+                    case Opcode::JUMP_IF_LESS_D:
+                        out << " " << operand << " (to " << int64_t(index) + 1 + operand << ")";
+                        break;
+                    case Opcode::CALL:
+                        out << " " << mFunctions[size_t(operand)].mName;
+                        break;
+                    case Opcode::CALL_NATIVE:
+                        out << " " << mNativeCalls[size_t(operand)].mFunction->mName << " with "
+                            << mNativeCalls[size_t(operand)].mArgumentKinds.size() << " arguments";
+                        break;
+                    default:
+                        break;
+                }
+                out << "\n";
+            }
+        }
+    }
+
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Value.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    class NativeFunction;
+
+    //! Instructions of a stack machine. Each one pops its operands off the stack and pushes its
+    //! result. Arithmetic comes in an _I (INT32) and a _D (double) flavor, picked by the
+    //! compiler, so nothing checks kinds at run time.
+    enum class Opcode : uint8_t {
+        PUSH_INTEGER, // The operand itself.
+        PUSH_CONSTANT, // Program::mConstants[operand].
+        PUSH_STRING, // Program::mStrings[operand].
+        LOAD, // Local slot operand.
+        STORE, // Pops into local slot operand.
+        POP,
+        ADD_I,
+        SUBTRACT_I,
+        MULTIPLY_I,
+        DIVIDE_I,
+        LESS_I,
+        NEGATE_I,
+        ADD_D,
+        SUBTRACT_D,
+        MULTIPLY_D,
+        DIVIDE_D,
+        LESS_D, // Gives an INT32 0 or 1.
+        NEGATE_D,
+        INTEGER_TO_DOUBLE,
+        INTEGER_TO_DOUBLE_BELOW, // Converts the value below the top, for a double on the right of an operator.
+        DOUBLE_TO_INTEGER,
+        WRAP_INT8,
+        WRAP_UINT8,
+        JUMP, // Operand is relative to the next instruction.
+        JUMP_IF_NONZERO_I, // Pops the condition.
+        JUMP_IF_NONZERO_D,
+        JUMP_IF_LESS_I, // Pops two operands and jumps if the first is less, i.e. LESS_I + JUMP_IF_NONZERO_I.
+        JUMP_IF_LESS_D,
+        CALL, // Program::mFunctions[operand]. Its arguments become its first local slots.
+        CALL_NATIVE, // Program::mNativeCalls[operand].
+        RETURN, // Ends the function with 0 as its result, since functions don't return anything else yet.
+        COUNT
+    };
+
+    static const char *sOpcodeStrings[] = {
+        "PUSH_INTEGER",
+        "PUSH_CONSTANT",
+        "PUSH_STRING",
+        "LOAD",
+        "STORE",
+        "POP",
+        "ADD_I",
+        "SUBTRACT_I",
+        "MULTIPLY_I",
+        "DIVIDE_I",
+        "LESS_I",
+        "NEGATE_I",
+        "ADD_D",
+        "SUBTRACT_D",
+        "MULTIPLY_D",
+        "DIVIDE_D",
+        "LESS_D",
+        "NEGATE_D",
+        "INTEGER_TO_DOUBLE",
+        "INTEGER_TO_DOUBLE_BELOW",
+        "DOUBLE_TO_INTEGER",
+        "WRAP_INT8",
+        "WRAP_UINT8",
+        "JUMP",
+        "JUMP_IF_NONZERO_I",
+        "JUMP_IF_NONZERO_D",
+        "JUMP_IF_LESS_I",
+        "JUMP_IF_LESS_D",
+        "CALL",
+        "CALL_NATIVE",
+        "RETURN"
+    };
+
+    //! Instructions are 32 bits: the Opcode in the low byte and a signed 24-bit operand above it.
+    class Instruction {
+    public:
+        static constexpr int32_t kMinOperand = -(1 << 23);
+        static constexpr int32_t kMaxOperand = (1 << 23) - 1;
+
+        static uint32_t encode(Opcode opcode, int32_t operand = 0) { return uint32_t(opcode) | (uint32_t(operand) << 8); }
+
+        static Opcode opcode(uint32_t instruction) { return Opcode(instruction & 0xFF); }
+
+        static int32_t operand(uint32_t instruction) { return int32_t(instruction) >> 8; }
+    };
+
+    class CompiledFunction {
+    public:
+        string mName;
+        uint32_t mParameterCount{0};
+        uint32_t mLocalCount{0}; // Slots for parameters and variables, parameters first.
+        vector<ValueKind> mLocalKinds; // One per slot. Variables only share a slot if they are of the same kind.
+        uint32_t mMaxStackDepth{0}; // Operand stack above the locals, including arguments of calls.
+        vector<uint32_t> mCode;
+    };
+
+    //! A call of a native function, with the kinds of its arguments, which it can't know otherwise.
+    class NativeCall {
+    public:
+        const NativeFunction *mFunction{nullptr};
+        vector<ValueKind> mArgumentKinds;
+    };
+
+    //! What BytecodeCompiler makes of parsed functions, for a VirtualMachine to run. Functions,
+    //! constants and calls are referred to by their index in the vectors here.
+    class Program {
+    public:
+        vector<CompiledFunction> mFunctions;
+        vector<Value> mConstants;
+        vector<ValueKind> mConstantKinds; // One per constant.
+        vector<string> mStrings;
+        vector<NativeCall> mNativeCalls;
+
+        optional<uint32_t> findFunction(string_view name) const;
+
+        //! One instruction per line, for --dump-bytecode.
+        void disassemble(ostream &out) const;
+    };
+
+}
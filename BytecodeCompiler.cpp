@@ -0,0 +1,417 @@
+#include "BytecodeCompiler.hpp"
+#include "NameResolver.hpp"
+#include "NativeFunctions.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! How many values each instruction adds to the stack. Calls are left out, since that depends
+    //! on their argument count.
+    static int64_t stackEffect(Opcode opcode) {
+        switch (opcode) {
+            case Opcode::PUSH_INTEGER:
+            case Opcode::PUSH_CONSTANT:
+            case Opcode::PUSH_STRING:
+            case Opcode::LOAD:
+                return 1;
+            case Opcode::STORE:
+            case Opcode::POP:
+            case Opcode::ADD_I:
+            case Opcode::SUBTRACT_I:
+            case Opcode::MULTIPLY_I:
+            case Opcode::DIVIDE_I:
+            case Opcode::LESS_I:
+            case Opcode::ADD_D:
+            case Opcode::SUBTRACT_D:
+            case Opcode::MULTIPLY_D:
+            case Opcode::DIVIDE_D:
+            case Opcode::LESS_D:
+            case Opcode::JUMP_IF_NONZERO_I:
+            case Opcode::JUMP_IF_NONZERO_D:
+                return -1;
+            case Opcode::JUMP_IF_LESS_I:
+            case Opcode::JUMP_IF_LESS_D:
+                return -2;
+            default:
+                return 0;
+        }
+    }
+
+    Program BytecodeCompiler::compile(const map<string, FunctionDefinition> &functions) {
+        Program program;
+        BytecodeCompiler compiler(program, functions);
+        program.mFunctions.resize(functions.size());
+        size_t index = 0;
+        for (const auto &funcPair : functions) {
+            compiler.compileFunction(funcPair.second, program.mFunctions[index++]);
+        }
+        return program;
+    }
+
+    BytecodeCompiler::BytecodeCompiler(Program &program, const map<string, FunctionDefinition> &functions)
+            : mProgram(program) {
+        mFunctions.reserve(functions.size());
+        for (const auto &funcPair : functions) {
+            mFunctions.push_back(&funcPair.second);
+        }
+    }
+
+    void BytecodeCompiler::compileFunction(const FunctionDefinition &function, CompiledFunction &compiled) {
+        mFunction = &function;
+        mCompiled = &compiled;
+        mStackDepth = 0;
+
+        compiled.mName = function.mName;
+        compiled.mParameterCount = uint32_t(function.mParameters.size());
+        if (function.mSlotCount < function.mParameters.size()) {
+            fail("Names not resolved");
+        }
+        compiled.mLocalCount = function.mSlotCount;
+        compiled.mLocalKinds.assign(function.mSlotCount, ValueKind::INTEGER);
+        for (uint32_t slot = 0; slot < function.mParameters.size(); ++slot) {
+            const ParameterDefinition &param = function.mParameters[slot];
+            setSlotKind(slot, param.mName, param.mType.builtin());
+        }
+        for (const Statement &statement : function.mStatements) {
+            compileStatement(statement);
+        }
+        emit(Opcode::RETURN);
+    }
+
+    void BytecodeCompiler::compileStatement(const Statement &statement) {
+        switch (statement.mKind) {
+            case StatementKind::VARIABLE_DECLARATION: {
+                // The initial value can't see the variable yet, so "int x = x" means an outer x.
+                ValueKind kind = ValueKind::INTEGER;
+                if (statement.mParameters.empty()) {
+                    emit(Opcode::PUSH_INTEGER, 0);
+                } else {
+                    kind = compileExpression(statement.mParameters[0]);
+                }
+                convertForStorage(kind, statement.mType.builtin(), "variable " + statement.mName);
+                setSlotKind(statement.mSymbol, statement.mName, statement.mType.builtin());
+                emit(Opcode::STORE, statement.mSymbol);
+                break;
+            }
+            case StatementKind::WHILE_LOOP:
+                compileWhileLoop(statement);
+                break;
+            default:
+                compileExpression(statement, true);
+                break;
+        }
+    }
+
+    //! The condition goes after the body, so each iteration takes one jump instead of two.
+    void BytecodeCompiler::compileWhileLoop(const Statement &loop) {
+        if (loop.mParameters.empty()) {
+            fail("While loop without a condition");
+        }
+        size_t jumpToCondition = emit(Opcode::JUMP);
+        size_t bodyStart = mCompiled->mCode.size();
+
+        for (size_t index = 1; index < loop.mParameters.size(); ++index) {
+            compileStatement(loop.mParameters[index]);
+        }
+
+        patchJumpHere(jumpToCondition);
+        const Statement &condition = loop.mParameters[0];
+        if (condition.mKind == StatementKind::OPERATOR_CALL && condition.mName == "<" && condition.mParameters.size() == 2) {
+            ValueKind kind = compileOperands(condition);
+            emitJumpTo((kind == ValueKind::DOUBLE) ? Opcode::JUMP_IF_LESS_D : Opcode::JUMP_IF_LESS_I, bodyStart);
+            return;
+        }
+        ValueKind kind = compileExpression(condition);
+        if (kind == ValueKind::STRING) {
+            fail("A string can't be a loop condition");
+        }
+        emitJumpTo((kind == ValueKind::DOUBLE) ? Opcode::JUMP_IF_NONZERO_D : Opcode::JUMP_IF_NONZERO_I, bodyStart);
+    }
+
+    ValueKind BytecodeCompiler::compileExpression(const Statement &expression, bool discardResult) {
+        class Visitor {
+        public:
+            BytecodeCompiler &mCompiler;
+            bool mDiscardResult;
+            ValueKind mKind{ValueKind::INTEGER};
+
+            void enter(const Statement &node, size_t depth) {
+                mCompiler.mOperations.push_back(Operation{&node, depth == 0 && mDiscardResult});
+                mCompiler.beginOperation(mCompiler.mOperations.back());
+            }
+
+            void leave(const Statement &, size_t depth) {
+                ValueKind kind = mCompiler.finishOperation(mCompiler.mOperations.back());
+                mCompiler.mOperations.pop_back();
+                if (depth == 0) {
+                    mKind = kind;
+                } else {
+                    mCompiler.finishOperand(mCompiler.mOperations.back(), kind);
+                }
+            }
+        };
+        auto operands = [](const Statement &node) {
+            if (node.mKind == StatementKind::OPERATOR_CALL && node.mName == "=") {
+                return span<const Statement>(node.mParameters).subspan(1); // The variable isn't read.
+            }
+            if (node.mKind == StatementKind::LITERAL || node.mKind == StatementKind::VARIABLE_NAME) {
+                return span<const Statement>();
+            }
+            return span<const Statement>(node.mParameters);
+        };
+
+        mOperations.clear();
+        mOperandKinds.clear();
+        Visitor visitor{*this, discardResult};
+        mWalker.walk(span<const Statement>(&expression, 1), operands, visitor);
+        return visitor.mKind;
+    }
+
+    void BytecodeCompiler::beginOperation(Operation &operation) {
+        const Statement &expression = *operation.mExpression;
+        operation.mFirstOperandKind = mOperandKinds.size();
+        switch (expression.mKind) {
+            case StatementKind::LITERAL:
+                if (operation.mDiscardResult) {
+                    operation.mKind = ValueKind::INTEGER;
+                    return;
+                }
+                if (expression.mType.builtin() == DOUBLE) {
+                    mProgram.mConstants.push_back(Value::floating(expression.mDoubleValue));
+                    mProgram.mConstantKinds.push_back(ValueKind::DOUBLE);
+                    emit(Opcode::PUSH_CONSTANT, int64_t(mProgram.mConstants.size() - 1));
+                    operation.mKind = ValueKind::DOUBLE;
+                    return;
+                }
+                if (expression.mType.builtin() == INT32) {
+                    int32_t value = wrapToInt32(expression.mIntegerValue);
+                    if (value >= Instruction::kMinOperand && value <= Instruction::kMaxOperand) {
+                        emit(Opcode::PUSH_INTEGER, value);
+                    } else {
+                        mProgram.mConstants.push_back(Value::integer(value));
+                        mProgram.mConstantKinds.push_back(ValueKind::INTEGER);
+                        emit(Opcode::PUSH_CONSTANT, int64_t(mProgram.mConstants.size() - 1));
+                    }
+                    operation.mKind = ValueKind::INTEGER;
+                    return;
+                }
+                mProgram.mStrings.push_back(expression.mName);
+                emit(Opcode::PUSH_STRING, int64_t(mProgram.mStrings.size() - 1));
+                operation.mKind = ValueKind::STRING;
+                return;
+            case StatementKind::VARIABLE_NAME:
+                operation.mKind = variableKind(expression);
+                if (!operation.mDiscardResult) {
+                    emit(Opcode::LOAD, expression.mSymbol);
+                }
+                return;
+            case StatementKind::OPERATOR_CALL:
+                if (expression.mName == "=") {
+                    if (expression.mParameters.size() != 2 || expression.mParameters[0].mKind != StatementKind::VARIABLE_NAME) {
+                        fail("Can only assign to a variable");
+                    }
+                    operation.mKind = variableKind(expression.mParameters[0]);
+                } else if (expression.mParameters.size() != 1 && expression.mParameters.size() != 2) {
+                    fail("Operator '" + expression.mName + "' with " + to_string(expression.mParameters.size()) + " operands");
+                }
+                return;
+            case StatementKind::FUNCTION_CALL: {
+                size_t argumentCount = expression.mParameters.size();
+                uint32_t symbol = expression.mSymbol;
+                if (symbol == Statement::kUnresolved) {
+                    fail("Unknown function " + expression.mName);
+                }
+                if (!(symbol & NameResolver::kNativeFunction)) {
+                    if (symbol >= mFunctions.size()) {
+                        fail("Names not resolved");
+                    }
+                    const FunctionDefinition &callee = *mFunctions[symbol];
+                    if (callee.mParameters.size() != argumentCount) {
+                        fail(callee.mName + " takes " + to_string(callee.mParameters.size()) + " arguments, not "
+                             + to_string(argumentCount) + ",");
+                    }
+                    operation.mCallee = &callee;
+                    return;
+                }
+                const NativeFunction *native = &NativeFunction::all()[symbol & ~NameResolver::kNativeFunction];
+                if (argumentCount < native->mMinimumArgumentCount) {
+                    fail(expression.mName + " needs at least " + to_string(native->mMinimumArgumentCount) + " arguments,");
+                }
+                operation.mNative = native;
+                return;
+            }
+            default:
+                fail(string(sStatementKindStrings[int(expression.mKind)]) + " used as a value");
+        }
+    }
+
+    void BytecodeCompiler::finishOperand(Operation &operation, ValueKind kind) {
+        mOperandKinds.push_back(kind);
+        if (operation.mCallee) {
+            size_t index = mOperandKinds.size() - 1 - operation.mFirstOperandKind;
+            convertForStorage(kind, operation.mCallee->mParameters[index].mType.builtin(),
+                              "parameter " + to_string(index + 1) + " of " + operation.mCallee->mName);
+        }
+    }
+
+    ValueKind BytecodeCompiler::finishOperation(const Operation &operation) {
+        const Statement &expression = *operation.mExpression;
+        span<const ValueKind> operandKinds = span<const ValueKind>(mOperandKinds).subspan(operation.mFirstOperandKind);
+        ValueKind kind = operation.mKind;
+        switch (expression.mKind) {
+            case StatementKind::OPERATOR_CALL:
+                if (expression.mName == "=") {
+                    const Statement &variable = expression.mParameters[0];
+                    convertForStorage(operandKinds[0], variable.mType.builtin(), "variable " + variable.mName);
+                    emit(Opcode::STORE, variable.mSymbol);
+                    if (!operation.mDiscardResult) {
+                        emit(Opcode::LOAD, variable.mSymbol);
+                    }
+                    break;
+                }
+                if (operandKinds.size() == 1) {
+                    kind = operandKinds[0];
+                    if (kind == ValueKind::STRING) {
+                        fail("A string can't be an operand of '" + expression.mName + "'");
+                    }
+                    if (expression.mName == "-") {
+                        emit((kind == ValueKind::DOUBLE) ? Opcode::NEGATE_D : Opcode::NEGATE_I);
+                    } else if (expression.mName != "+") {
+                        fail("Unknown unary operator '" + expression.mName + "'");
+                    }
+                } else {
+                    kind = convertOperands(expression, operandKinds[0], operandKinds[1]);
+                    bool isDouble = (kind == ValueKind::DOUBLE);
+                    if (expression.mName == "+") {
+                        emit(isDouble ? Opcode::ADD_D : Opcode::ADD_I);
+                    } else if (expression.mName == "-") {
+                        emit(isDouble ? Opcode::SUBTRACT_D : Opcode::SUBTRACT_I);
+                    } else if (expression.mName == "*") {
+                        emit(isDouble ? Opcode::MULTIPLY_D : Opcode::MULTIPLY_I);
+                    } else if (expression.mName == "/") {
+                        emit(isDouble ? Opcode::DIVIDE_D : Opcode::DIVIDE_I);
+                    } else if (expression.mName == "<") {
+                        emit(isDouble ? Opcode::LESS_D : Opcode::LESS_I);
+                        kind = ValueKind::INTEGER;
+                    } else {
+                        fail("Unknown operator '" + expression.mName + "'");
+                    }
+                }
+                if (operation.mDiscardResult) {
+                    emit(Opcode::POP);
+                }
+                break;
+            case StatementKind::FUNCTION_CALL:
+                if (operation.mCallee) {
+                    emit(Opcode::CALL, expression.mSymbol);
+                    kind = ValueKind::INTEGER;
+                } else {
+                    NativeCall call;
+                    call.mFunction = operation.mNative;
+                    call.mArgumentKinds.assign(operandKinds.begin(), operandKinds.end());
+                    mProgram.mNativeCalls.push_back(std::move(call));
+                    emit(Opcode::CALL_NATIVE, int64_t(mProgram.mNativeCalls.size() - 1));
+                    kind = operation.mNative->mResultKind;
+                }
+                adjustStackDepth(1 - int64_t(operandKinds.size()));
+                if (operation.mDiscardResult) {
+                    emit(Opcode::POP);
+                }
+                break;
+            default:
+                break;
+        }
+        mOperandKinds.resize(operation.mFirstOperandKind);
+        return kind;
+    }
+
+    ValueKind BytecodeCompiler::compileOperands(const Statement &expression) {
+        ValueKind lhsKind = compileExpression(expression.mParameters[0]);
+        ValueKind rhsKind = compileExpression(expression.mParameters[1]);
+        return convertOperands(expression, lhsKind, rhsKind);
+    }
+
+    ValueKind BytecodeCompiler::convertOperands(const Statement &expression, ValueKind lhsKind, ValueKind rhsKind) {
+        if (lhsKind == ValueKind::STRING || rhsKind == ValueKind::STRING) {
+            fail("A string can't be an operand of '" + expression.mName + "'");
+        }
+        if (lhsKind == rhsKind) {
+            return lhsKind;
+        }
+        emit((lhsKind == ValueKind::INTEGER) ? Opcode::INTEGER_TO_DOUBLE_BELOW : Opcode::INTEGER_TO_DOUBLE);
+        return ValueKind::DOUBLE;
+    }
+
+    void BytecodeCompiler::convertForStorage(ValueKind kind, BUILTIN_TYPE type, string_view what) {
+        optional<ValueKind> storedKind = storageKind(type);
+        if (!storedKind) {
+            fail(string(what) + " has a type that can't hold a value");
+        }
+        if (kind == ValueKind::STRING) {
+            fail("A string can't be stored in " + string(what));
+        }
+        if (kind == ValueKind::INTEGER && *storedKind == ValueKind::DOUBLE) {
+            emit(Opcode::INTEGER_TO_DOUBLE);
+        } else if (kind == ValueKind::DOUBLE && *storedKind == ValueKind::INTEGER) {
+            emit(Opcode::DOUBLE_TO_INTEGER);
+        }
+        if (type == INT8) {
+            emit(Opcode::WRAP_INT8);
+        } else if (type == UINT8) {
+            emit(Opcode::WRAP_UINT8);
+        }
+    }
+
+    void BytecodeCompiler::setSlotKind(uint32_t slot, string_view name, BUILTIN_TYPE type) {
+        optional<ValueKind> kind = storageKind(type);
+        if (!kind) {
+            fail("Variable " + string(name) + " has a type that can't hold a value");
+        }
+        if (slot >= mCompiled->mLocalKinds.size()) {
+            fail("Names not resolved");
+        }
+        mCompiled->mLocalKinds[slot] = *kind;
+    }
+
+    ValueKind BytecodeCompiler::variableKind(const Statement &variable) const {
+        if (variable.mSymbol == Statement::kUnresolved) {
+            fail("Unknown variable " + variable.mName);
+        }
+        return storageKind(variable.mType.builtin()).value_or(ValueKind::INTEGER);
+    }
+
+    size_t BytecodeCompiler::emit(Opcode opcode, int64_t operand) {
+        if (operand < Instruction::kMinOperand || operand > Instruction::kMaxOperand) {
+            fail("Too many constants, variables or instructions");
+        }
+        mCompiled->mCode.push_back(Instruction::encode(opcode, int32_t(operand)));
+        adjustStackDepth(stackEffect(opcode));
+        return mCompiled->mCode.size() - 1;
+    }
+
+    void BytecodeCompiler::patchJumpHere(size_t index) {
+        vector<uint32_t> &code = mCompiled->mCode;
+        int64_t offset = int64_t(code.size()) - int64_t(index + 1);
+        if (offset > Instruction::kMaxOperand) {
+            fail("Loop too long");
+        }
+        code[index] = Instruction::encode(Instruction::opcode(code[index]), int32_t(offset));
+    }
+
+    void BytecodeCompiler::emitJumpTo(Opcode opcode, size_t target) {
+        emit(opcode, int64_t(target) - int64_t(mCompiled->mCode.size() + 1));
+    }
+
+    void BytecodeCompiler::adjustStackDepth(int64_t change) {
+        mStackDepth = uint32_t(int64_t(mStackDepth) + change);
+        mCompiled->mMaxStackDepth = max(mCompiled->mMaxStackDepth, mStackDepth);
+    }
+
+    void BytecodeCompiler::fail(const string &message) const {
+        throw runtime_error(message + " in function " + mFunction->mName + ".");
+    }
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "AstWalker.hpp"
+#include "Bytecode.hpp"
+#include "FunctionDefinition.hpp"
+#include "Statement.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Translates functions bound by NameResolver into a Program, taking variable slots and
+    //! callees from the bindings rather than looking up names. Every operator is resolved to its
+    //! INT32 or double instruction, so the VirtualMachine never looks up a name or checks a kind.
+    //!
+    //! Operators on an INT32 and a double convert the INT32, and storing into a variable or
+    //! parameter converts to its type. Declarations without a value set the variable to 0.
+    //! Calls of functions that don't return anything yet give 0.
+    class BytecodeCompiler {
+    public:
+        //! functions must have been resolved by NameResolver since they last changed. Throws a
+        //! runtime_error naming the function if a name is unresolved, a call has the wrong
+        //! number of arguments, or a string is used as a number.
+        static Program compile(const map<string, FunctionDefinition> &functions);
+
+    private:
+        BytecodeCompiler(Program &program, const map<string, FunctionDefinition> &functions);
+
+        void compileFunction(const FunctionDefinition &function, CompiledFunction &compiled);
+
+        void compileStatement(const Statement &statement);
+
+        void compileWhileLoop(const Statement &loop);
+
+        //! An operator, call or value in the expression being compiled, whose operands have been
+        //! compiled up to now.
+        struct Operation {
+            const Statement *mExpression;
+            bool mDiscardResult;
+            ValueKind mKind{ValueKind::INTEGER}; // What a value or assignment gives.
+            const FunctionDefinition *mCallee{nullptr}; // Unless it's a native or no call.
+            const NativeFunction *mNative{nullptr};
+            size_t mFirstOperandKind{0}; // Index in mOperandKinds.
+        };
+
+        //! Leaves nothing on the stack if discardResult, else the value, whose kind is returned.
+        //! Walks the expression rather than recursing, since operator chains nest as deep as
+        //! they're long.
+        ValueKind compileExpression(const Statement &expression, bool discardResult = false);
+
+        //! Checks the node of operation and emits what goes before its operands. Values have none.
+        void beginOperation(Operation &operation);
+
+        //! Emits what goes after each operand, whose value is of kind.
+        void finishOperand(Operation &operation, ValueKind kind);
+
+        //! Emits what goes after the last operand, and returns the kind of the result.
+        ValueKind finishOperation(const Operation &operation);
+
+        //! Both operands of a binary operator, converted to the same kind, which is returned.
+        ValueKind compileOperands(const Statement &expression);
+
+        //! Converts the operands on the stack, of lhsKind and rhsKind, to the same kind.
+        ValueKind convertOperands(const Statement &expression, ValueKind lhsKind, ValueKind rhsKind);
+
+        //! Converts the value of kind on top of the stack to what a variable of type holds.
+        void convertForStorage(ValueKind kind, BUILTIN_TYPE type, string_view what);
+
+        //! Records what the slot of the variable or parameter name holds.
+        void setSlotKind(uint32_t slot, string_view name, BUILTIN_TYPE type);
+
+        //! What the VARIABLE_NAME variable holds, per its resolved type.
+        ValueKind variableKind(const Statement &variable) const;
+
+        size_t emit(Opcode opcode, int64_t operand = 0);
+
+        //! Points the jump at index to the next instruction to be emitted.
+        void patchJumpHere(size_t index);
+
+        void emitJumpTo(Opcode opcode, size_t target);
+
+        void adjustStackDepth(int64_t change);
+
+        [[noreturn]] void fail(const string &message) const;
+
+        Program &mProgram;
+        vector<const FunctionDefinition *> mFunctions; // By function ID.
+        const FunctionDefinition *mFunction{nullptr};
+        CompiledFunction *mCompiled{nullptr};
+        uint32_t mStackDepth{0};
+        AstWalker<const Statement> mWalker;
+        vector<Operation> mOperations; // From the root of the expression to the current node.
+        vector<ValueKind> mOperandKinds; // Of the operands compiled so far, per operation.
+    };
+
+}
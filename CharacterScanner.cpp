@@ -0,0 +1,123 @@
+#include "CharacterScanner.hpp"
+#include "CharacterScannerKernels.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIMPLEPARSER_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace simpleparser {
+
+    using namespace std;
+
+    namespace {
+
+        template<uint32_t runClasses>
+        const char *skipRunScalar(const char *start, const char *end) {
+            while (start < end && ((runClasses >> sCharacterClasses[uint8_t(*start)]) & 1) != 0) {
+                ++start;
+            }
+            return start;
+        }
+
+        constexpr uint32_t kSpaceRun = 1 << SPACE_CHARACTER;
+        constexpr uint32_t kDigitRun = 1 << DIGIT_CHARACTER;
+        constexpr uint32_t kIdentifierRun = (1 << IDENTIFIER_CHARACTER) | (1 << DIGIT_CHARACTER);
+        constexpr uint32_t kCommentRun = ~uint32_t(1 << NEWLINE_CHARACTER);
+        constexpr uint32_t kStringRun = kCommentRun & ~uint32_t((1 << QUOTE_CHARACTER) | (1 << BACKSLASH_CHARACTER));
+
+        template<CharacterScanner::SkipFunction skipBlocks, uint32_t runClasses>
+        const char *skipRun(const char *start, const char *end) {
+            return skipRunScalar<runClasses>(skipBlocks(start, end), end);
+        }
+
+        const CharacterScanner sScalarScanner{
+            ScannerKind::SCALAR,
+            skipRunScalar<kSpaceRun>,
+            skipRunScalar<kDigitRun>,
+            skipRunScalar<kIdentifierRun>,
+            skipRunScalar<kStringRun>,
+            skipRunScalar<kCommentRun>
+        };
+
+#if SIMPLEPARSER_HAVE_SSE2
+        struct Sse2Vector {
+            using Type = __m128i;
+            static constexpr size_t kWidth = 16;
+            static constexpr uint32_t kAllBits = 0xffff;
+
+            static Type load(const char *start) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(start)); }
+            static Type equals(Type block, char ch) { return _mm_cmpeq_epi8(block, _mm_set1_epi8(ch)); }
+            static Type either(Type a, Type b) { return _mm_or_si128(a, b); }
+            static uint32_t bits(Type block) { return uint32_t(_mm_movemask_epi8(block)); }
+
+            //! Unsigned lo <= byte <= hi, via (byte - lo) == min(byte - lo, hi - lo).
+            static Type inRange(Type block, char lo, char hi) {
+                Type shifted = _mm_sub_epi8(block, _mm_set1_epi8(lo));
+                return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(char(hi - lo))), shifted);
+            }
+        };
+
+        const CharacterScanner sSse2Scanner{
+            ScannerKind::SSE2,
+            skipRun<skipBlocks<Sse2Vector, spaceStops<Sse2Vector>>, kSpaceRun>,
+            skipRun<skipBlocks<Sse2Vector, digitStops<Sse2Vector>>, kDigitRun>,
+            skipRun<skipBlocks<Sse2Vector, identifierStops<Sse2Vector>>, kIdentifierRun>,
+            skipRun<skipBlocks<Sse2Vector, stringStops<Sse2Vector>>, kStringRun>,
+            skipRun<skipBlocks<Sse2Vector, commentStops<Sse2Vector>>, kCommentRun>
+        };
+#endif
+
+#if SIMPLEPARSER_HAVE_AVX2_KERNELS
+        const CharacterScanner sAvx2Scanner{
+            ScannerKind::AVX2,
+            skipRun<skipSpacesAVX2, kSpaceRun>,
+            skipRun<skipDigitsAVX2, kDigitRun>,
+            skipRun<skipIdentifierBodyAVX2, kIdentifierRun>,
+            skipRun<skipStringBodyAVX2, kStringRun>,
+            skipRun<skipCommentBodyAVX2, kCommentRun>
+        };
+
+        bool cpuSupportsAVX2() {
+#if defined(_MSC_VER)
+            int registers[4];
+            __cpuidex(registers, 7, 0);
+            return (registers[1] & (1 << 5)) != 0;
+#else
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+
+    }
+
+    const CharacterScanner *CharacterScanner::forKind(ScannerKind kind) {
+        switch (kind) {
+            case ScannerKind::SCALAR:
+                return &sScalarScanner;
+#if SIMPLEPARSER_HAVE_SSE2
+            case ScannerKind::SSE2:
+                return &sSse2Scanner;
+#endif
+#if SIMPLEPARSER_HAVE_AVX2_KERNELS
+            case ScannerKind::AVX2:
+                return cpuSupportsAVX2() ? &sAvx2Scanner : nullptr;
+#endif
+            default:
+                return nullptr;
+        }
+    }
+
+    const CharacterScanner &CharacterScanner::best() {
+        static const CharacterScanner &sBest = []() -> const CharacterScanner & {
+            for (ScannerKind kind : {ScannerKind::AVX2, ScannerKind::SSE2}) {
+                if (const CharacterScanner *scanner = forKind(kind)) {
+                    return *scanner;
+                }
+            }
+            return sScalarScanner;
+        }();
+        return sBest;
+    }
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    enum CharacterClass : uint8_t {
+        IDENTIFIER_CHARACTER, // Anything not listed below starts or continues an identifier.
+        DIGIT_CHARACTER,
+        PERIOD_CHARACTER,
+        OPERATOR_CHARACTER,
+        SPACE_CHARACTER,
+        NEWLINE_CHARACTER,
+        QUOTE_CHARACTER,
+        BACKSLASH_CHARACTER,
+        SLASH_CHARACTER
+    };
+
+    constexpr array<CharacterClass, 256> makeCharacterClassTable() {
+        array<CharacterClass, 256> table{};
+        for (char ch = '0'; ch <= '9'; ++ch) {
+            table[uint8_t(ch)] = DIGIT_CHARACTER;
+        }
+        for (char ch : string_view("{}()=+-*<;,")) {
+            table[uint8_t(ch)] = OPERATOR_CHARACTER;
+        }
+        table[uint8_t('.')] = PERIOD_CHARACTER;
+        table[uint8_t(' ')] = SPACE_CHARACTER;
+        table[uint8_t('\t')] = SPACE_CHARACTER;
+        table[uint8_t('\r')] = NEWLINE_CHARACTER;
+        table[uint8_t('\n')] = NEWLINE_CHARACTER;
+        table[uint8_t('"')] = QUOTE_CHARACTER;
+        table[uint8_t('\\')] = BACKSLASH_CHARACTER;
+        table[uint8_t('/')] = SLASH_CHARACTER;
+        return table;
+    }
+
+    inline constexpr array<CharacterClass, 256> sCharacterClasses = makeCharacterClassTable();
+
+    enum class ScannerKind {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    //! Finds the ends of runs of characters the tokenizer would otherwise look at one by one.
+    //! Each function returns the first position in [start, end) that does not continue the run,
+    //! or end if the whole range does.
+    class CharacterScanner {
+    public:
+        using SkipFunction = const char *(*)(const char *start, const char *end);
+
+        ScannerKind mKind;
+        SkipFunction mSkipSpaces;
+        SkipFunction mSkipDigits;
+        SkipFunction mSkipIdentifierBody;
+        SkipFunction mSkipStringBody; // Stops at '"', '\\' and line breaks.
+        SkipFunction mSkipCommentBody; // Stops at line breaks.
+
+        //! The widest implementation this CPU supports, picked once at runtime.
+        static const CharacterScanner &best();
+
+        //! nullptr if this build or CPU does not support the given kind.
+        static const CharacterScanner *forKind(ScannerKind kind);
+    };
+
+}
@@ -0,0 +1,48 @@
+// Compiled with AVX2 enabled; only called after CharacterScanner has checked the CPU supports it.
+
+#include "CharacterScannerKernels.hpp"
+#include <immintrin.h>
+
+namespace simpleparser {
+
+    namespace {
+
+        struct Avx2Vector {
+            using Type = __m256i;
+            static constexpr size_t kWidth = 32;
+            static constexpr uint32_t kAllBits = 0xffffffff;
+
+            static Type load(const char *start) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(start)); }
+            static Type equals(Type block, char ch) { return _mm256_cmpeq_epi8(block, _mm256_set1_epi8(ch)); }
+            static Type either(Type a, Type b) { return _mm256_or_si256(a, b); }
+            static uint32_t bits(Type block) { return uint32_t(_mm256_movemask_epi8(block)); }
+
+            static Type inRange(Type block, char lo, char hi) {
+                Type shifted = _mm256_sub_epi8(block, _mm256_set1_epi8(lo));
+                return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(char(hi - lo))), shifted);
+            }
+        };
+
+    }
+
+    const char *skipSpacesAVX2(const char *start, const char *end) {
+        return skipBlocks<Avx2Vector, spaceStops<Avx2Vector>>(start, end);
+    }
+
+    const char *skipDigitsAVX2(const char *start, const char *end) {
+        return skipBlocks<Avx2Vector, digitStops<Avx2Vector>>(start, end);
+    }
+
+    const char *skipIdentifierBodyAVX2(const char *start, const char *end) {
+        return skipBlocks<Avx2Vector, identifierStops<Avx2Vector>>(start, end);
+    }
+
+    const char *skipStringBodyAVX2(const char *start, const char *end) {
+        return skipBlocks<Avx2Vector, stringStops<Avx2Vector>>(start, end);
+    }
+
+    const char *skipCommentBodyAVX2(const char *start, const char *end) {
+        return skipBlocks<Avx2Vector, commentStops<Avx2Vector>>(start, end);
+    }
+
+}
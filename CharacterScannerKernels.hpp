@@ -0,0 +1,86 @@
+#pragma once
+
+// Block-at-a-time scanning loops shared by the SSE2 and AVX2 kernels. This header is
+// included by translation units compiled with different instruction sets, so everything
+// in it has internal linkage to keep the linker from mixing up the copies.
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace simpleparser {
+
+    const char *skipSpacesAVX2(const char *start, const char *end);
+    const char *skipDigitsAVX2(const char *start, const char *end);
+    const char *skipIdentifierBodyAVX2(const char *start, const char *end);
+    const char *skipStringBodyAVX2(const char *start, const char *end);
+    const char *skipCommentBodyAVX2(const char *start, const char *end);
+
+    namespace {
+
+        inline uint32_t countTrailingZeros(uint32_t bits) {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, bits);
+            return uint32_t(index);
+#else
+            return uint32_t(__builtin_ctz(bits));
+#endif
+        }
+
+        // The stop masks below have a bit set for every byte that ends the run.
+
+        template<class Vector>
+        uint32_t spaceStops(typename Vector::Type block) {
+            return ~Vector::bits(Vector::either(Vector::equals(block, ' '), Vector::equals(block, '\t')))
+                   & Vector::kAllBits;
+        }
+
+        template<class Vector>
+        uint32_t digitStops(typename Vector::Type block) {
+            return ~Vector::bits(Vector::inRange(block, '0', '9')) & Vector::kAllBits;
+        }
+
+        template<class Vector>
+        uint32_t identifierStops(typename Vector::Type block) {
+            // "()*+,-./" and ";<=" are contiguous in ASCII, as are '\t' and '\n'.
+            typename Vector::Type stops = Vector::either(Vector::inRange(block, '(', '/'),
+                                                         Vector::inRange(block, ';', '='));
+            stops = Vector::either(stops, Vector::inRange(block, '\t', '\n'));
+            stops = Vector::either(stops, Vector::either(Vector::equals(block, '\r'), Vector::equals(block, ' ')));
+            stops = Vector::either(stops, Vector::either(Vector::equals(block, '"'), Vector::equals(block, '\\')));
+            stops = Vector::either(stops, Vector::either(Vector::equals(block, '{'), Vector::equals(block, '}')));
+            return Vector::bits(stops);
+        }
+
+        template<class Vector>
+        uint32_t stringStops(typename Vector::Type block) {
+            return Vector::bits(Vector::either(Vector::either(Vector::equals(block, '"'), Vector::equals(block, '\\')),
+                                               Vector::either(Vector::equals(block, '\r'), Vector::equals(block, '\n'))));
+        }
+
+        template<class Vector>
+        uint32_t commentStops(typename Vector::Type block) {
+            return Vector::bits(Vector::either(Vector::equals(block, '\r'), Vector::equals(block, '\n')));
+        }
+
+        //! Returns the first stop in the whole blocks of [start, end), or the start of the
+        //! trailing partial block, which the caller finishes with the scalar loop.
+        template<class Vector, uint32_t (*stopMask)(typename Vector::Type)>
+        const char *skipBlocks(const char *start, const char *end) {
+            while (end - start >= ptrdiff_t(Vector::kWidth)) {
+                uint32_t stops = stopMask(Vector::load(start));
+                if (stops != 0) {
+                    return start + countTrailingZeros(stops);
+                }
+                start += Vector::kWidth;
+            }
+            return start;
+        }
+
+    }
+
+}
@@ -0,0 +1,114 @@
+#include "ConstantValue.hpp"
+#include "Value.hpp"
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <string>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    ConstantValue ConstantValue::integer(int32_t value) {
+        ConstantValue result;
+        result.mType = INT32;
+        result.mInteger = value;
+        return result;
+    }
+
+    ConstantValue ConstantValue::floating(double value) {
+        ConstantValue result;
+        result.mType = DOUBLE;
+        result.mDouble = value;
+        return result;
+    }
+
+    optional<ConstantValue> ConstantValue::of(const Statement &statement) {
+        if (statement.mKind != StatementKind::LITERAL) {
+            return nullopt;
+        }
+        if (statement.mType.builtin() == DOUBLE) {
+            return floating(statement.mDoubleValue);
+        }
+        if (statement.mType.builtin() == INT32 && statement.mIntegerValue >= numeric_limits<int32_t>::min()
+            && statement.mIntegerValue <= numeric_limits<int32_t>::max()) {
+            return integer(int32_t(statement.mIntegerValue));
+        }
+        return nullopt;
+    }
+
+    optional<ConstantValue> ConstantValue::applyBinary(string_view operatorName, const ConstantValue &lhs, const ConstantValue &rhs) {
+        if (operatorName.size() != 1) {
+            return nullopt;
+        }
+        char op = operatorName[0];
+
+        if (lhs.mType == DOUBLE || rhs.mType == DOUBLE) {
+            double a = lhs.asDouble();
+            double b = rhs.asDouble();
+            double result;
+            switch (op) {
+                case '+': result = a + b; break;
+                case '-': result = a - b; break;
+                case '*': result = a * b; break;
+                case '/': result = a / b; break;
+                case '<': return integer(a < b ? 1 : 0);
+                default: return nullopt;
+            }
+            if (!isfinite(result)) {
+                return nullopt;
+            }
+            return floating(result);
+        }
+
+        int64_t a = lhs.mInteger;
+        int64_t b = rhs.mInteger;
+        switch (op) {
+            case '+': return integer(wrapToInt32(a + b));
+            case '-': return integer(wrapToInt32(a - b));
+            case '*': return integer(wrapToInt32(a * b));
+            case '/':
+                // Both trap on most CPUs, so leave them to run time.
+                if (b == 0 || (a == numeric_limits<int32_t>::min() && b == -1)) {
+                    return nullopt;
+                }
+                return integer(int32_t(a / b));
+            case '<': return integer(a < b ? 1 : 0);
+            default: return nullopt;
+        }
+    }
+
+    optional<ConstantValue> ConstantValue::applyUnary(string_view operatorName, const ConstantValue &operand) {
+        if (operatorName == "+") {
+            return operand;
+        }
+        if (operatorName != "-") {
+            return nullopt;
+        }
+        if (operand.mType == DOUBLE) {
+            return floating(-operand.mDouble);
+        }
+        return integer(wrapToInt32(-int64_t(operand.mInteger)));
+    }
+
+    Statement ConstantValue::toLiteral() const {
+        Statement literal;
+        literal.mKind = StatementKind::LITERAL;
+        if (mType == DOUBLE) {
+            literal.mType = TypeTable::kDouble;
+            literal.mDoubleValue = mDouble;
+            char text[32];
+            char *textEnd = to_chars(text, text + sizeof(text), mDouble).ptr;
+            literal.mName.assign(text, textEnd);
+            if (literal.mName.find_first_of(".e") == string::npos) {
+                literal.mName += ".0"; // So it still reads as a double, e.g. in debugPrint().
+            }
+        } else {
+            literal.mType = TypeTable::kInteger;
+            literal.mIntegerValue = mInteger;
+            literal.mName = to_string(mInteger);
+        }
+        return literal;
+    }
+
+}
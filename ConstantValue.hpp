@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Statement.hpp"
+#include "Type.hpp"
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! A number known before the program runs, with the arithmetic of its BUILTIN_TYPE. Number
+    //! literals are INT32 or DOUBLE, and so is everything computed from them: INT32 wraps
+    //! around at 32 bits instead of overflow being undefined, DOUBLE is IEEE 754, and mixing
+    //! the two converts to DOUBLE.
+    class ConstantValue {
+    public:
+        static ConstantValue integer(int32_t value);
+
+        static ConstantValue floating(double value);
+
+        //! The value of a number LITERAL. nullopt for anything else, including strings, and for
+        //! integer literals too large for INT32.
+        static optional<ConstantValue> of(const Statement &statement);
+
+        //! nullopt where the result is better left to run time: division by zero, the INT32
+        //! division that overflows, results that aren't finite, and operators other than
+        //! + - * / < (which gives an INT32 0 or 1).
+        static optional<ConstantValue> applyBinary(string_view operatorName, const ConstantValue &lhs, const ConstantValue &rhs);
+
+        //! Unary + and -.
+        static optional<ConstantValue> applyUnary(string_view operatorName, const ConstantValue &operand);
+
+        //! A LITERAL like the parser would make for this value.
+        Statement toLiteral() const;
+
+        bool isZero() const { return (mType == DOUBLE) ? mDouble == 0 : mInteger == 0; }
+
+        double asDouble() const { return (mType == DOUBLE) ? mDouble : double(mInteger); }
+
+        BUILTIN_TYPE mType{INT32}; // INT32 or DOUBLE.
+        int32_t mInteger{0};
+        double mDouble{0};
+    };
+
+}
@@ -0,0 +1,103 @@
+#include "ContentHash.hpp"
+#include <cstring>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    static constexpr uint64_t kPrime1 = 11400714785074694791ULL;
+    static constexpr uint64_t kPrime2 = 14029467366897019727ULL;
+    static constexpr uint64_t kPrime3 = 1609587929392839161ULL;
+    static constexpr uint64_t kPrime4 = 9650029242287828579ULL;
+    static constexpr uint64_t kPrime5 = 2870177450012600261ULL;
+
+    static uint64_t rotateLeft(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    // Hashes are only compared on the machine that made them, so native byte order is fine.
+    static uint64_t read64(const char *bytes) {
+        uint64_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    static uint32_t read32(const char *bytes) {
+        uint32_t value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+
+    static uint64_t round(uint64_t accumulator, uint64_t input) {
+        accumulator += input * kPrime2;
+        accumulator = rotateLeft(accumulator, 31);
+        return accumulator * kPrime1;
+    }
+
+    static uint64_t mergeRound(uint64_t hash, uint64_t accumulator) {
+        hash ^= round(0, accumulator);
+        return hash * kPrime1 + kPrime4;
+    }
+
+    uint64_t xxHash64(string_view bytes, uint64_t seed) {
+        const char *current = bytes.data();
+        const char *end = current + bytes.size();
+        uint64_t hash;
+
+        if (bytes.size() >= 32) {
+            uint64_t accumulators[4] = {seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1};
+            for (; end - current >= 32; current += 32) {
+                for (int lane = 0; lane < 4; ++lane) {
+                    accumulators[lane] = round(accumulators[lane], read64(current + 8 * lane));
+                }
+            }
+            hash = rotateLeft(accumulators[0], 1) + rotateLeft(accumulators[1], 7)
+                   + rotateLeft(accumulators[2], 12) + rotateLeft(accumulators[3], 18);
+            for (uint64_t accumulator : accumulators) {
+                hash = mergeRound(hash, accumulator);
+            }
+        } else {
+            hash = seed + kPrime5;
+        }
+        hash += uint64_t(bytes.size());
+
+        for (; end - current >= 8; current += 8) {
+            hash ^= round(0, read64(current));
+            hash = rotateLeft(hash, 27) * kPrime1 + kPrime4;
+        }
+        if (end - current >= 4) {
+            hash ^= uint64_t(read32(current)) * kPrime1;
+            hash = rotateLeft(hash, 23) * kPrime2 + kPrime3;
+            current += 4;
+        }
+        for (; current < end; ++current) {
+            hash ^= uint64_t(uint8_t(*current)) * kPrime5;
+            hash = rotateLeft(hash, 11) * kPrime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= kPrime2;
+        hash ^= hash >> 29;
+        hash *= kPrime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    ContentHash ContentHash::of(string_view bytes, uint64_t salt) {
+        ContentHash result;
+        result.mHigh = xxHash64(bytes, salt);
+        result.mLow = xxHash64(bytes, rotateLeft(salt, 32) ^ kPrime3);
+        return result;
+    }
+
+    string ContentHash::toHex() const {
+        static constexpr char kDigits[] = "0123456789abcdef";
+        string result(32, '0');
+        for (int digit = 0; digit < 16; ++digit) {
+            result[15 - digit] = kDigits[(mHigh >> (4 * digit)) & 0xf];
+            result[31 - digit] = kDigits[(mLow >> (4 * digit)) & 0xf];
+        }
+        return result;
+    }
+
+}
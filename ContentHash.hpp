@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! xxHash64 of bytes. Fast enough that hashing a file costs far less than tokenizing it.
+    uint64_t xxHash64(string_view bytes, uint64_t seed = 0);
+
+    //! A 128-bit hash for telling file contents apart, made of two differently seeded xxHash64s.
+    class ContentHash {
+    public:
+        uint64_t mHigh{0};
+        uint64_t mLow{0};
+
+        //! salt goes into both halves, so the same bytes hash differently for a different salt.
+        static ContentHash of(string_view bytes, uint64_t salt = 0);
+
+        //! 32 lowercase hex digits.
+        string toHex() const;
+
+        bool operator==(const ContentHash &other) const = default;
+    };
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! A problem found in the source, e.g. a syntax error.
+    class Diagnostic {
+    public:
+        size_t mLineNumber{0}; // 0 at the end of the input.
+        string mMessage; // A whole sentence, the same text that would have been thrown.
+    };
+
+}
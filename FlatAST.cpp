@@ -0,0 +1,366 @@
+#include "FlatAST.hpp"
+#include "AstWriter.hpp"
+#include <bit>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! A number literal's value as raw bits, for storing either kind in the same field.
+    static uint64_t literalBits(const Statement &statement) {
+        return (statement.mType.builtin() == DOUBLE) ? bit_cast<uint64_t>(statement.mDoubleValue) : uint64_t(statement.mIntegerValue);
+    }
+
+    static void setLiteralBits(Statement &statement, uint64_t bits) {
+        if (statement.mType.builtin() == DOUBLE) {
+            statement.mDoubleValue = bit_cast<double>(bits);
+        } else {
+            statement.mIntegerValue = int64_t(bits);
+        }
+    }
+
+    FlatAST::FlatAST(const map<string, FunctionDefinition> &functions) {
+        // Breadth-first: each node reserves adjacent slots for all its children before any
+        // of them is visited, so no child range ever has to move.
+        vector<pair<const Statement *, uint32_t>> pending;
+        size_t nextPending = 0;
+
+        mFunctions.reserve(functions.size());
+        for (const auto &[name, function] : functions) {
+            FlatFunction &flatFunction = mFunctions.emplace_back();
+            flatFunction.mNameOffset = addString(function.mName);
+            flatFunction.mNameLength = checkedIndex(function.mName.size());
+            flatFunction.mReturnsSomething = function.mReturnsSomething;
+
+            flatFunction.mFirstParameter = checkedIndex(mParameters.size());
+            flatFunction.mParameterCount = checkedIndex(function.mParameters.size());
+            for (const ParameterDefinition &param : function.mParameters) {
+                FlatParameter &flatParam = mParameters.emplace_back();
+                flatParam.mNameOffset = addString(param.mName);
+                flatParam.mNameLength = checkedIndex(param.mName.size());
+                flatParam.mType = addType(param.mType);
+            }
+
+            flatFunction.mFirstStatement = checkedIndex(mStatements.size());
+            flatFunction.mStatementCount = checkedIndex(function.mStatements.size());
+            for (const Statement &statement : function.mStatements) {
+                pending.emplace_back(&statement, checkedIndex(mStatements.size()));
+                mStatements.emplace_back();
+            }
+        }
+
+        while (nextPending < pending.size()) {
+            auto [statement, index] = pending[nextPending++];
+
+            FlatStatement flatStatement;
+            flatStatement.mNameOffset = addString(statement->mName);
+            flatStatement.mNameLength = checkedIndex(statement->mName.size());
+            flatStatement.mType = addType(statement->mType);
+            flatStatement.mKind = statement->mKind;
+            flatStatement.mLiteralBits = literalBits(*statement);
+            flatStatement.mFirstChild = checkedIndex(mStatements.size());
+            flatStatement.mChildCount = checkedIndex(statement->mParameters.size());
+            mStatements[index] = flatStatement;
+
+            for (const Statement &child : statement->mParameters) {
+                pending.emplace_back(&child, checkedIndex(mStatements.size()));
+                mStatements.emplace_back();
+            }
+        }
+    }
+
+    uint32_t FlatAST::addString(string_view text) {
+        uint32_t offset = checkedIndex(mStrings.size());
+        mStrings.append(text);
+        return offset;
+    }
+
+    uint32_t FlatAST::addType(TypeID type) {
+        // Programs use a handful of types, so a linear search beats any lookup structure here.
+        for (size_t index = 0; index < mTypes.size(); ++index) {
+            if (mTypes[index] == type) {
+                return uint32_t(index);
+            }
+        }
+        mTypes.push_back(type);
+        return checkedIndex(mTypes.size() - 1);
+    }
+
+    uint32_t FlatAST::checkedIndex(size_t index) const {
+        if (index > UINT32_MAX) {
+            throw length_error("Program too large for a flat AST.");
+        }
+        return uint32_t(index);
+    }
+
+    Statement FlatAST::toStatement(const FlatStatement &statement) const {
+        // Each node's children are allocated at their final size before any is filled in, so
+        // pointers to them stay valid and the tree is built without recursing.
+        Statement result;
+        vector<pair<const FlatStatement *, Statement *>> pending{{&statement, &result}};
+        while (!pending.empty()) {
+            auto [flatStatement, target] = pending.back();
+            pending.pop_back();
+
+            target->mName = name(*flatStatement);
+            target->mType = mTypes[flatStatement->mType];
+            target->mKind = flatStatement->mKind;
+            setLiteralBits(*target, flatStatement->mLiteralBits);
+            target->mParameters.resize(flatStatement->mChildCount);
+            span<const FlatStatement> flatChildren = children(*flatStatement);
+            for (size_t index = 0; index < flatChildren.size(); ++index) {
+                pending.emplace_back(&flatChildren[index], &target->mParameters[index]);
+            }
+        }
+        return result;
+    }
+
+    FunctionDefinition FlatAST::toFunctionDefinition(const FlatFunction &function) const {
+        FunctionDefinition result;
+        result.mName = name(function);
+        result.mReturnsSomething = function.mReturnsSomething;
+        for (const FlatParameter &param : parameters(function)) {
+            ParameterDefinition &resultParam = result.mParameters.emplace_back();
+            resultParam.mName = name(param);
+            resultParam.mType = mTypes[param.mType];
+        }
+        result.mStatements.reserve(function.mStatementCount);
+        for (const FlatStatement &statement : statements(function)) {
+            result.mStatements.push_back(toStatement(statement));
+        }
+        return result;
+    }
+
+    map<string, FunctionDefinition> FlatAST::toFunctions() const {
+        map<string, FunctionDefinition> result;
+        for (const FlatFunction &function : mFunctions) {
+            result.emplace(string(name(function)), toFunctionDefinition(function));
+        }
+        return result;
+    }
+
+    void FlatAST::debugPrint() const {
+        PrettyAstWriter writer(cout);
+        write(writer);
+    }
+
+    void FlatAST::write(AstWriter &writer, string_view source) const {
+        class Visitor {
+        public:
+            const FlatAST &mAST;
+            AstWriter &mWriter;
+
+            void enter(const FlatStatement &statement, size_t) {
+                mWriter.beginStatement(statement.mKind, mAST.mTypes[statement.mType].name(), mAST.name(statement));
+            }
+
+            void leave(const FlatStatement &, size_t) {
+                mWriter.endStatement();
+            }
+        };
+
+        AstWalker<const FlatStatement> walker;
+        auto children = [this](const FlatStatement &statement) { return this->children(statement); };
+        writer.beginDocument(source);
+        for (const FlatFunction &function : mFunctions) {
+            writer.beginFunction(name(function), function.mReturnsSomething);
+            for (const FlatParameter &param : parameters(function)) {
+                writer.parameter(mTypes[param.mType].name(), name(param));
+            }
+            writer.beginBody();
+            walker.walk(statements(function), children, Visitor{*this, writer});
+            writer.endFunction();
+        }
+        writer.endDocument();
+        writer.flush();
+    }
+
+    // Everything is written as native 32-bit words, field by field, so no padding ends up in the
+    // bytes. The words are: a header, then functions, parameters, statements and types, then
+    // the string arena followed by the type names.
+
+    static constexpr char kMagic[4] = {'S', 'P', 'F', 'A'};
+
+    static void appendWords(string &out, initializer_list<uint32_t> words) {
+        for (uint32_t word : words) {
+            out.append(reinterpret_cast<const char *>(&word), sizeof(word));
+        }
+    }
+
+    //! Reads from bytes one word at a time, and throws if they run out.
+    class WordReader {
+    public:
+        explicit WordReader(string_view bytes) : mBytes(bytes) {}
+
+        uint32_t next() {
+            if (mBytes.size() < sizeof(uint32_t)) {
+                throw runtime_error("Truncated AST data.");
+            }
+            uint32_t word;
+            memcpy(&word, mBytes.data(), sizeof(word));
+            mBytes.remove_prefix(sizeof(word));
+            return word;
+        }
+
+        string_view rest() const { return mBytes; }
+
+    private:
+        string_view mBytes;
+    };
+
+    string FlatAST::serialize() const {
+        string typeNames;
+        for (TypeID type : mTypes) {
+            typeNames += type.name();
+        }
+
+        string out;
+        out.reserve(4 * (8 + 7 * mFunctions.size() + 3 * mParameters.size() + 8 * mStatements.size()
+                         + 3 * mTypes.size()) + mStrings.size() + typeNames.size());
+        out.append(kMagic, sizeof(kMagic));
+        appendWords(out, {kFormatVersion, checkedIndex(mFunctions.size()), checkedIndex(mParameters.size()),
+                          checkedIndex(mStatements.size()), checkedIndex(mTypes.size()),
+                          checkedIndex(mStrings.size()), checkedIndex(typeNames.size())});
+        for (const FlatFunction &function : mFunctions) {
+            appendWords(out, {function.mNameOffset, function.mNameLength, function.mFirstParameter,
+                              function.mParameterCount, function.mFirstStatement, function.mStatementCount,
+                              uint32_t(function.mReturnsSomething)});
+        }
+        for (const FlatParameter &param : mParameters) {
+            appendWords(out, {param.mNameOffset, param.mNameLength, param.mType});
+        }
+        for (const FlatStatement &statement : mStatements) {
+            appendWords(out, {statement.mNameOffset, statement.mNameLength, statement.mType,
+                              statement.mFirstChild, statement.mChildCount, uint32_t(statement.mKind),
+                              uint32_t(statement.mLiteralBits), uint32_t(statement.mLiteralBits >> 32)});
+        }
+        uint32_t typeNameOffset = 0;
+        for (TypeID type : mTypes) {
+            appendWords(out, {typeNameOffset, checkedIndex(type.name().size()), uint32_t(type.builtin())});
+            typeNameOffset += uint32_t(type.name().size());
+        }
+        out += mStrings;
+        out += typeNames;
+        return out;
+    }
+
+    FlatAST FlatAST::deserialize(string_view bytes) {
+        if (bytes.size() < sizeof(kMagic) || memcmp(bytes.data(), kMagic, sizeof(kMagic)) != 0) {
+            throw runtime_error("Not AST data.");
+        }
+        WordReader reader(bytes.substr(sizeof(kMagic)));
+        if (reader.next() != kFormatVersion) {
+            throw runtime_error("AST data of a different format version.");
+        }
+
+        FlatAST result;
+        result.mFunctions.resize(reader.next());
+        result.mParameters.resize(reader.next());
+        result.mStatements.resize(reader.next());
+        result.mTypes.resize(reader.next());
+        size_t stringsSize = reader.next();
+        size_t typeNamesSize = reader.next();
+
+        size_t wordCount = 7 * result.mFunctions.size() + 3 * result.mParameters.size()
+                           + 8 * result.mStatements.size() + 3 * result.mTypes.size();
+        if (reader.rest().size() != 4 * wordCount + stringsSize + typeNamesSize) {
+            throw runtime_error("AST data of the wrong size.");
+        }
+
+        for (FlatFunction &function : result.mFunctions) {
+            function.mNameOffset = reader.next();
+            function.mNameLength = reader.next();
+            function.mFirstParameter = reader.next();
+            function.mParameterCount = reader.next();
+            function.mFirstStatement = reader.next();
+            function.mStatementCount = reader.next();
+            function.mReturnsSomething = (reader.next() != 0);
+        }
+        for (FlatParameter &param : result.mParameters) {
+            param.mNameOffset = reader.next();
+            param.mNameLength = reader.next();
+            param.mType = reader.next();
+        }
+        for (FlatStatement &statement : result.mStatements) {
+            statement.mNameOffset = reader.next();
+            statement.mNameLength = reader.next();
+            statement.mType = reader.next();
+            statement.mFirstChild = reader.next();
+            statement.mChildCount = reader.next();
+            uint32_t kind = reader.next();
+            if (kind > uint32_t(StatementKind::WHILE_LOOP)) {
+                throw runtime_error("AST data with an unknown statement kind.");
+            }
+            statement.mKind = StatementKind(kind);
+            statement.mLiteralBits = reader.next();
+            statement.mLiteralBits |= uint64_t(reader.next()) << 32;
+        }
+        vector<Type> types(result.mTypes.size());
+        vector<pair<uint32_t, uint32_t>> typeNames(result.mTypes.size());
+        for (size_t index = 0; index < types.size(); ++index) {
+            typeNames[index].first = reader.next();
+            typeNames[index].second = reader.next();
+            uint32_t builtinType = reader.next();
+            if (builtinType > uint32_t(STRUCT)) {
+                throw runtime_error("AST data with an unknown type.");
+            }
+            types[index].mType = BUILTIN_TYPE(builtinType);
+        }
+
+        result.mStrings.assign(reader.rest().substr(0, stringsSize));
+        string_view typeNameArena = reader.rest().substr(stringsSize);
+        for (size_t index = 0; index < types.size(); ++index) {
+            auto [offset, length] = typeNames[index];
+            if (offset > typeNameArena.size() || length > typeNameArena.size() - offset) {
+                throw runtime_error("AST data with a type name out of range.");
+            }
+            types[index].mName.assign(typeNameArena.substr(offset, length));
+            result.mTypes[index] = TypeTable::global().intern(types[index]);
+        }
+
+        result.validate();
+        return result;
+    }
+
+    void FlatAST::validate() const {
+        auto checkName = [this](uint32_t offset, uint32_t length) {
+            if (offset > mStrings.size() || length > mStrings.size() - offset) {
+                throw runtime_error("AST data with a name out of range.");
+            }
+        };
+        auto checkRange = [](uint32_t first, uint32_t count, size_t size) {
+            if (first > size || count > size - first) {
+                throw runtime_error("AST data with a child range out of range.");
+            }
+        };
+        auto checkType = [this](uint32_t type) {
+            if (type >= mTypes.size()) {
+                throw runtime_error("AST data with a type index out of range.");
+            }
+        };
+
+        for (const FlatFunction &function : mFunctions) {
+            checkName(function.mNameOffset, function.mNameLength);
+            checkRange(function.mFirstParameter, function.mParameterCount, mParameters.size());
+            checkRange(function.mFirstStatement, function.mStatementCount, mStatements.size());
+        }
+        for (const FlatParameter &param : mParameters) {
+            checkName(param.mNameOffset, param.mNameLength);
+            checkType(param.mType);
+        }
+        for (size_t index = 0; index < mStatements.size(); ++index) {
+            const FlatStatement &statement = mStatements[index];
+            checkName(statement.mNameOffset, statement.mNameLength);
+            checkType(statement.mType);
+            checkRange(statement.mFirstChild, statement.mChildCount, mStatements.size());
+            // Children always come after their parent, which rules out cycles.
+            if (statement.mChildCount != 0 && statement.mFirstChild <= index) {
+                throw runtime_error("AST data with a cycle.");
+            }
+        }
+    }
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "FunctionDefinition.hpp"
+#include "Statement.hpp"
+#include "TypeTable.hpp"
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    class AstWriter;
+
+    //! A Statement stored in a FlatAST. Its children are the mChildCount nodes starting at mFirstChild.
+    class FlatStatement {
+    public:
+        uint32_t mNameOffset{0}; // Into the FlatAST's string arena.
+        uint32_t mNameLength{0};
+        uint32_t mType{0}; // Index into FlatAST::mTypes.
+        uint32_t mFirstChild{0};
+        uint32_t mChildCount{0};
+        StatementKind mKind{StatementKind::FUNCTION_CALL};
+        uint64_t mLiteralBits{0}; // The Statement's mIntegerValue or mDoubleValue, bit for bit.
+    };
+
+    class FlatParameter {
+    public:
+        uint32_t mNameOffset{0};
+        uint32_t mNameLength{0};
+        uint32_t mType{0};
+    };
+
+    class FlatFunction {
+    public:
+        uint32_t mNameOffset{0};
+        uint32_t mNameLength{0};
+        uint32_t mFirstParameter{0};
+        uint32_t mParameterCount{0};
+        uint32_t mFirstStatement{0};
+        uint32_t mStatementCount{0};
+        bool mReturnsSomething{false};
+    };
+
+    //! All functions of a parse in a handful of contiguous arrays, with children referenced
+    //! by 32-bit index ranges instead of nested vectors. Nodes are laid out breadth-first,
+    //! so every node's children are adjacent, and the whole tree is freed in one go.
+    class FlatAST {
+    public:
+        //! Bump when the layout written by serialize() changes.
+        static constexpr uint32_t kFormatVersion = 2;
+
+        FlatAST() = default;
+
+        explicit FlatAST(const map<string, FunctionDefinition> &functions);
+
+        span<const FlatFunction> functions() const { return mFunctions; }
+
+        span<const FlatParameter> parameters(const FlatFunction &function) const {
+            return span<const FlatParameter>(mParameters).subspan(function.mFirstParameter, function.mParameterCount);
+        }
+
+        span<const FlatStatement> statements(const FlatFunction &function) const {
+            return span<const FlatStatement>(mStatements).subspan(function.mFirstStatement, function.mStatementCount);
+        }
+
+        span<const FlatStatement> children(const FlatStatement &statement) const {
+            return span<const FlatStatement>(mStatements).subspan(statement.mFirstChild, statement.mChildCount);
+        }
+
+        template<class Node>
+        string_view name(const Node &node) const { return string_view(mStrings).substr(node.mNameOffset, node.mNameLength); }
+
+        const Type &type(uint32_t index) const { return mTypes[index].type(); }
+
+        size_t statementCount() const { return mStatements.size(); }
+
+        //! Converts back for code that works with Statement trees.
+        Statement toStatement(const FlatStatement &statement) const;
+
+        FunctionDefinition toFunctionDefinition(const FlatFunction &function) const;
+
+        map<string, FunctionDefinition> toFunctions() const;
+
+        void debugPrint() const;
+
+        //! Like AstWriter::write() does for the functions this was made from.
+        void write(AstWriter &writer, string_view source = {}) const;
+
+        //! A compact binary form that deserialize() reads back without parsing anything.
+        string serialize() const;
+
+        //! Throws a runtime_error if bytes weren't written by serialize() of this format version,
+        //! or if any index in them is out of range.
+        static FlatAST deserialize(string_view bytes);
+
+    private:
+        void validate() const;
+
+        uint32_t addString(string_view text);
+
+        uint32_t addType(TypeID type);
+
+        uint32_t checkedIndex(size_t index) const;
+
+        vector<FlatFunction> mFunctions;
+        vector<FlatParameter> mParameters;
+        vector<FlatStatement> mStatements;
+        vector<TypeID> mTypes;
+        string mStrings;
+    };
+
+}
@@ -1,4 +1,5 @@
 #include "FunctionDefinition.hpp"
+#include "AstWriter.hpp"
 #include <iostream>
 
 namespace simpleparser {
@@ -6,20 +7,10 @@ namespace simpleparser {
     using namespace std;
 
     void FunctionDefinition::debugPrint() const {
-        cout << (mReturnsSomething ? "int " : "void ") << mName << "(\n";
-
-        for (ParameterDefinition param : mParameters) {
-            param.debugPrint(1);
-        }
-
-        cout << ") {\n";
-        for (Statement statement : mStatements) {
-            statement.debugPrint(0);
-        }
-        cout << "}" << endl;
+        PrettyAstWriter(cout).write(*this);
     }
 
     void ParameterDefinition::debugPrint(size_t indent) const {
-        cout << string(indent, '\t') << mType.mName << " " << mName << endl;
+        cout << string(indent, '\t') << mType.name() << " " << mName << "\n";
     }
 }
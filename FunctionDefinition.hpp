@@ -1,7 +1,8 @@
 #pragma once
 
-#include "Type.hpp"
+#include "TypeTable.hpp"
 #include "Statement.hpp"
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -12,7 +13,7 @@ namespace simpleparser {
     class ParameterDefinition {
     public:
         string mName; // Empty string means no name given.
-        Type mType;
+        TypeID mType;
 
         void debugPrint(size_t indent) const;
     };
@@ -23,6 +24,7 @@ namespace simpleparser {
         vector<ParameterDefinition> mParameters;
         vector<Statement> mStatements;
         bool mReturnsSomething;
+        uint32_t mSlotCount{0}; // Frame slots for parameters and variables, set by NameResolver.
 
         void debugPrint() const;
     };
@@ -0,0 +1,299 @@
+#include "IncrementalParser.hpp"
+#include "AstWriter.hpp"
+#include "Parser.hpp"
+#include "Tokenizer.hpp"
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    IncrementalParser::IncrementalParser(string_view text) {
+        if (!text.empty()) {
+            applyEdit(TextEdit{0, 0, string(text)});
+        }
+    }
+
+    void IncrementalParser::edit(const vector<TextEdit> &edits) {
+        mLastReparsedTokenCount = 0;
+        for (const TextEdit &currEdit : edits) {
+            applyEdit(currEdit);
+        }
+    }
+
+    //! Whether the last token closes a top-level block, so findDefinitionEnds() cuts after it.
+    static bool endsAtTopLevel(const TokenBuffer &tokens) {
+        size_t depth = 0;
+        bool closedBlock = false;
+        for (size_t index = 0; index < tokens.size(); ++index) {
+            closedBlock = false;
+            if (tokens.type(index) != OPERATOR) {
+                continue;
+            }
+            if (tokens.kind(index) == TokenKind::OPEN_BRACE) {
+                ++depth;
+            } else if (tokens.kind(index) == TokenKind::CLOSE_BRACE && depth > 0) {
+                --depth;
+                closedBlock = (depth == 0);
+            }
+        }
+        return closedBlock;
+    }
+
+    void IncrementalParser::applyEdit(const TextEdit &edit) {
+        size_t textSize = mSegmentEnds.empty() ? 0 : mSegmentEnds.back();
+        if (edit.mOffset > textSize || edit.mRemovedLength > textSize - edit.mOffset) {
+            throw out_of_range("Edit at " + to_string(edit.mOffset) + " is outside of the text.");
+        }
+        size_t removedEnd = edit.mOffset + edit.mRemovedLength;
+
+        // Damage starts at the segment the edit is in. Segments start after a closing brace,
+        // which nothing inserted behind it can become part of. At the very end of the text,
+        // the last segment is damaged, since its last token may get longer.
+        size_t first = size_t(upper_bound(mSegmentEnds.begin(), mSegmentEnds.end(), edit.mOffset) - mSegmentEnds.begin());
+        if (first == mSegments.size() && first > 0) {
+            --first;
+        }
+        size_t damagedStart = (first == 0) ? 0 : mSegmentEnds[first - 1];
+
+        // Strings and comments end at the end of a line, so from the first line break after the
+        // edit on, tokens are the same as before. Damage ends with the segment that contains it.
+        size_t last = first;
+        size_t damagedEnd = damagedStart;
+        bool foundLineBreak = false;
+        while (last < mSegments.size() && !foundLineBreak) {
+            const string &segmentText = mSegments[last]->mText;
+            if (damagedEnd + segmentText.size() > removedEnd) {
+                size_t searchStart = max(removedEnd, damagedEnd) - damagedEnd;
+                foundLineBreak = (segmentText.find_first_of("\r\n", searchStart) != string::npos);
+            }
+            damagedEnd += segmentText.size();
+            ++last;
+        }
+
+        string damagedText;
+        damagedText.reserve(damagedEnd - damagedStart - edit.mRemovedLength + edit.mInsertedText.size());
+        for (size_t index = first; index < last; ++index) {
+            damagedText += mSegments[index]->mText;
+        }
+        damagedText.replace(edit.mOffset - damagedStart, edit.mRemovedLength, edit.mInsertedText);
+
+        // Cut the damaged text into segments where its top-level definitions end. The segments
+        // behind it were cut at top level, so they only stay as they are if the damaged text
+        // still ends with a cut. If the edit changed how deeply braces nest, it doesn't, and the
+        // damage grows by as many segments again until it does.
+        size_t lineNumber = firstLineNumber(first);
+        vector<size_t> segmentEnds;
+        while (true) {
+            segmentEnds.clear();
+            bool endsWithCut = false;
+            try {
+                Tokenizer tokenizer;
+                TokenBuffer tokens = tokenizer.parse(damagedText, lineNumber);
+                vector<size_t> definitionEnds = Parser::findDefinitionEnds(tokens);
+                for (size_t index = 0; index + 1 < definitionEnds.size(); ++index) {
+                    segmentEnds.push_back(tokens.offset(definitionEnds[index] - 1) + 1); // Just past the closing brace.
+                }
+                endsWithCut = tokens.empty() || endsAtTopLevel(tokens);
+            } catch (exception &) {
+                // Kept as one segment, whose parse reports the error.
+                segmentEnds.clear();
+                endsWithCut = true;
+            }
+            if (endsWithCut || last == mSegments.size()) {
+                break;
+            }
+            size_t extendedLast = min(last + max(last - first, size_t(1)), mSegments.size());
+            for (; last < extendedLast; ++last) {
+                damagedText += mSegments[last]->mText;
+            }
+        }
+        if (!damagedText.empty()) {
+            segmentEnds.push_back(damagedText.size());
+        }
+
+        vector<unique_ptr<Segment>> newSegments;
+        size_t segmentStart = 0;
+        for (size_t segmentEnd : segmentEnds) {
+            newSegments.push_back(makeSegment(damagedText.substr(segmentStart, segmentEnd - segmentStart), lineNumber));
+            lineNumber += newSegments.back()->mLineCount;
+            segmentStart = segmentEnd;
+        }
+
+        replaceSegments(first, last - first, std::move(newSegments));
+    }
+
+    unique_ptr<IncrementalParser::Segment> IncrementalParser::makeSegment(string text, size_t firstLineNumber) {
+        auto segment = make_unique<Segment>();
+        segment->mText = std::move(text);
+        segment->mLineCount = size_t(count_if(segment->mText.begin(), segment->mText.end(),
+                                              [](char ch) { return ch == '\r' || ch == '\n'; }));
+        segment->mFirstLineNumber = firstLineNumber;
+
+        size_t tokenCount = 0;
+        parse(segment->mText, firstLineNumber, segment->mFunctions, segment->mDiagnostics, tokenCount);
+        mLastReparsedTokenCount += tokenCount;
+        return segment;
+    }
+
+    void IncrementalParser::parse(string_view text, size_t firstLineNumber, map<string, FunctionDefinition> &functions,
+                                  string &diagnostics, size_t &tokenCount) {
+        ostringstream diagnosticStream;
+        try {
+            Tokenizer tokenizer;
+            TokenBuffer tokens = tokenizer.parse(text, firstLineNumber);
+            tokenCount = tokens.size();
+
+            Parser parser;
+            parser.setDiagnosticStream(diagnosticStream);
+            parser.parse(tokens);
+            functions = parser.takeFunctions();
+        } catch (exception &err) {
+            diagnosticStream << "Error: " << err.what() << "\n";
+        }
+        diagnostics = diagnosticStream.str();
+    }
+
+    void IncrementalParser::replaceSegments(size_t first, size_t count, vector<unique_ptr<Segment>> newSegments) {
+        vector<string> touchedNames;
+        for (size_t index = first; index < first + count; ++index) {
+            mSegments[index]->mRemoved = true;
+            for (const auto &funcPair : mSegments[index]->mFunctions) {
+                touchedNames.push_back(funcPair.first);
+                --mDefinitionCounts[funcPair.first];
+            }
+        }
+
+        // Like Parser, the last definition of a name wins.
+        unordered_map<string_view, FunctionEntry> lastNewDefinitions;
+        size_t textEnd = (first == 0) ? 0 : mSegmentEnds[first - 1];
+        size_t lineBreakCount = (first == 0) ? 0 : mLineBreakCounts[first - 1];
+        vector<size_t> newSegmentEnds;
+        vector<size_t> newLineBreakCounts;
+        for (const unique_ptr<Segment> &segment : newSegments) {
+            for (const auto &funcPair : segment->mFunctions) {
+                touchedNames.push_back(funcPair.first);
+                ++mDefinitionCounts[funcPair.first];
+                lastNewDefinitions[funcPair.first] = FunctionEntry{&funcPair.second, segment.get()};
+            }
+            textEnd += segment->mText.size();
+            lineBreakCount += segment->mLineCount;
+            newSegmentEnds.push_back(textEnd);
+            newLineBreakCounts.push_back(lineBreakCount);
+        }
+
+        // Everything behind the replaced segments moves by the same amount. Unsigned
+        // arithmetic wraps, so adding the difference also works when they got shorter.
+        size_t oldTextEnd = (first + count == 0) ? 0 : mSegmentEnds[first + count - 1];
+        size_t oldLineBreakCount = (first + count == 0) ? 0 : mLineBreakCounts[first + count - 1];
+        for (size_t index = first + count; index < mSegments.size(); ++index) {
+            mSegmentEnds[index] += textEnd - oldTextEnd;
+            mLineBreakCounts[index] += lineBreakCount - oldLineBreakCount;
+        }
+        mSegmentEnds.erase(mSegmentEnds.begin() + ptrdiff_t(first), mSegmentEnds.begin() + ptrdiff_t(first + count));
+        mSegmentEnds.insert(mSegmentEnds.begin() + ptrdiff_t(first), newSegmentEnds.begin(), newSegmentEnds.end());
+        mLineBreakCounts.erase(mLineBreakCounts.begin() + ptrdiff_t(first), mLineBreakCounts.begin() + ptrdiff_t(first + count));
+        mLineBreakCounts.insert(mLineBreakCounts.begin() + ptrdiff_t(first), newLineBreakCounts.begin(), newLineBreakCounts.end());
+
+        // Kept alive until no entry of mFunctions can point into them any more.
+        vector<unique_ptr<Segment>> removedSegments(make_move_iterator(mSegments.begin() + ptrdiff_t(first)),
+                                                    make_move_iterator(mSegments.begin() + ptrdiff_t(first + count)));
+        size_t newEnd = first + newSegments.size();
+        mSegments.erase(mSegments.begin() + ptrdiff_t(first), mSegments.begin() + ptrdiff_t(first + count));
+        mSegments.insert(mSegments.begin() + ptrdiff_t(first), make_move_iterator(newSegments.begin()),
+                         make_move_iterator(newSegments.end()));
+
+        unordered_set<string_view> orphanedNames; // Their winning definition went away, but another one is left.
+        for (const string &name : touchedNames) {
+            auto found = mFunctions.find(name);
+            if (mDefinitionCounts[name] == 0) {
+                mDefinitionCounts.erase(name);
+                if (found != mFunctions.end()) {
+                    mFunctions.erase(found);
+                }
+                continue;
+            }
+
+            auto newDefinition = lastNewDefinitions.find(name);
+            bool ownerKept = (found != mFunctions.end() && !found->second.mSegment->mRemoved);
+            if (ownerKept && newDefinition != lastNewDefinitions.end()) {
+                // Only names defined more than once get here, so looking for the owner is rare.
+                auto owner = find_if(mSegments.begin() + ptrdiff_t(newEnd), mSegments.end(),
+                                     [&found](const unique_ptr<Segment> &segment) { return segment.get() == found->second.mSegment; });
+                ownerKept = (owner != mSegments.end());
+            }
+            if (ownerKept) {
+                continue;
+            }
+            if (newDefinition != lastNewDefinitions.end()) {
+                mFunctions.insert_or_assign(name, newDefinition->second);
+            } else {
+                orphanedNames.insert(name);
+            }
+        }
+
+        for (size_t index = mSegments.size(); index-- > 0 && !orphanedNames.empty();) {
+            for (const auto &funcPair : mSegments[index]->mFunctions) {
+                if (orphanedNames.erase(funcPair.first) != 0) {
+                    mFunctions.insert_or_assign(funcPair.first, FunctionEntry{&funcPair.second, mSegments[index].get()});
+                }
+            }
+        }
+    }
+
+    size_t IncrementalParser::firstLineNumber(size_t segmentIndex) const {
+        return 1 + ((segmentIndex == 0) ? 0 : mLineBreakCounts[segmentIndex - 1]);
+    }
+
+    string IncrementalParser::text() const {
+        string result;
+        result.reserve(mSegmentEnds.empty() ? 0 : mSegmentEnds.back());
+        for (const unique_ptr<Segment> &segment : mSegments) {
+            result += segment->mText;
+        }
+        return result;
+    }
+
+    const FunctionDefinition *IncrementalParser::findFunction(string_view name) const {
+        auto found = mFunctions.find(name);
+        return (found != mFunctions.end()) ? found->second.mDefinition : nullptr;
+    }
+
+    map<string, FunctionDefinition> IncrementalParser::functions() const {
+        map<string, FunctionDefinition> result;
+        for (const auto &[name, entry] : mFunctions) {
+            result.emplace(name, *entry.mDefinition);
+        }
+        return result;
+    }
+
+    string IncrementalParser::diagnostics() {
+        string result;
+        for (size_t index = 0; index < mSegments.size(); ++index) {
+            Segment *segment = mSegments[index].get();
+            size_t lineNumber = firstLineNumber(index);
+            if (!segment->mDiagnostics.empty() && segment->mFirstLineNumber != lineNumber) {
+                // Edits above moved the segment, so its messages name the wrong lines.
+                map<string, FunctionDefinition> functions;
+                size_t tokenCount = 0;
+                parse(segment->mText, lineNumber, functions, segment->mDiagnostics, tokenCount);
+                segment->mFirstLineNumber = lineNumber;
+            }
+            result += segment->mDiagnostics;
+        }
+        return result;
+    }
+
+    void IncrementalParser::debugPrint() const {
+        PrettyAstWriter writer(cout);
+        for (const auto &funcPair : mFunctions) {
+            writer.write(*funcPair.second.mDefinition);
+        }
+    }
+
+}
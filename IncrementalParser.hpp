@@ -0,0 +1,101 @@
+#pragma once
+
+#include "FunctionDefinition.hpp"
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Replaces mRemovedLength bytes at mOffset with mInsertedText.
+    class TextEdit {
+    public:
+        size_t mOffset{0};
+        size_t mRemovedLength{0};
+        string mInsertedText;
+    };
+
+    //! Keeps a source text parsed while it is being edited, e.g. in an editor. The text is
+    //! kept as segments cut after the closing brace of each top-level definition, and an edit
+    //! only re-tokenizes and re-parses the segments it touches. Tokens never span a line
+    //! break, so the damage ends at the first line break after the edit, unless the edit
+    //! changed how braces nest, which moves where definitions end.
+    //!
+    //! If every segment parses without problems, the functions are the same as Parser::parse
+    //! would give for the whole text. Otherwise a problem only costs the definitions of the
+    //! segment it is in, and diagnostics() says what went wrong.
+    class IncrementalParser {
+    public:
+        explicit IncrementalParser(string_view text = {});
+
+        IncrementalParser(const IncrementalParser &) = delete;
+
+        IncrementalParser &operator=(const IncrementalParser &) = delete;
+
+        //! Edits are applied one after another, so each offset refers to the text as the
+        //! previous edit left it. Throws out_of_range for edits outside the text.
+        void edit(const vector<TextEdit> &edits);
+
+        string text() const;
+
+        //! nullptr if there is no function with that name.
+        const FunctionDefinition *findFunction(string_view name) const;
+
+        size_t functionCount() const { return mFunctions.size(); }
+
+        //! A copy, in the form Parser::GetFunctions() has.
+        map<string, FunctionDefinition> functions() const;
+
+        //! What went wrong in each segment that had problems, in source order. Empty if none did.
+        string diagnostics();
+
+        //! Tokens that the last call to edit() had to parse again.
+        size_t lastReparsedTokenCount() const { return mLastReparsedTokenCount; }
+
+        void debugPrint() const;
+
+    private:
+        class Segment {
+        public:
+            string mText;
+            size_t mLineCount{0}; // Line breaks in mText.
+            size_t mFirstLineNumber{1}; // At the time it was parsed.
+            map<string, FunctionDefinition> mFunctions;
+            string mDiagnostics;
+            bool mRemoved{false};
+        };
+
+        class FunctionEntry {
+        public:
+            const FunctionDefinition *mDefinition{nullptr};
+            const Segment *mSegment{nullptr}; // Where mDefinition comes from.
+        };
+
+        void applyEdit(const TextEdit &edit);
+
+        unique_ptr<Segment> makeSegment(string text, size_t firstLineNumber);
+
+        static void parse(string_view text, size_t firstLineNumber, map<string, FunctionDefinition> &functions,
+                          string &diagnostics, size_t &tokenCount);
+
+        //! Replaces mSegments[first, first + count) with newSegments.
+        void replaceSegments(size_t first, size_t count, vector<unique_ptr<Segment>> newSegments);
+
+        size_t firstLineNumber(size_t segmentIndex) const;
+
+        vector<unique_ptr<Segment>> mSegments;
+        vector<size_t> mSegmentEnds; // Offset in the text just past each segment.
+        vector<size_t> mLineBreakCounts; // Line breaks up to the end of each segment.
+        map<string, FunctionEntry, less<>> mFunctions;
+        unordered_map<string, size_t> mDefinitionCounts; // Segments that define each name.
+        size_t mLastReparsedTokenCount{0};
+    };
+
+}
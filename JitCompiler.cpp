@@ -0,0 +1,823 @@
+#include "JitCompiler.hpp"
+#include "NativeFunctions.hpp"
+#include "VirtualMachine.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if SIMPLEPARSER_HAVE_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace simpleparser {
+
+    using namespace std;
+
+    static constexpr Gpr kContext = Gpr::R15;
+
+    static constexpr Gpr kSavedGprs[] = {Gpr::RBX, Gpr::RBP, Gpr::R12, Gpr::R13, Gpr::R14, Gpr::R15};
+
+    // Callee-saved, so variables keep them across calls.
+    static constexpr Gpr kVariableGprs[] = {Gpr::RBX, Gpr::RBP, Gpr::R12, Gpr::R13, Gpr::R14};
+
+    static constexpr Xmm kVariableXmms[] = {Xmm::XMM8, Xmm::XMM9, Xmm::XMM10, Xmm::XMM11, Xmm::XMM12, Xmm::XMM13,
+                                            Xmm::XMM14, Xmm::XMM15};
+
+    // By stack position. RAX, RCX, RDX, XMM6 and XMM7 are left as scratch registers.
+    static constexpr Gpr kTemporaryGprs[] = {Gpr::R8, Gpr::R9, Gpr::R10, Gpr::R11, Gpr::RSI, Gpr::RDI};
+
+    static constexpr Xmm kTemporaryXmms[] = {Xmm::XMM0, Xmm::XMM1, Xmm::XMM2, Xmm::XMM3, Xmm::XMM4, Xmm::XMM5};
+
+    static const Memory kCallDepth{kContext, int32_t(offsetof(JitContext, mCallDepth))};
+
+    static const Memory kFailed{kContext, int32_t(offsetof(JitContext, mFailed))};
+
+    JitCode::~JitCode() {
+#if SIMPLEPARSER_HAVE_JIT
+        if (mMemory) {
+            munmap(mMemory, mMappedSize);
+        }
+#endif
+    }
+
+    JitCode::JitCode(JitCode &&other) noexcept
+            : mMemory(exchange(other.mMemory, nullptr)), mMappedSize(exchange(other.mMappedSize, 0)),
+              mCodeSize(exchange(other.mCodeSize, 0)), mEntries(std::move(other.mEntries)) {
+    }
+
+    JitCode &JitCode::operator=(JitCode &&other) noexcept {
+        swap(mMemory, other.mMemory);
+        swap(mMappedSize, other.mMappedSize);
+        swap(mCodeSize, other.mCodeSize);
+        swap(mEntries, other.mEntries);
+        return *this;
+    }
+
+    JitCode JitCompiler::compile(const Program &program) {
+        vector<uint32_t> functions;
+        for (size_t index = 0; index < program.mFunctions.size(); ++index) {
+            functions.push_back(uint32_t(index));
+        }
+        return compile(program, functions);
+    }
+
+    JitCode JitCompiler::compile(const Program &program, span<const uint32_t> functions) {
+#if SIMPLEPARSER_HAVE_JIT
+        JitCompiler compiler(program, functions);
+        for (size_t index = 0; index < program.mFunctions.size(); ++index) {
+            if (compiler.mCompiled[index]) {
+                compiler.compileFunction(uint32_t(index));
+            }
+        }
+        vector<uint8_t> code = compiler.mAssembler.finish();
+
+        JitCode jit;
+        size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+        jit.mMappedSize = max(pageSize, (code.size() + pageSize - 1) / pageSize * pageSize);
+        void *memory = mmap(nullptr, jit.mMappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            throw runtime_error(string("Can't map memory for JIT code: ") + strerror(errno));
+        }
+        jit.mMemory = memory;
+        memcpy(memory, code.data(), code.size());
+        // Never writable and executable at the same time.
+        if (mprotect(memory, jit.mMappedSize, PROT_READ | PROT_EXEC) != 0) {
+            throw runtime_error(string("Can't make JIT code executable: ") + strerror(errno));
+        }
+        jit.mCodeSize = code.size();
+        jit.mEntries.assign(program.mFunctions.size(), nullptr);
+        for (size_t index = 0; index < program.mFunctions.size(); ++index) {
+            if (compiler.mCompiled[index]) {
+                jit.mEntries[index] = reinterpret_cast<JitEntry>(static_cast<uint8_t *>(memory) + compiler.mFunctionOffsets[index]);
+            }
+        }
+        return jit;
+#else
+        (void) program;
+        (void) functions;
+        throw runtime_error("The JIT only supports x86-64.");
+#endif
+    }
+
+    JitCompiler::JitCompiler(const Program &program, span<const uint32_t> functions)
+            : mProgram(program), mCompiled(program.mFunctions.size(), false), mFunctionOffsets(program.mFunctions.size(), 0) {
+        for (uint32_t function : functions) {
+            if (function >= program.mFunctions.size()) {
+                throw runtime_error("No function number " + to_string(function) + ".");
+            }
+            mCompiled[function] = true;
+        }
+        for (size_t index = 0; index < program.mFunctions.size(); ++index) {
+            mFunctionLabels.push_back(mAssembler.newLabel());
+        }
+    }
+
+    void JitCompiler::compileFunction(uint32_t index) {
+        const CompiledFunction &function = mProgram.mFunctions[index];
+        mFunctionIndex = index;
+        mStack.clear();
+        allocateVariables(function);
+        mDivisionByZero = mAssembler.newLabel();
+        mNestedTooDeeply = mAssembler.newLabel();
+        mFailureExit = mAssembler.newLabel();
+
+        mFunctionOffsets[index] = mAssembler.size();
+        mAssembler.bind(mFunctionLabels[index]);
+        emitPrologue(function);
+        for (size_t position = 0; position < function.mCode.size(); ++position) {
+            if (mBranchTargets[position] >= 0) {
+                // The compiler only jumps between statements.
+                if (!mStack.empty()) {
+                    throw runtime_error("Can't compile " + function.mName + ": jump with values on the stack.");
+                }
+                mAssembler.bind(mTargetLabels[size_t(mBranchTargets[position])]);
+            }
+            emitInstruction(function.mCode[position], position);
+        }
+
+        // Failures, out of the way of the code that doesn't fail.
+        mAssembler.bind(mDivisionByZero);
+        emitHelperCall(reinterpret_cast<uintptr_t>(&divisionByZero), index, false);
+        mAssembler.jmp(mFailureExit);
+        mAssembler.bind(mNestedTooDeeply);
+        emitHelperCall(reinterpret_cast<uintptr_t>(&nestedTooDeeply), index, false);
+        mAssembler.bind(mFailureExit);
+        mAssembler.add64(Gpr::RSP, mFrameSize);
+        for (auto reg = rbegin(kSavedGprs); reg != rend(kSavedGprs); ++reg) {
+            mAssembler.pop(*reg);
+        }
+        mAssembler.ret();
+    }
+
+    //! Linear scan: ranges in order of their start get the next free register of their kind,
+    //! and when there is none, the range that ends last, of those holding one and this one,
+    //! stays in memory.
+    void JitCompiler::allocateVariables(const CompiledFunction &function) {
+        size_t slotCount = function.mLocalCount;
+        mLiveRanges.clear();
+        for (uint32_t slot = 0; slot < slotCount; ++slot) {
+            mLiveRanges.push_back(LiveRange{slot, false, SIZE_MAX, 0});
+        }
+        for (uint32_t slot = 0; slot < function.mParameterCount; ++slot) {
+            mLiveRanges[slot].mStart = 0; // Loaded by the prologue.
+        }
+
+        mBranchTargets.assign(function.mCode.size(), -1);
+        mTargetLabels.clear();
+        vector<pair<size_t, size_t>> loops; // Of each backward jump, its target and itself.
+        size_t argumentSlots = 0;
+        for (size_t index = 0; index < function.mCode.size(); ++index) {
+            Opcode opcode = Instruction::opcode(function.mCode[index]);
+            int32_t operand = Instruction::operand(function.mCode[index]);
+            switch (opcode) {
+                case Opcode::LOAD:
+                case Opcode::STORE: {
+                    LiveRange &range = mLiveRanges[size_t(operand)];
+                    range.mUsed = true;
+                    range.mStart = min(range.mStart, index);
+                    range.mEnd = max(range.mEnd, index);
+                    break;
+                }
+                case Opcode::JUMP:
+                case Opcode::JUMP_IF_NONZERO_I:
+                case Opcode::JUMP_IF_NONZERO_D:
+                case Opcode::JUMP_IF_LESS_I:
+                case Opcode::JUMP_IF_LESS_D: {
+                    size_t target = size_t(int64_t(index) + 1 + operand);
+                    if (mBranchTargets[target] < 0) {
+                        mBranchTargets[target] = int64_t(mTargetLabels.size());
+                        mTargetLabels.push_back(mAssembler.newLabel());
+                    }
+                    if (target <= index) {
+                        loops.emplace_back(target, index);
+                    }
+                    break;
+                }
+                case Opcode::CALL:
+                    argumentSlots = max(argumentSlots, size_t(mProgram.mFunctions[size_t(operand)].mParameterCount));
+                    break;
+                case Opcode::CALL_NATIVE:
+                    argumentSlots = max(argumentSlots, mProgram.mNativeCalls[size_t(operand)].mArgumentKinds.size());
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // A variable used in a loop may be needed by the next iteration, so it keeps its
+        // register for all of the loop, and of any loop around that.
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (LiveRange &range : mLiveRanges) {
+                for (const auto &[start, end] : loops) {
+                    if (range.mUsed && range.mStart <= end && range.mEnd >= start && (range.mStart > start || range.mEnd < end)) {
+                        range.mStart = min(range.mStart, start);
+                        range.mEnd = max(range.mEnd, end);
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        // The frame: outgoing arguments, then stack positions, then variables, rounded so that
+        // calls find the stack 16-byte aligned after the pushes of the prologue.
+        mTemporaryOffset = int32_t(8 * argumentSlots);
+        mVariableOffset = mTemporaryOffset + int32_t(8 * function.mMaxStackDepth);
+        mFrameSize = mVariableOffset + int32_t(8 * slotCount);
+        if (mFrameSize % 16 == 0) {
+            mFrameSize += 8;
+        }
+
+        mSlotLocations.clear();
+        for (uint32_t slot = 0; slot < slotCount; ++slot) {
+            mSlotLocations.push_back(Location{Location::MEMORY, 0, mVariableOffset + int32_t(8 * slot)});
+        }
+        vector<LiveRange> ranges;
+        for (const LiveRange &range : mLiveRanges) {
+            if (range.mUsed) {
+                ranges.push_back(range);
+            }
+        }
+        stable_sort(ranges.begin(), ranges.end(), [](const LiveRange &a, const LiveRange &b) { return a.mStart < b.mStart; });
+        vector<uint8_t> freeGprs;
+        vector<uint8_t> freeXmms;
+        for (auto reg = rbegin(kVariableGprs); reg != rend(kVariableGprs); ++reg) {
+            freeGprs.push_back(uint8_t(*reg));
+        }
+        for (auto reg = rbegin(kVariableXmms); reg != rend(kVariableXmms); ++reg) {
+            freeXmms.push_back(uint8_t(*reg));
+        }
+        vector<LiveRange> active;
+        for (const LiveRange &range : ranges) {
+            for (auto expired = active.begin(); expired != active.end();) {
+                if (expired->mEnd < range.mStart) {
+                    const Location &location = mSlotLocations[expired->mSlot];
+                    (location.mWhere == Location::XMM ? freeXmms : freeGprs).push_back(location.mRegister);
+                    expired = active.erase(expired);
+                } else {
+                    ++expired;
+                }
+            }
+            bool isDouble = function.mLocalKinds[range.mSlot] == ValueKind::DOUBLE;
+            Location::Where where = isDouble ? Location::XMM : Location::GPR;
+            vector<uint8_t> &freeRegisters = isDouble ? freeXmms : freeGprs;
+            if (!freeRegisters.empty()) {
+                mSlotLocations[range.mSlot] = Location{where, freeRegisters.back(), 0};
+                freeRegisters.pop_back();
+                active.push_back(range);
+                continue;
+            }
+            auto longest = active.end();
+            for (auto candidate = active.begin(); candidate != active.end(); ++candidate) {
+                if (mSlotLocations[candidate->mSlot].mWhere == where && (longest == active.end() || candidate->mEnd > longest->mEnd)) {
+                    longest = candidate;
+                }
+            }
+            if (longest != active.end() && longest->mEnd > range.mEnd) {
+                mSlotLocations[range.mSlot] = mSlotLocations[longest->mSlot];
+                mSlotLocations[longest->mSlot] = Location{Location::MEMORY, 0, mVariableOffset + int32_t(8 * longest->mSlot)};
+                active.erase(longest);
+                active.push_back(range);
+            }
+        }
+    }
+
+    void JitCompiler::emitPrologue(const CompiledFunction &function) {
+        for (Gpr reg : kSavedGprs) {
+            mAssembler.push(reg);
+        }
+        mAssembler.sub64(Gpr::RSP, mFrameSize);
+        mAssembler.mov(kContext, Gpr::RSI);
+        mAssembler.cmp(kCallDepth, int32_t(VirtualMachine::kMaxCallDepth));
+        mAssembler.j(Condition::ABOVE_OR_EQUAL, mNestedTooDeeply);
+        mAssembler.add(kCallDepth, 1);
+        for (uint32_t slot = 0; slot < function.mParameterCount; ++slot) {
+            if (!mLiveRanges[slot].mUsed) {
+                continue;
+            }
+            Memory source{Gpr::RDI, int32_t(8 * slot)};
+            const Location &destination = mSlotLocations[slot];
+            if (destination.mWhere == Location::GPR) {
+                mAssembler.mov(Gpr(destination.mRegister), source);
+            } else if (destination.mWhere == Location::XMM) {
+                mAssembler.movsd(Xmm(destination.mRegister), source);
+            } else {
+                mAssembler.mov(Gpr::RAX, source);
+                storeGpr(Gpr::RAX, destination);
+            }
+        }
+    }
+
+    void JitCompiler::emitEpilogue() {
+        mAssembler.sub(kCallDepth, 1);
+        mAssembler.add64(Gpr::RSP, mFrameSize);
+        for (auto reg = rbegin(kSavedGprs); reg != rend(kSavedGprs); ++reg) {
+            mAssembler.pop(*reg);
+        }
+        mAssembler.ret();
+    }
+
+    void JitCompiler::emitInstruction(uint32_t instruction, size_t index) {
+        Opcode opcode = Instruction::opcode(instruction);
+        int32_t operand = Instruction::operand(instruction);
+        size_t depth = mStack.size();
+        switch (opcode) {
+            case Opcode::PUSH_INTEGER:
+                push(ValueKind::INTEGER, Location{Location::IMMEDIATE, 0, operand});
+                break;
+            case Opcode::PUSH_CONSTANT: {
+                const Value &value = mProgram.mConstants[size_t(operand)];
+                if (mProgram.mConstantKinds[size_t(operand)] == ValueKind::INTEGER) {
+                    push(ValueKind::INTEGER, Location{Location::IMMEDIATE, 0, value.mInteger});
+                    break;
+                }
+                Location destination = temporary(depth, ValueKind::DOUBLE);
+                mAssembler.movImmediate(Gpr::RAX, bit_cast<uint64_t>(value.mDouble));
+                if (destination.mWhere == Location::XMM) {
+                    mAssembler.movq(Xmm(destination.mRegister), Gpr::RAX);
+                } else {
+                    storeGpr(Gpr::RAX, destination);
+                }
+                push(ValueKind::DOUBLE, destination);
+                break;
+            }
+            case Opcode::PUSH_STRING: {
+                Location destination = temporary(depth, ValueKind::STRING);
+                Gpr work = (destination.mWhere == Location::GPR) ? Gpr(destination.mRegister) : Gpr::RAX;
+                mAssembler.movImmediate(work, reinterpret_cast<uintptr_t>(&mProgram.mStrings[size_t(operand)]));
+                storeGpr(work, destination);
+                push(ValueKind::STRING, destination);
+                break;
+            }
+            case Opcode::LOAD:
+                push(mProgram.mFunctions[mFunctionIndex].mLocalKinds[size_t(operand)], mSlotLocations[size_t(operand)], operand);
+                break;
+            case Opcode::STORE: {
+                StackEntry value = pop();
+                const Location &destination = mSlotLocations[size_t(operand)];
+                // Loads of whatever the register or memory held before still need that value.
+                for (size_t position = 0; position < mStack.size(); ++position) {
+                    if (mStack[position].mSlot >= 0 && sameLocation(mStack[position].mLocation, destination)) {
+                        materialize(position);
+                    }
+                }
+                move(value, destination);
+                break;
+            }
+            case Opcode::POP:
+                pop();
+                break;
+            case Opcode::ADD_I:
+            case Opcode::SUBTRACT_I:
+            case Opcode::MULTIPLY_I: {
+                StackEntry right = pop();
+                StackEntry left = pop();
+                Location destination = temporary(depth - 2, ValueKind::INTEGER);
+                Gpr work = (destination.mWhere == Location::GPR) ? Gpr(destination.mRegister) : Gpr::RAX;
+                move(left, inRegister(work));
+                if (right.mLocation.mWhere == Location::IMMEDIATE) {
+                    int32_t immediate = right.mLocation.mValue;
+                    if (opcode == Opcode::ADD_I) {
+                        mAssembler.add(work, immediate);
+                    } else if (opcode == Opcode::SUBTRACT_I) {
+                        mAssembler.sub(work, immediate);
+                    } else {
+                        mAssembler.imul(work, work, immediate);
+                    }
+                } else if (opcode == Opcode::ADD_I) {
+                    mAssembler.add(work, right.mLocation.operand());
+                } else if (opcode == Opcode::SUBTRACT_I) {
+                    mAssembler.sub(work, right.mLocation.operand());
+                } else {
+                    mAssembler.imul(work, right.mLocation.operand());
+                }
+                storeGpr(work, destination);
+                push(ValueKind::INTEGER, destination);
+                break;
+            }
+            case Opcode::DIVIDE_I: {
+                StackEntry right = pop();
+                StackEntry left = pop();
+                Location destination = temporary(depth - 2, ValueKind::INTEGER);
+                move(left, inRegister(Gpr::RAX));
+                move(right, inRegister(Gpr::RCX));
+                bool mayFail = right.mLocation.mWhere != Location::IMMEDIATE || right.mLocation.mValue == 0
+                               || right.mLocation.mValue == -1;
+                if (mayFail) {
+                    // idiv traps on both, but divideIntegers throws for one and gives INT32_MIN for the other.
+                    Label divide = mAssembler.newLabel();
+                    Label done = mAssembler.newLabel();
+                    mAssembler.test(Gpr::RCX, Gpr::RCX);
+                    mAssembler.j(Condition::EQUAL, mDivisionByZero);
+                    mAssembler.cmp(Gpr::RCX, -1);
+                    mAssembler.j(Condition::NOT_EQUAL, divide);
+                    mAssembler.neg(Gpr::RAX);
+                    mAssembler.jmp(done);
+                    mAssembler.bind(divide);
+                    mAssembler.cdq();
+                    mAssembler.idiv(Gpr::RCX);
+                    mAssembler.bind(done);
+                } else {
+                    mAssembler.cdq();
+                    mAssembler.idiv(Gpr::RCX);
+                }
+                storeGpr(Gpr::RAX, destination);
+                push(ValueKind::INTEGER, destination);
+                break;
+            }
+            case Opcode::LESS_I:
+            case Opcode::LESS_D: {
+                StackEntry right = pop();
+                StackEntry left = pop();
+                Location destination = temporary(depth - 2, ValueKind::INTEGER);
+                if (opcode == Opcode::LESS_I) {
+                    Gpr leftRegister = loadGpr(left, Gpr::RAX);
+                    if (right.mLocation.mWhere == Location::IMMEDIATE) {
+                        mAssembler.cmp(leftRegister, right.mLocation.mValue);
+                    } else {
+                        mAssembler.cmp(leftRegister, right.mLocation.operand());
+                    }
+                    mAssembler.set(Condition::LESS, Gpr::RAX);
+                } else {
+                    // right > left rather than left < right, since comisd sets the flags of an
+                    // unsigned comparison, and "above" is false for NaN, as < should be.
+                    mAssembler.comisd(loadXmm(right, Xmm::XMM7), left.mLocation.operand());
+                    mAssembler.set(Condition::ABOVE, Gpr::RAX);
+                }
+                Gpr work = (destination.mWhere == Location::GPR) ? Gpr(destination.mRegister) : Gpr::RAX;
+                mAssembler.movzxByte(work, Gpr::RAX);
+                storeGpr(work, destination);
+                push(ValueKind::INTEGER, destination);
+                break;
+            }
+            case Opcode::NEGATE_I: {
+                StackEntry value = pop();
+                Location destination = temporary(depth - 1, ValueKind::INTEGER);
+                Gpr work = (destination.mWhere == Location::GPR) ? Gpr(destination.mRegister) : Gpr::RAX;
+                move(value, inRegister(work));
+                mAssembler.neg(work);
+                storeGpr(work, destination);
+                push(ValueKind::INTEGER, destination);
+                break;
+            }
+            case Opcode::ADD_D:
+            case Opcode::SUBTRACT_D:
+            case Opcode::MULTIPLY_D:
+            case Opcode::DIVIDE_D: {
+                StackEntry right = pop();
+                StackEntry left = pop();
+                Location destination = temporary(depth - 2, ValueKind::DOUBLE);
+                Xmm work = (destination.mWhere == Location::XMM) ? Xmm(destination.mRegister) : Xmm::XMM6;
+                move(left, inRegister(work));
+                Operand source = right.mLocation.operand();
+                if (opcode == Opcode::ADD_D) {
+                    mAssembler.addsd(work, source);
+                } else if (opcode == Opcode::SUBTRACT_D) {
+                    mAssembler.subsd(work, source);
+                } else if (opcode == Opcode::MULTIPLY_D) {
+                    mAssembler.mulsd(work, source);
+                } else {
+                    mAssembler.divsd(work, source);
+                }
+                storeXmm(work, destination);
+                push(ValueKind::DOUBLE, destination);
+                break;
+            }
+            case Opcode::NEGATE_D: {
+                StackEntry value = pop();
+                Location destination = temporary(depth - 1, ValueKind::DOUBLE);
+                if (value.mLocation.mWhere == Location::XMM) {
+                    mAssembler.movq(Gpr::RAX, Xmm(value.mLocation.mRegister));
+                } else {
+                    mAssembler.mov(Gpr::RAX, value.mLocation.operand());
+                }
+                mAssembler.btc(Gpr::RAX, 63);
+                if (destination.mWhere == Location::XMM) {
+                    mAssembler.movq(Xmm(destination.mRegister), Gpr::RAX);
+                } else {
+                    storeGpr(Gpr::RAX, destination);
+                }
+                push(ValueKind::DOUBLE, destination);
+                break;
+            }
+            case Opcode::INTEGER_TO_DOUBLE:
+            case Opcode::INTEGER_TO_DOUBLE_BELOW: {
+                size_t position = depth - ((opcode == Opcode::INTEGER_TO_DOUBLE) ? 1 : 2);
+                StackEntry value = mStack[position];
+                Location destination = temporary(position, ValueKind::DOUBLE);
+                Xmm work = (destination.mWhere == Location::XMM) ? Xmm(destination.mRegister) : Xmm::XMM6;
+                Operand source = (value.mLocation.mWhere == Location::IMMEDIATE) ? Operand(loadGpr(value, Gpr::RAX))
+                                                                                 : value.mLocation.operand();
+                mAssembler.xorpd(work, work); // cvtsi2sd would otherwise wait for the old value.
+                mAssembler.cvtsi2sd(work, source);
+                storeXmm(work, destination);
+                mStack[position] = StackEntry{ValueKind::DOUBLE, destination, -1};
+                break;
+            }
+            case Opcode::DOUBLE_TO_INTEGER: {
+                StackEntry value = pop();
+                Location destination = temporary(depth - 1, ValueKind::INTEGER);
+                Gpr work = (destination.mWhere == Location::GPR) ? Gpr(destination.mRegister) : Gpr::RAX;
+                mAssembler.cvttsd2si(work, value.mLocation.operand()); // Exactly doubleToInteger.
+                storeGpr(work, destination);
+                push(ValueKind::INTEGER, destination);
+                break;
+            }
+            case Opcode::WRAP_INT8:
+            case Opcode::WRAP_UINT8: {
+                StackEntry value = pop();
+                if (value.mLocation.mWhere == Location::IMMEDIATE) {
+                    int32_t immediate = value.mLocation.mValue;
+                    immediate = (opcode == Opcode::WRAP_INT8) ? int32_t(int8_t(immediate)) : int32_t(uint8_t(immediate));
+                    push(ValueKind::INTEGER, Location{Location::IMMEDIATE, 0, immediate});
+                    break;
+                }
+                Location destination = temporary(depth - 1, ValueKind::INTEGER);
+                Gpr work = (destination.mWhere == Location::GPR) ? Gpr(destination.mRegister) : Gpr::RAX;
+                Gpr source = loadGpr(value, Gpr::RAX);
+                if (opcode == Opcode::WRAP_INT8) {
+                    mAssembler.movsxByte(work, source);
+                } else {
+                    mAssembler.movzxByte(work, source);
+                }
+                storeGpr(work, destination);
+                push(ValueKind::INTEGER, destination);
+                break;
+            }
+            case Opcode::JUMP:
+            case Opcode::JUMP_IF_NONZERO_I:
+            case Opcode::JUMP_IF_NONZERO_D:
+            case Opcode::JUMP_IF_LESS_I:
+            case Opcode::JUMP_IF_LESS_D: {
+                Label target = mTargetLabels[size_t(mBranchTargets[size_t(int64_t(index) + 1 + operand)])];
+                if (opcode == Opcode::JUMP) {
+                    mAssembler.jmp(target);
+                } else if (opcode == Opcode::JUMP_IF_NONZERO_I) {
+                    StackEntry condition = pop();
+                    if (condition.mLocation.mWhere == Location::IMMEDIATE) {
+                        if (condition.mLocation.mValue != 0) {
+                            mAssembler.jmp(target);
+                        }
+                    } else if (condition.mLocation.mWhere == Location::GPR) {
+                        Gpr reg = Gpr(condition.mLocation.mRegister);
+                        mAssembler.test(reg, reg);
+                        mAssembler.j(Condition::NOT_EQUAL, target);
+                    } else {
+                        mAssembler.cmp(condition.mLocation.operand(), 0);
+                        mAssembler.j(Condition::NOT_EQUAL, target);
+                    }
+                } else if (opcode == Opcode::JUMP_IF_NONZERO_D) {
+                    StackEntry condition = pop();
+                    Xmm reg = loadXmm(condition, Xmm::XMM6);
+                    mAssembler.xorpd(Xmm::XMM7, Xmm::XMM7);
+                    mAssembler.ucomisd(reg, Xmm::XMM7);
+                    mAssembler.j(Condition::NOT_EQUAL, target);
+                    mAssembler.j(Condition::PARITY, target); // NaN isn't 0 either.
+                } else if (opcode == Opcode::JUMP_IF_LESS_I) {
+                    StackEntry right = pop();
+                    StackEntry left = pop();
+                    Gpr leftRegister = loadGpr(left, Gpr::RAX);
+                    if (right.mLocation.mWhere == Location::IMMEDIATE) {
+                        mAssembler.cmp(leftRegister, right.mLocation.mValue);
+                    } else {
+                        mAssembler.cmp(leftRegister, right.mLocation.operand());
+                    }
+                    mAssembler.j(Condition::LESS, target);
+                } else {
+                    StackEntry right = pop();
+                    StackEntry left = pop();
+                    mAssembler.comisd(loadXmm(right, Xmm::XMM7), left.mLocation.operand());
+                    mAssembler.j(Condition::ABOVE, target);
+                }
+                break;
+            }
+            case Opcode::CALL: {
+                prepareCall(mProgram.mFunctions[size_t(operand)].mParameterCount, index);
+                if (mCompiled[size_t(operand)]) {
+                    mAssembler.lea(Gpr::RDI, Memory{Gpr::RSP, 0});
+                    mAssembler.mov(Gpr::RSI, kContext);
+                    mAssembler.call(mFunctionLabels[size_t(operand)]);
+                } else {
+                    emitHelperCall(reinterpret_cast<uintptr_t>(&callInterpreted), uint32_t(operand), true);
+                }
+                finishCall(index);
+                push(ValueKind::INTEGER, Location{Location::IMMEDIATE, 0, 0});
+                break;
+            }
+            case Opcode::CALL_NATIVE: {
+                const NativeCall &call = mProgram.mNativeCalls[size_t(operand)];
+                prepareCall(call.mArgumentKinds.size(), index);
+                emitHelperCall(reinterpret_cast<uintptr_t>(&callNative), uint32_t(operand), true);
+                finishCall(index);
+                ValueKind kind = call.mFunction->mResultKind;
+                Location destination = temporary(mStack.size(), kind);
+                if (destination.mWhere == Location::XMM) {
+                    mAssembler.movq(Xmm(destination.mRegister), Gpr::RAX);
+                } else {
+                    storeGpr(Gpr::RAX, destination);
+                }
+                push(kind, destination);
+                break;
+            }
+            case Opcode::RETURN:
+                emitEpilogue();
+                break;
+            case Opcode::COUNT:
+                throw runtime_error("Invalid instruction.");
+        }
+    }
+
+    //! Leaves the arguments at the bottom of the frame, and everything else on the stack where
+    //! the callee can't overwrite it.
+    void JitCompiler::prepareCall(size_t argumentCount, size_t index) {
+        size_t first = mStack.size() - argumentCount;
+        for (size_t argument = 0; argument < argumentCount; ++argument) {
+            move(mStack[first + argument], Location{Location::MEMORY, 0, int32_t(8 * argument)});
+        }
+        mStack.resize(first);
+        for (size_t position = 0; position < mStack.size(); ++position) {
+            StackEntry &entry = mStack[position];
+            // XMM registers are all caller-saved, and of GPRs the temporary ones, which aren't variables'.
+            if (entry.mLocation.mWhere == Location::XMM || (entry.mLocation.mWhere == Location::GPR && entry.mSlot < 0)) {
+                Location home{Location::MEMORY, 0, mTemporaryOffset + int32_t(8 * position)};
+                move(entry, home);
+                entry = StackEntry{entry.mKind, home, -1};
+            }
+        }
+        for (size_t slot = 0; slot < mSlotLocations.size(); ++slot) {
+            const LiveRange &range = mLiveRanges[slot];
+            if (mSlotLocations[slot].mWhere == Location::XMM && range.mStart <= index && index <= range.mEnd) {
+                mAssembler.movsd(Memory{Gpr::RSP, mVariableOffset + int32_t(8 * slot)}, Xmm(mSlotLocations[slot].mRegister));
+            }
+        }
+    }
+
+    //! Restores what prepareCall saved and leaves the result, if any, in RAX.
+    void JitCompiler::finishCall(size_t index) {
+        for (size_t slot = 0; slot < mSlotLocations.size(); ++slot) {
+            const LiveRange &range = mLiveRanges[slot];
+            if (mSlotLocations[slot].mWhere == Location::XMM && range.mStart <= index && index <= range.mEnd) {
+                mAssembler.movsd(Xmm(mSlotLocations[slot].mRegister), Memory{Gpr::RSP, mVariableOffset + int32_t(8 * slot)});
+            }
+        }
+        mAssembler.cmpByte(kFailed, 0);
+        mAssembler.j(Condition::NOT_EQUAL, mFailureExit);
+    }
+
+    void JitCompiler::emitHelperCall(uintptr_t helper, uint32_t index, bool arguments) {
+        mAssembler.mov(Gpr::RDI, kContext);
+        mAssembler.movImmediate(Gpr::RSI, index);
+        if (arguments) {
+            mAssembler.lea(Gpr::RDX, Memory{Gpr::RSP, 0});
+        }
+        mAssembler.movImmediate(Gpr::RAX, helper);
+        mAssembler.call(Gpr::RAX);
+    }
+
+    JitCompiler::Location JitCompiler::temporary(size_t position, ValueKind kind) const {
+        if (kind == ValueKind::DOUBLE) {
+            if (position < size(kTemporaryXmms)) {
+                return inRegister(kTemporaryXmms[position]);
+            }
+        } else if (position < size(kTemporaryGprs)) {
+            return inRegister(kTemporaryGprs[position]);
+        }
+        return Location{Location::MEMORY, 0, mTemporaryOffset + int32_t(8 * position)};
+    }
+
+    void JitCompiler::materialize(size_t position) {
+        StackEntry &entry = mStack[position];
+        Location destination = temporary(position, entry.mKind);
+        move(entry, destination);
+        entry = StackEntry{entry.mKind, destination, -1};
+    }
+
+    Gpr JitCompiler::loadGpr(const StackEntry &entry, Gpr scratch) {
+        if (entry.mLocation.mWhere == Location::GPR) {
+            return Gpr(entry.mLocation.mRegister);
+        }
+        move(entry, inRegister(scratch));
+        return scratch;
+    }
+
+    Xmm JitCompiler::loadXmm(const StackEntry &entry, Xmm scratch) {
+        if (entry.mLocation.mWhere == Location::XMM) {
+            return Xmm(entry.mLocation.mRegister);
+        }
+        move(entry, inRegister(scratch));
+        return scratch;
+    }
+
+    void JitCompiler::storeGpr(Gpr source, const Location &destination) {
+        if (destination.mWhere == Location::GPR) {
+            mAssembler.mov(Gpr(destination.mRegister), source);
+        } else {
+            mAssembler.mov(Memory{Gpr::RSP, destination.mValue}, source);
+        }
+    }
+
+    void JitCompiler::storeXmm(Xmm source, const Location &destination) {
+        if (destination.mWhere == Location::XMM) {
+            mAssembler.movsd(Xmm(destination.mRegister), source);
+        } else {
+            mAssembler.movsd(Memory{Gpr::RSP, destination.mValue}, source);
+        }
+    }
+
+    void JitCompiler::move(const StackEntry &entry, const Location &destination) {
+        const Location &source = entry.mLocation;
+        if (sameLocation(source, destination)) {
+            return;
+        }
+        if (entry.mKind == ValueKind::DOUBLE) {
+            if (destination.mWhere == Location::XMM) {
+                mAssembler.movsd(Xmm(destination.mRegister), source.operand());
+            } else {
+                storeXmm(loadXmm(entry, Xmm::XMM6), destination);
+            }
+        } else if (source.mWhere == Location::IMMEDIATE) {
+            if (destination.mWhere == Location::GPR) {
+                mAssembler.movImmediate(Gpr(destination.mRegister), uint32_t(source.mValue));
+            } else {
+                mAssembler.mov(Memory{Gpr::RSP, destination.mValue}, source.mValue);
+            }
+        } else if (destination.mWhere == Location::GPR) {
+            mAssembler.mov(Gpr(destination.mRegister), source.operand());
+        } else {
+            storeGpr(loadGpr(entry, Gpr::RAX), destination);
+        }
+    }
+
+    void JitCompiler::push(ValueKind kind, Location location, int64_t slot) {
+        mStack.push_back(StackEntry{kind, location, slot});
+    }
+
+    JitCompiler::StackEntry JitCompiler::pop() {
+        StackEntry entry = mStack.back();
+        mStack.pop_back();
+        return entry;
+    }
+
+    Operand JitCompiler::Location::operand() const {
+        switch (mWhere) {
+            case GPR:
+                return Gpr(mRegister);
+            case XMM:
+                return Xmm(mRegister);
+            case MEMORY:
+                return Memory{Gpr::RSP, mValue};
+            case IMMEDIATE:
+                break;
+        }
+        throw logic_error("An immediate isn't an operand.");
+    }
+
+    bool JitCompiler::sameLocation(const Location &a, const Location &b) {
+        if (a.mWhere != b.mWhere || a.mWhere == Location::IMMEDIATE) {
+            return false;
+        }
+        return (a.mWhere == Location::MEMORY) ? a.mValue == b.mValue : a.mRegister == b.mRegister;
+    }
+
+    void JitCompiler::fail(JitContext *context, string message) {
+        context->mMachine->mJitError = std::move(message);
+        context->mFailed = true;
+    }
+
+    void JitCompiler::divisionByZero(JitContext *context, uint32_t function) {
+        fail(context, "Division by zero in " + context->mMachine->mProgram.mFunctions[function].mName + ".");
+    }
+
+    void JitCompiler::nestedTooDeeply(JitContext *context, uint32_t function) {
+        fail(context, "Calls nested too deeply in " + context->mMachine->mProgram.mFunctions[function].mName + ".");
+    }
+
+    int64_t JitCompiler::callNative(JitContext *context, uint32_t call, const Value *arguments) {
+        const VirtualMachine &machine = *context->mMachine;
+        const NativeCall &native = machine.mProgram.mNativeCalls[call];
+        try {
+            Value result = native.mFunction->mCall(span<const Value>(arguments, native.mArgumentKinds.size()),
+                                                   native.mArgumentKinds, *machine.mOut);
+            return (native.mFunction->mResultKind == ValueKind::DOUBLE) ? bit_cast<int64_t>(result.mDouble) : result.mInteger;
+        } catch (const exception &exception) {
+            fail(context, exception.what());
+            return 0;
+        }
+    }
+
+    void JitCompiler::callInterpreted(JitContext *context, uint32_t function, const Value *arguments) {
+        try {
+            context->mMachine->callFromJit(function, arguments);
+        } catch (const exception &exception) {
+            fail(context, exception.what());
+        }
+    }
+
+}
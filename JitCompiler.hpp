@@ -0,0 +1,200 @@
+#pragma once
+
+#include "Bytecode.hpp"
+#include "Value.hpp"
+#include "X86Assembler.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    class VirtualMachine;
+
+    //! What JIT code shares with the VirtualMachine running it. Standard layout, since the
+    //! code addresses the fields directly.
+    class JitContext {
+    public:
+        uint32_t mCallDepth{0}; // Calls running, in JIT code and in the VirtualMachine together.
+        bool mFailed{false}; // JIT code returns right away once set. The VirtualMachine has the message.
+        VirtualMachine *mMachine{nullptr};
+    };
+
+    //! Takes the arguments in the caller's memory, like CALL on the VirtualMachine's stack.
+    using JitEntry = void (*)(const Value *arguments, JitContext *context);
+
+    //! Machine code for some functions of a Program, in memory mapped executable, for a
+    //! VirtualMachine to call instead of interpreting their bytecode.
+    class JitCode {
+    public:
+        JitCode() = default;
+
+        ~JitCode();
+
+        JitCode(JitCode &&other) noexcept;
+
+        JitCode &operator=(JitCode &&other) noexcept;
+
+        JitCode(const JitCode &) = delete;
+
+        JitCode &operator=(const JitCode &) = delete;
+
+        //! nullptr if the function wasn't compiled.
+        JitEntry entry(uint32_t function) const { return (function < mEntries.size()) ? mEntries[function] : nullptr; }
+
+        size_t codeSize() const { return mCodeSize; }
+
+    private:
+        friend class JitCompiler;
+
+        void *mMemory{nullptr};
+        size_t mMappedSize{0};
+        size_t mCodeSize{0};
+        vector<JitEntry> mEntries; // One per function of the program.
+    };
+
+    //! Translates the bytecode of selected functions to x86-64 code for the System V ABI.
+    //!
+    //! Variables get registers by linear scan over their live ranges, which are stretched over
+    //! any loop they are used in: INT32 ones get callee-saved registers and double ones XMM8 to
+    //! XMM15, which are saved around calls. Variables left over stay in the frame. Operand stack
+    //! entries get a fixed register per depth, and the frame beyond that, and loads of variables
+    //! and integer constants aren't copied until something needs them to be.
+    //!
+    //! The code follows the VirtualMachine's rules exactly, down to INT32_MIN for doubles out
+    //! of range. Calls between compiled functions are direct; calls of the others and of native
+    //! functions go through the VirtualMachine. Instead of throwing, failing code sets
+    //! JitContext::mFailed and returns, since exceptions can't unwind through it.
+    class JitCompiler {
+    public:
+        static constexpr bool available() {
+#if SIMPLEPARSER_HAVE_JIT
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        //! Compiles the functions with the given indices. program must outlive the JitCode.
+        //! Throws a runtime_error if the JIT isn't available on this platform.
+        static JitCode compile(const Program &program, span<const uint32_t> functions);
+
+        //! All functions of program.
+        static JitCode compile(const Program &program);
+
+    private:
+        class Location {
+        public:
+            enum Where : uint8_t {
+                GPR,
+                XMM,
+                MEMORY, // [rsp + mValue].
+                IMMEDIATE // The INT32 mValue.
+            };
+
+            Where mWhere{MEMORY};
+            uint8_t mRegister{0};
+            int32_t mValue{0};
+
+            Operand operand() const;
+        };
+
+        class StackEntry {
+        public:
+            ValueKind mKind{ValueKind::INTEGER};
+            Location mLocation;
+            int64_t mSlot{-1}; // The variable whose location this is, if it is one.
+        };
+
+        class LiveRange {
+        public:
+            uint32_t mSlot{0};
+            bool mUsed{false};
+            size_t mStart{0}; // Instruction indices.
+            size_t mEnd{0};
+        };
+
+        JitCompiler(const Program &program, span<const uint32_t> functions);
+
+        void compileFunction(uint32_t index);
+
+        //! Gives each variable a register or a place in the frame, and lays out the frame.
+        void allocateVariables(const CompiledFunction &function);
+
+        void emitPrologue(const CompiledFunction &function);
+
+        void emitEpilogue();
+
+        void emitInstruction(uint32_t instruction, size_t index);
+
+        void prepareCall(size_t argumentCount, size_t index);
+
+        void finishCall(size_t index);
+
+        //! Calls a helper below with the context, index, and if arguments, the outgoing arguments.
+        void emitHelperCall(uintptr_t helper, uint32_t index, bool arguments);
+
+        //! Where the value at stack position goes when it is computed or copied.
+        Location temporary(size_t position, ValueKind kind) const;
+
+        //! Copies the entry at position to its temporary location.
+        void materialize(size_t position);
+
+        //! The register entry is in, or scratch, after loading entry into it.
+        Gpr loadGpr(const StackEntry &entry, Gpr scratch);
+
+        Xmm loadXmm(const StackEntry &entry, Xmm scratch);
+
+        void storeGpr(Gpr source, const Location &destination);
+
+        void storeXmm(Xmm source, const Location &destination);
+
+        void move(const StackEntry &entry, const Location &destination);
+
+        void push(ValueKind kind, Location location, int64_t slot = -1);
+
+        StackEntry pop();
+
+        static Location inRegister(Gpr reg) { return Location{Location::GPR, uint8_t(reg), 0}; }
+
+        static Location inRegister(Xmm reg) { return Location{Location::XMM, uint8_t(reg), 0}; }
+
+        static bool sameLocation(const Location &a, const Location &b);
+
+        static void fail(JitContext *context, string message);
+
+        static void divisionByZero(JitContext *context, uint32_t function);
+
+        static void nestedTooDeeply(JitContext *context, uint32_t function);
+
+        //! The result's bits, or the INT32 result.
+        static int64_t callNative(JitContext *context, uint32_t call, const Value *arguments);
+
+        static void callInterpreted(JitContext *context, uint32_t function, const Value *arguments);
+
+        const Program &mProgram;
+        X86Assembler mAssembler;
+        vector<bool> mCompiled; // Per function of the program.
+        vector<size_t> mFunctionOffsets;
+        vector<Label> mFunctionLabels;
+
+        // Of the function being compiled:
+        uint32_t mFunctionIndex{0};
+        vector<LiveRange> mLiveRanges; // Per slot.
+        vector<Location> mSlotLocations;
+        vector<int64_t> mBranchTargets; // Per instruction, the index of its Label in mTargetLabels if jumped to, else -1.
+        vector<Label> mTargetLabels;
+        vector<StackEntry> mStack;
+        int32_t mFrameSize{0};
+        int32_t mTemporaryOffset{0}; // Of the frame's copies of stack positions.
+        int32_t mVariableOffset{0}; // Of the frame's copies of variables.
+        Label mDivisionByZero;
+        Label mNestedTooDeeply;
+        Label mFailureExit;
+    };
+
+}
@@ -0,0 +1,92 @@
+#include "MappedFile.hpp"
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace simpleparser {
+
+    using namespace std;
+
+#if defined(_WIN32)
+
+    MappedFile::MappedFile(const string &path) {
+        mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (mFile == INVALID_HANDLE_VALUE) {
+            mFile = nullptr;
+            throw runtime_error("Can't open file.");
+        }
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(mFile, &fileSize)) {
+            CloseHandle(mFile);
+            throw runtime_error("Can't determine file size.");
+        }
+        mSize = size_t(fileSize.QuadPart);
+        if (mSize == 0) {
+            return; // Empty files can't be mapped, but also need no mapping.
+        }
+        mMapping = CreateFileMappingA(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mMapping) {
+            mData = static_cast<const char *>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (!mData) {
+            if (mMapping) { CloseHandle(mMapping); }
+            CloseHandle(mFile);
+            throw runtime_error("Can't map file into memory.");
+        }
+    }
+
+    MappedFile::~MappedFile() {
+        if (mData) { UnmapViewOfFile(mData); }
+        if (mMapping) { CloseHandle(mMapping); }
+        if (mFile) { CloseHandle(mFile); }
+    }
+
+#else
+
+    MappedFile::MappedFile(const string &path) {
+        int fileDescriptor = open(path.c_str(), O_RDONLY);
+        if (fileDescriptor < 0) {
+            throw runtime_error(string("Can't open file: ") + strerror(errno));
+        }
+        struct stat fileInfo{};
+        if (fstat(fileDescriptor, &fileInfo) != 0) {
+            int error = errno;
+            close(fileDescriptor);
+            throw runtime_error(string("Can't determine file size: ") + strerror(error));
+        }
+        mSize = size_t(fileInfo.st_size);
+        if (mSize > 0) { // Empty files can't be mapped, but also need no mapping.
+            void *data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+            if (data == MAP_FAILED) {
+                int error = errno;
+                close(fileDescriptor);
+                throw runtime_error(string("Can't map file into memory: ") + strerror(error));
+            }
+            mData = static_cast<const char *>(data);
+#if defined(POSIX_MADV_SEQUENTIAL)
+            posix_madvise(data, mSize, POSIX_MADV_SEQUENTIAL);
+#endif
+        }
+        close(fileDescriptor); // The mapping stays valid without the descriptor.
+    }
+
+    MappedFile::~MappedFile() {
+        if (mData) {
+            munmap(const_cast<char *>(mData), mSize);
+        }
+    }
+
+#endif
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! A file mapped read-only into memory, so it can be tokenized without copying it.
+    class MappedFile {
+    public:
+        //! Throws a runtime_error if the file can't be opened or mapped.
+        explicit MappedFile(const string &path);
+
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        string_view contents() const { return string_view(mData, mSize); }
+
+    private:
+        const char *mData{nullptr};
+        size_t mSize{0};
+#if defined(_WIN32)
+        void *mFile{nullptr};
+        void *mMapping{nullptr};
+#endif
+    };
+
+}
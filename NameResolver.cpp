@@ -0,0 +1,172 @@
+#include "NameResolver.hpp"
+#include "NativeFunctions.hpp"
+
+namespace simpleparser {
+
+    using namespace std;
+
+    vector<Diagnostic> NameResolver::resolve(map<string, FunctionDefinition> &functions) {
+        NameResolver resolver(functions);
+        for (auto &funcPair : functions) {
+            resolver.resolveFunction(funcPair.second);
+        }
+        return std::move(resolver.mErrors);
+    }
+
+    NameResolver::NameResolver(map<string, FunctionDefinition> &functions) {
+        mFunctionIds.reserve(functions.size());
+        for (const auto &funcPair : functions) {
+            uint32_t id = uint32_t(mFunctionIds.size());
+            mFunctionIds.emplace(funcPair.first, id);
+        }
+    }
+
+    void NameResolver::resolveFunction(FunctionDefinition &function) {
+        mFunction = &function;
+        mVariables.clear();
+        mDeclarations.clear();
+        mScopeStarts.clear();
+        mSlotKinds.clear();
+        mSlotsHeld.clear();
+
+        enterScope();
+        for (const ParameterDefinition &param : function.mParameters) {
+            declare(param.mName, param.mType);
+        }
+        for (Statement &statement : function.mStatements) {
+            resolveStatement(statement);
+        }
+        leaveScope();
+        function.mSlotCount = uint32_t(mSlotKinds.size());
+    }
+
+    void NameResolver::resolveStatement(Statement &statement) {
+        switch (statement.mKind) {
+            case StatementKind::VARIABLE_DECLARATION:
+                // The initial value can't see the variable yet, so "int x = x" means an outer x.
+                for (Statement &initialValue : statement.mParameters) {
+                    resolveExpression(initialValue);
+                }
+                statement.mSymbol = declare(statement.mName, statement.mType);
+                break;
+            case StatementKind::WHILE_LOOP:
+                if (!statement.mParameters.empty()) {
+                    resolveExpression(statement.mParameters[0]);
+                }
+                enterScope();
+                for (size_t index = 1; index < statement.mParameters.size(); ++index) {
+                    resolveStatement(statement.mParameters[index]);
+                }
+                leaveScope();
+                break;
+            default:
+                resolveExpression(statement);
+                break;
+        }
+    }
+
+    void NameResolver::resolveExpression(Statement &expression) {
+        // Walked rather than recursed into, since operator chains nest as deep as they're long.
+        class Visitor {
+        public:
+            NameResolver &mResolver;
+
+            void enter(Statement &operand, size_t) {
+                mResolver.resolveOperand(operand);
+            }
+
+            void leave(Statement &, size_t) {}
+        };
+        auto operands = [](Statement &operand) {
+            // A variable's operands, if it had any, would mean nothing.
+            return (operand.mKind == StatementKind::VARIABLE_NAME) ? span<Statement>() : span<Statement>(operand.mParameters);
+        };
+        mWalker.walk(span<Statement>(&expression, 1), operands, Visitor{*this});
+    }
+
+    void NameResolver::resolveOperand(Statement &operand) {
+        switch (operand.mKind) {
+            case StatementKind::VARIABLE_NAME: {
+                auto found = mVariables.find(operand.mName);
+                if (found == mVariables.end()) {
+                    operand.mSymbol = Statement::kUnresolved;
+                    report("Unknown variable " + operand.mName);
+                    return;
+                }
+                operand.mSymbol = found->second.mSlot;
+                operand.mType = found->second.mType;
+                return;
+            }
+            case StatementKind::FUNCTION_CALL:
+                resolveCall(operand);
+                return;
+            default:
+                return;
+        }
+    }
+
+    void NameResolver::resolveCall(Statement &call) {
+        auto foundFunction = mFunctionIds.find(call.mName);
+        if (foundFunction != mFunctionIds.end()) {
+            call.mSymbol = foundFunction->second;
+            return;
+        }
+        const NativeFunction *native = NativeFunction::find(call.mName);
+        if (native) {
+            call.mSymbol = kNativeFunction | uint32_t(native - NativeFunction::all().data());
+            return;
+        }
+        call.mSymbol = Statement::kUnresolved;
+        report("Unknown function " + call.mName);
+    }
+
+    uint32_t NameResolver::declare(string_view name, TypeID type) {
+        // Types that can't hold a value are BytecodeCompiler's to report; they get a slot anyway.
+        ValueKind kind = storageKind(type.builtin()).value_or(ValueKind::INTEGER);
+        uint32_t slot = 0;
+        while (slot < mSlotKinds.size() && (mSlotKinds[slot] != kind || mSlotsHeld[slot])) {
+            ++slot;
+        }
+        if (slot == mSlotKinds.size()) {
+            mSlotKinds.push_back(kind);
+            mSlotsHeld.push_back(false);
+        }
+        mSlotsHeld[slot] = true;
+
+        Declaration &declaration = mDeclarations.emplace_back();
+        declaration.mName = name;
+        declaration.mSlot = slot;
+        if (!name.empty()) {
+            auto [variable, added] = mVariables.try_emplace(name, Variable{slot, type});
+            if (!added) {
+                declaration.mHidden = variable->second;
+                variable->second = Variable{slot, type};
+            }
+        }
+        return slot;
+    }
+
+    void NameResolver::enterScope() {
+        mScopeStarts.push_back(mDeclarations.size());
+    }
+
+    void NameResolver::leaveScope() {
+        size_t start = mScopeStarts.back();
+        mScopeStarts.pop_back();
+        while (mDeclarations.size() > start) {
+            const Declaration &declaration = mDeclarations.back();
+            mSlotsHeld[declaration.mSlot] = false;
+            if (declaration.mHidden) {
+                mVariables[declaration.mName] = *declaration.mHidden;
+            } else if (!declaration.mName.empty()) {
+                mVariables.erase(declaration.mName);
+            }
+            mDeclarations.pop_back();
+        }
+    }
+
+    void NameResolver::report(const string &message) {
+        mErrors.push_back(Diagnostic{0, message + " in function " + mFunction->mName + "."});
+    }
+
+}
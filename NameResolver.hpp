@@ -0,0 +1,90 @@
+#pragma once
+
+#include "AstWalker.hpp"
+#include "Diagnostic.hpp"
+#include "FunctionDefinition.hpp"
+#include "Statement.hpp"
+#include "TypeTable.hpp"
+#include "Value.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Binds every name in a program to what it means, so nothing after it looks up a string:
+    //! each VARIABLE_DECLARATION and VARIABLE_NAME gets its variable's frame slot in mSymbol,
+    //! and each VARIABLE_NAME a copy of the variable's declared type. Each FUNCTION_CALL gets
+    //! the callee's function ID, its position in the map (which is also its index in a compiled
+    //! Program), or kNativeFunction or'ed with an index into NativeFunction::all().
+    //!
+    //! Parameters take the first slots, in order. Each variable then gets the lowest slot of its
+    //! kind that no variable in scope holds, so blocks that have ended give their slots back,
+    //! and every slot only ever holds one kind. Each function's slot count goes in mSlotCount.
+    class NameResolver {
+    public:
+        static constexpr uint32_t kNativeFunction = uint32_t(1) << 31;
+
+        //! Resolves all names in functions, replacing any earlier bindings. Names that aren't
+        //! defined stay Statement::kUnresolved, and are reported in the result, each sentence
+        //! the same one BytecodeCompiler would throw.
+        static vector<Diagnostic> resolve(map<string, FunctionDefinition> &functions);
+
+    private:
+        class Variable {
+        public:
+            uint32_t mSlot{0};
+            TypeID mType;
+        };
+
+        //! A declaration in scope, with whatever variable of the same name it hides.
+        class Declaration {
+        public:
+            string_view mName;
+            uint32_t mSlot{0};
+            optional<Variable> mHidden;
+        };
+
+        explicit NameResolver(map<string, FunctionDefinition> &functions);
+
+        void resolveFunction(FunctionDefinition &function);
+
+        void resolveStatement(Statement &statement);
+
+        void resolveExpression(Statement &expression);
+
+        //! Binds one node of an expression, but none of its operands.
+        void resolveOperand(Statement &operand);
+
+        void resolveCall(Statement &call);
+
+        //! Gives a variable of type a slot, and binds name to it if there is one.
+        uint32_t declare(string_view name, TypeID type);
+
+        void enterScope();
+
+        void leaveScope();
+
+        void report(const string &message);
+
+        unordered_map<string_view, uint32_t> mFunctionIds;
+        vector<Diagnostic> mErrors;
+        AstWalker<Statement> mWalker;
+
+        // Of the function being resolved:
+        const FunctionDefinition *mFunction{nullptr};
+        unordered_map<string_view, Variable> mVariables; // The innermost variable of each name.
+        vector<Declaration> mDeclarations; // In scope, innermost last.
+        vector<size_t> mScopeStarts; // Indices into mDeclarations.
+        vector<ValueKind> mSlotKinds;
+        vector<bool> mSlotsHeld;
+    };
+
+}
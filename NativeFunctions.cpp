@@ -0,0 +1,131 @@
+#include "NativeFunctions.hpp"
+#include <cstdio>
+#include <string>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    static int32_t integerArgument(Value argument, ValueKind kind, char conversion) {
+        if (kind == ValueKind::STRING) {
+            throw runtime_error(string("printf: %") + conversion + " needs a number, not a string.");
+        }
+        return (kind == ValueKind::DOUBLE) ? doubleToInteger(argument.mDouble) : argument.mInteger;
+    }
+
+    static double doubleArgument(Value argument, ValueKind kind, char conversion) {
+        if (kind == ValueKind::STRING) {
+            throw runtime_error(string("printf: %") + conversion + " needs a number, not a string.");
+        }
+        return (kind == ValueKind::DOUBLE) ? argument.mDouble : double(argument.mInteger);
+    }
+
+    template<class Argument>
+    static void appendFormatted(string &out, const string &specification, Argument argument) {
+        int length = snprintf(nullptr, 0, specification.c_str(), argument);
+        if (length <= 0) {
+            return;
+        }
+        size_t start = out.size();
+        out.resize(start + size_t(length) + 1);
+        snprintf(out.data() + start, size_t(length) + 1, specification.c_str(), argument);
+        out.resize(start + size_t(length));
+    }
+
+    //! Like C's printf, except that each conversion converts its argument to what it needs, so
+    //! "%d" of a double prints it rounded towards zero. Length modifiers like "l" are ignored,
+    //! and conversions without an argument left are printed as written.
+    static Value nativePrintf(span<const Value> arguments, span<const ValueKind> kinds, ostream &out) {
+        if (kinds[0] != ValueKind::STRING) {
+            throw runtime_error("printf needs a format string as its first argument.");
+        }
+        const string &format = *arguments[0].mString;
+        string result;
+        size_t nextArgument = 1;
+        size_t index = 0;
+        while (index < format.size()) {
+            size_t percent = format.find('%', index);
+            result.append(format, index, percent - index);
+            if (percent == string::npos) {
+                break;
+            }
+
+            // %[flags][width][.precision][length]conversion
+            size_t end = percent + 1;
+            string specification = "%";
+            while (end < format.size() && string_view("-+ #0").find(format[end]) != string_view::npos) {
+                specification += format[end++];
+            }
+            while (end < format.size() && ((format[end] >= '0' && format[end] <= '9') || format[end] == '.')) {
+                specification += format[end++];
+            }
+            while (end < format.size() && string_view("hlLqjzt").find(format[end]) != string_view::npos) {
+                ++end;
+            }
+            if (end == format.size()) {
+                result.append(format, percent);
+                break;
+            }
+            char conversion = format[end++];
+            index = end;
+            if (conversion == '%') {
+                result += '%';
+                continue;
+            }
+            if (string_view("diouxXcfFeEgGaAs").find(conversion) == string_view::npos || nextArgument == arguments.size()) {
+                result.append(format, percent, end - percent);
+                continue;
+            }
+
+            Value argument = arguments[nextArgument];
+            ValueKind kind = kinds[nextArgument];
+            ++nextArgument;
+            specification += conversion;
+            switch (conversion) {
+                case 'd':
+                case 'i':
+                case 'c':
+                    appendFormatted(result, specification, int(integerArgument(argument, kind, conversion)));
+                    break;
+                case 'o':
+                case 'u':
+                case 'x':
+                case 'X':
+                    appendFormatted(result, specification, unsigned(integerArgument(argument, kind, conversion)));
+                    break;
+                case 's':
+                    if (kind == ValueKind::STRING) {
+                        appendFormatted(result, specification, argument.mString->c_str());
+                    } else if (kind == ValueKind::DOUBLE) {
+                        appendFormatted(result, specification.substr(0, specification.size() - 1) + "g", argument.mDouble);
+                    } else {
+                        appendFormatted(result, specification.substr(0, specification.size() - 1) + "d", int(argument.mInteger));
+                    }
+                    break;
+                default:
+                    appendFormatted(result, specification, doubleArgument(argument, kind, conversion));
+                    break;
+            }
+        }
+        out.write(result.data(), streamsize(result.size()));
+        return Value::integer(int32_t(result.size()));
+    }
+
+    static const NativeFunction sNativeFunctions[] = {
+        {"printf", 1, ValueKind::INTEGER, nativePrintf}
+    };
+
+    const NativeFunction *NativeFunction::find(string_view name) {
+        for (const NativeFunction &function : sNativeFunctions) {
+            if (function.mName == name) {
+                return &function;
+            }
+        }
+        return nullptr;
+    }
+
+    span<const NativeFunction> NativeFunction::all() {
+        return sNativeFunctions;
+    }
+
+}
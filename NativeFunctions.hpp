@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Value.hpp"
+#include <cstddef>
+#include <ostream>
+#include <span>
+#include <string_view>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Implements a native function. kinds says what each of the arguments is. Throws a
+    //! runtime_error if the arguments don't make sense.
+    using NativeCallback = Value (*)(span<const Value> arguments, span<const ValueKind> kinds, ostream &out);
+
+    //! A function implemented in C++ that programs can call like one of their own, e.g. printf.
+    //! Native functions take any number of arguments of any kind, and check them themselves.
+    class NativeFunction {
+    public:
+        string_view mName;
+        size_t mMinimumArgumentCount{0};
+        ValueKind mResultKind{ValueKind::INTEGER};
+        NativeCallback mCall{nullptr};
+
+        //! nullptr if there is no native function of that name.
+        static const NativeFunction *find(string_view name);
+
+        static span<const NativeFunction> all();
+    };
+
+}
@@ -0,0 +1,45 @@
+#include "OutputBuffer.hpp"
+#include <algorithm>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    OutputBuffer::OutputBuffer(ostream &out)
+            : mOut(out), mBuffer(make_unique<char[]>(kCapacity)) {
+    }
+
+    OutputBuffer::~OutputBuffer() {
+        flush();
+    }
+
+    void OutputBuffer::fill(char ch, size_t count) {
+        while (count > 0) {
+            if (mSize == kCapacity) {
+                flush();
+            }
+            size_t amount = min(count, kCapacity - mSize);
+            memset(mBuffer.get() + mSize, ch, amount);
+            mSize += amount;
+            count -= amount;
+        }
+    }
+
+    void OutputBuffer::flush() {
+        if (mSize > 0) {
+            mOut.write(mBuffer.get(), streamsize(mSize));
+            mSize = 0;
+        }
+    }
+
+    void OutputBuffer::writeSlow(string_view text) {
+        flush();
+        if (text.size() >= kCapacity) {
+            mOut.write(text.data(), streamsize(text.size())); // Copying it first would gain nothing.
+            return;
+        }
+        memcpy(mBuffer.get(), text.data(), text.size());
+        mSize = text.size();
+    }
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Collects small writes in one large buffer and hands them to an ostream in big blocks, so
+    //! writing many short pieces costs little more than copying them. The buffer is kept for the
+    //! buffer's whole life, so reusing one for many documents allocates nothing.
+    class OutputBuffer {
+    public:
+        static constexpr size_t kCapacity = 64 * 1024;
+
+        //! out must outlive the buffer.
+        explicit OutputBuffer(ostream &out);
+
+        OutputBuffer(const OutputBuffer &) = delete;
+
+        OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+        //! Flushes.
+        ~OutputBuffer();
+
+        void write(string_view text) {
+            if (text.size() > kCapacity - mSize) {
+                writeSlow(text);
+                return;
+            }
+            memcpy(mBuffer.get() + mSize, text.data(), text.size());
+            mSize += text.size();
+        }
+
+        void put(char ch) {
+            if (mSize == kCapacity) {
+                flush();
+            }
+            mBuffer[mSize++] = ch;
+        }
+
+        //! count copies of ch, e.g. for indentation.
+        void fill(char ch, size_t count);
+
+        //! Hands everything written so far to the stream, which isn't flushed itself.
+        void flush();
+
+    private:
+        void writeSlow(string_view text);
+
+        ostream &mOut;
+        unique_ptr<char[]> mBuffer;
+        size_t mSize{0};
+    };
+
+}
@@ -0,0 +1,103 @@
+#include "ParseStats.hpp"
+#include "AstWalker.hpp"
+#include <iomanip>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace simpleparser {
+
+    using namespace std;
+
+    uint64_t ParseStats::peakResidentKilobytes() {
+#if defined(_WIN32)
+        PROCESS_MEMORY_COUNTERS counters{};
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return uint64_t(counters.PeakWorkingSetSize / 1024);
+#else
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+        return uint64_t(usage.ru_maxrss) / 1024; // Bytes on macOS.
+#else
+        return uint64_t(usage.ru_maxrss);
+#endif
+#endif
+    }
+
+    void ParseStats::countTokens(const TokenBuffer &tokens) {
+        for (TokenType type : tokens.types()) {
+            ++mTokenCounts[size_t(type)];
+        }
+    }
+
+    void ParseStats::countNodes(const map<string, FunctionDefinition> &functions) {
+        class Visitor {
+        public:
+            ParseStats &mStats;
+
+            void enter(const Statement &statement, size_t) { ++mStats.mNodeCounts[size_t(statement.mKind)]; }
+
+            void leave(const Statement &, size_t) {}
+        };
+        AstWalker<const Statement> walker;
+        for (const auto &funcPair : functions) {
+            walker.walk(funcPair.second.mStatements, statementChildren, Visitor{*this});
+        }
+    }
+
+    void ParseStats::merge(const ParseStats &other) {
+        for (size_t index = 0; index < mPhaseSeconds.size(); ++index) {
+            mPhaseSeconds[index] += other.mPhaseSeconds[index];
+        }
+        for (size_t index = 0; index < mTokenCounts.size(); ++index) {
+            mTokenCounts[index] += other.mTokenCounts[index];
+        }
+        for (size_t index = 0; index < mNodeCounts.size(); ++index) {
+            mNodeCounts[index] += other.mNodeCounts[index];
+        }
+        for (size_t index = 0; index < mProductions.size(); ++index) {
+            mProductions[index].mAttempts += other.mProductions[index].mAttempts;
+            mProductions[index].mSuccesses += other.mProductions[index].mSuccesses;
+            mProductions[index].mRewinds += other.mProductions[index].mRewinds;
+        }
+        mSourceCount += other.mSourceCount;
+        mCachedSourceCount += other.mCachedSourceCount;
+    }
+
+    void ParseStats::print(ostream &out) const {
+        out << "Sources: " << mSourceCount << " (" << mCachedSourceCount << " from cache)\n";
+
+        out << "\nPhase                      Seconds\n";
+        for (size_t index = 0; index < mPhaseSeconds.size(); ++index) {
+            out << "  " << left << setw(20) << sParsePhaseStrings[index] << right << setw(12)
+                << fixed << setprecision(6) << mPhaseSeconds[index] << defaultfloat << "\n";
+        }
+
+        out << "\nToken type                   Count\n";
+        for (size_t index = 0; index < mTokenCounts.size(); ++index) {
+            if (mTokenCounts[index] != 0) {
+                out << "  " << left << setw(20) << sTokenTypeStrings[index] << right << setw(12) << mTokenCounts[index] << "\n";
+            }
+        }
+
+        out << "\nNode kind                    Count\n";
+        for (size_t index = 0; index < mNodeCounts.size(); ++index) {
+            out << "  " << left << setw(20) << sStatementKindStrings[index] << right << setw(12) << mNodeCounts[index] << "\n";
+        }
+
+        out << "\nProduction                Attempts   Successes     Rewinds\n";
+        for (size_t index = 0; index < mProductions.size(); ++index) {
+            const ProductionCounts &counts = mProductions[index];
+            out << "  " << left << setw(20) << sParserProductionStrings[index] << right << setw(12) << counts.mAttempts
+                << setw(12) << counts.mSuccesses << setw(12) << counts.mRewinds << "\n";
+        }
+
+        out << "\nPeak memory: " << peakResidentKilobytes() << " KiB\n";
+    }
+
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "FunctionDefinition.hpp"
+#include "Statement.hpp"
+#include "Tokenizer.hpp"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    enum class ParsePhase : uint8_t {
+        READ,
+        TOKENIZE,
+        PARSE,
+        OPTIMIZE,
+        TEARDOWN,
+        COUNT
+    };
+
+    static const char *sParsePhaseStrings[] = {
+        "read",
+        "tokenize",
+        "parse",
+        "optimize",
+        "teardown"
+    };
+
+    //! The parser's expect*() functions, for counting how they are used and for memoizing
+    //! their failures.
+    enum class ParserProduction : uint8_t {
+        FUNCTION_DEFINITION,
+        FUNCTION_BODY,
+        STATEMENT,
+        VARIABLE_DECLARATION,
+        WHILE_LOOP,
+        FUNCTION_CALL,
+        EXPRESSION,
+        BINARY_EXPRESSION,
+        PREFIX_EXPRESSION,
+        ONE_VALUE,
+        TYPE,
+        IDENTIFIER,
+        OPERATOR,
+        COUNT
+    };
+
+    static const char *sParserProductionStrings[] = {
+        "FunctionDefinition",
+        "FunctionBody",
+        "Statement",
+        "VariableDeclaration",
+        "WhileLoop",
+        "FunctionCall",
+        "Expression",
+        "BinaryExpression",
+        "PrefixExpression",
+        "OneValue",
+        "Type",
+        "Identifier",
+        "Operator"
+    };
+
+    class ProductionCounts {
+    public:
+        uint64_t mAttempts{0};
+        uint64_t mSuccesses{0};
+        uint64_t mRewinds{0}; // Times it moved the token stream back to an earlier token.
+    };
+
+    //! Where parsing spends its time, for finding the hot spots of real inputs. Only compiled
+    //! in when SIMPLEPARSER_STATS is set; otherwise nothing is ever recorded and the hooks in
+    //! the parser compile to nothing.
+    class ParseStats {
+    public:
+        static constexpr bool enabled() {
+#if SIMPLEPARSER_STATS
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        //! Peak resident set size of the process so far, in KiB. Works in every build.
+        static uint64_t peakResidentKilobytes();
+
+        void countTokens(const TokenBuffer &tokens);
+
+        void countNodes(const map<string, FunctionDefinition> &functions);
+
+        //! Adds other's counts and times to these.
+        void merge(const ParseStats &other);
+
+        //! A table for people, not for scripts.
+        void print(ostream &out) const;
+
+        array<double, size_t(ParsePhase::COUNT)> mPhaseSeconds{}; // Summed over sources, even parallel ones.
+        array<uint64_t, size(sTokenTypeStrings)> mTokenCounts{};
+        array<uint64_t, size(sStatementKindStrings)> mNodeCounts{};
+        array<ProductionCounts, size_t(ParserProduction::COUNT)> mProductions{};
+        uint64_t mSourceCount{0};
+        uint64_t mCachedSourceCount{0}; // Their tokens, nodes and productions aren't counted.
+    };
+
+    static_assert(size(sParsePhaseStrings) == size_t(ParsePhase::COUNT));
+    static_assert(size(sParserProductionStrings) == size_t(ParserProduction::COUNT));
+
+    //! Adds the time between its construction and destruction, or stop(), to a phase. Does
+    //! nothing if stats is null or stats are disabled.
+    class PhaseTimer {
+    public:
+        PhaseTimer(ParseStats *stats, ParsePhase phase) : mStats(stats), mPhase(phase) {
+            if constexpr (ParseStats::enabled()) {
+                if (mStats) {
+                    mStart = chrono::steady_clock::now();
+                }
+            }
+        }
+
+        PhaseTimer(const PhaseTimer &) = delete;
+
+        PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+        ~PhaseTimer() { stop(); }
+
+        void stop() {
+            if constexpr (ParseStats::enabled()) {
+                if (mStats) {
+                    mStats->mPhaseSeconds[size_t(mPhase)] += chrono::duration<double>(chrono::steady_clock::now() - mStart).count();
+                    mStats = nullptr;
+                }
+            }
+        }
+
+    private:
+        ParseStats *mStats;
+        ParsePhase mPhase;
+        chrono::steady_clock::time_point mStart;
+    };
+
+    //! Counts an attempt at a production when constructed, and makes it the one that rewinds
+    //! are charged to until destroyed. Call succeeded() before returning a result.
+    class ProductionProbe {
+    public:
+        ProductionProbe(ParseStats *stats, ParserProduction &activeProduction, ParserProduction production)
+                : mStats(stats), mActiveProduction(activeProduction), mProduction(production), mOuterProduction(activeProduction) {
+            if constexpr (ParseStats::enabled()) {
+                if (mStats) {
+                    ++mStats->mProductions[size_t(production)].mAttempts;
+                    mActiveProduction = production;
+                }
+            }
+        }
+
+        ProductionProbe(const ProductionProbe &) = delete;
+
+        ProductionProbe &operator=(const ProductionProbe &) = delete;
+
+        ~ProductionProbe() {
+            if constexpr (ParseStats::enabled()) {
+                mActiveProduction = mOuterProduction;
+            }
+        }
+
+        void succeeded(bool success = true) {
+            if constexpr (ParseStats::enabled()) {
+                if (mStats && success) {
+                    ++mStats->mProductions[size_t(mProduction)].mSuccesses;
+                }
+            }
+        }
+
+    private:
+        ParseStats *mStats;
+        ParserProduction &mActiveProduction;
+        ParserProduction mProduction;
+        ParserProduction mOuterProduction;
+    };
+
+}
@@ -1,394 +1,747 @@
 #include "Parser.hpp"
+#include "AstWriter.hpp"
+#include "PassManager.hpp"
+#include "WorkStealingScheduler.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
 #include <iostream>
+#include <sstream>
 
 namespace simpleparser {
 
     using namespace std;
 
+    enum class Associativity {
+        LEFT,
+        RIGHT
+    };
+
     struct OperatorEntry {
-        string mName;
-        size_t mPrecedence;
+        TokenKind mKind{TokenKind::NONE};
+        size_t mPrecedence{0};
+        Associativity mAssociativity{Associativity::LEFT};
     };
 
-    static map<string, OperatorEntry> sOperators{
+    static constexpr OperatorEntry sOperators[] = {
             // precedence 0 is reserved for "no operator".
-            {"=", OperatorEntry{"=", 1}},
-            {"<", OperatorEntry{"<", 5}},
-            {"+", OperatorEntry{"+", 10}},
-            {"-", OperatorEntry{"-", 10}},
-            {"/", OperatorEntry{"/", 50}},
-            {"*", OperatorEntry{"*", 50}}
+            {TokenKind::ASSIGN, 1, Associativity::RIGHT},
+            {TokenKind::LESS_THAN, 5, Associativity::LEFT},
+            {TokenKind::PLUS, 10, Associativity::LEFT},
+            {TokenKind::MINUS, 10, Associativity::LEFT},
+            {TokenKind::SLASH, 50, Associativity::LEFT},
+            {TokenKind::ASTERISK, 50, Associativity::LEFT}
+    };
+
+    //! Unary operators in front of their operand. They bind tighter than any binary operator.
+    static constexpr OperatorEntry sUnaryOperators[] = {
+            {TokenKind::MINUS, 100, Associativity::RIGHT},
+            {TokenKind::PLUS, 100, Associativity::RIGHT}
+    };
+
+    template<size_t entryCount>
+    static constexpr array<OperatorEntry, size_t(TokenKind::COUNT)> makeOperatorTable(const OperatorEntry (&entries)[entryCount]) {
+        array<OperatorEntry, size_t(TokenKind::COUNT)> table{};
+        for (const OperatorEntry &entry : entries) {
+            table[size_t(entry.mKind)] = entry;
+        }
+        return table;
+    }
+
+    static constexpr array<OperatorEntry, size_t(TokenKind::COUNT)> sBinaryOperators = makeOperatorTable(sOperators);
+
+    static constexpr array<OperatorEntry, size_t(TokenKind::COUNT)> sPrefixOperators = makeOperatorTable(sUnaryOperators);
+
+    //! Counts one level of nesting for as long as it lives.
+    class NestingLevel {
+    public:
+        explicit NestingLevel(size_t &depth) : mDepth(depth) { ++mDepth; }
+
+        ~NestingLevel() { --mDepth; }
+
+    private:
+        size_t &mDepth;
     };
 
+    //! Below this, setting up a parser for a chunk costs more than parsing it elsewhere saves.
+    static constexpr size_t kMinimumChunkSize = 2048;
+
+    vector<size_t> Parser::findDefinitionEnds(const TokenBuffer &tokens, size_t minimumChunkSize) {
+        vector<size_t> chunkEnds;
+        size_t depth = 0;
+        size_t chunkStart = 0;
+        span<const TokenType> types = tokens.types();
+        span<const TokenKind> kinds = tokens.kinds();
+        for (size_t index = 0; index < types.size(); ++index) {
+            if (types[index] != OPERATOR) {
+                continue;
+            }
+            if (kinds[index] == TokenKind::OPEN_BRACE) {
+                ++depth;
+            } else if (kinds[index] == TokenKind::CLOSE_BRACE && depth > 0) {
+                --depth;
+                if (depth == 0 && index + 1 - chunkStart >= minimumChunkSize) {
+                    chunkEnds.push_back(index + 1);
+                    chunkStart = index + 1;
+                }
+            }
+        }
+        if (chunkStart < tokens.size()) {
+            chunkEnds.push_back(tokens.size());
+        }
+        return chunkEnds;
+    }
+
     bool Parser::expectFunctionDefinition() {
-        vector<Token>::iterator parseStart = mCurrentToken;
-        optional<Type> possibleType = expectType();
-        if (possibleType.has_value()) { // We have a type!
-            optional<Token> possibleName = expectIdentifier();
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::FUNCTION_DEFINITION);
 
-            if (possibleName.has_value()) { // We have a name!
-                optional<Token> possibleOperator = expectOperator("(");
+        // Only "type name (" can start a function, so check that before consuming anything.
+        if (!findType(mTokens->peek()) || !isNextToken(1, IDENTIFIER) || !isNextToken(2, OPERATOR, TokenKind::OPEN_PARENTHESIS)) {
+            return false;
+        }
 
-                if (possibleOperator.has_value()) { // We have a function!
+        size_t parseStart = mTokens->mark();
+        optional<TypeID> possibleType = expectType();
+        if (possibleType) { // We have a type!
+            TokenRef possibleName = expectIdentifier();
 
-                    FunctionDefinition func;
-                    func.mReturnsSomething = possibleType->mName != "void";
-                    func.mName = possibleName->mText;
+            if (possibleName) { // We have a name!
+                TokenRef possibleOperator = expectOperator(TokenKind::OPEN_PARENTHESIS);
 
-                    while(!expectOperator(")").has_value()) {
-                        optional<Type> possibleParamType = expectType();
-                        if (!possibleParamType.has_value()) {
-                            throw runtime_error("Expected a type at start of argument list.");
+                if (possibleOperator) { // We have a function!
+
+                    FunctionDefinition func;
+                    func.mReturnsSomething = possibleType->builtin() != VOID;
+                    func.mName = possibleName.text();
+
+                    while(!expectOperator(TokenKind::CLOSE_PARENTHESIS)) {
+                        optional<TypeID> possibleParamType = expectType();
+                        if (!possibleParamType) {
+                            reportError("Expected a type at start of argument list.");
+                            return false;
                         }
-                        optional<Token> possibleVariableName = expectIdentifier();
+                        TokenRef possibleVariableName = expectIdentifier();
 
                         ParameterDefinition param;
-                        param.mType = possibleParamType->mName;
-                        if (possibleVariableName.has_value()) {
-                            param.mName = possibleVariableName->mText;
+                        param.mType = *possibleParamType;
+                        if (possibleVariableName) {
+                            param.mName = possibleVariableName.text();
                         }
-                        func.mParameters.push_back(param);
+                        func.mParameters.push_back(std::move(param));
 
-                        if (expectOperator(")").has_value()) {
+                        if (expectOperator(TokenKind::CLOSE_PARENTHESIS)) {
                             break;
                         }
-                        if (!expectOperator(",").has_value()) {
-                            throw runtime_error("Expected ',' to separate parameters or ')' to indicate end of argument list.");
+                        if (!expectOperator(TokenKind::COMMA)) {
+                            reportError("Expected ',' to separate parameters or ')' to indicate end of argument list.");
+                            return false;
                         }
                     }
 
                     optional<vector<Statement>> statements = parseFunctionBody();
                     if (!statements.has_value()) {
-                        mCurrentToken = parseStart;
+                        if (!mPanicking) {
+                            backtrack(parseStart);
+                        }
                         return false;
                     }
-                    func.mStatements.insert(func.mStatements.begin(), statements->begin(), statements->end());
+                    func.mStatements = std::move(statements.value());
 
-                    mFunctions[func.mName] = func;
+                    string name = func.mName;
+                    mFunctions[name] = std::move(func);
 
+                    probe.succeeded();
                     return true;
                 } else {
-                    mCurrentToken = parseStart;
+                    backtrack(parseStart);
                 }
             } else {
-                mCurrentToken = parseStart;
+                backtrack(parseStart);
             }
         }
         return false;
     }
 
-    void Parser::parse(vector<Token> &tokens) {
-        mEndToken = tokens.end();
-        mCurrentToken = tokens.begin();
+    void Parser::parse(const TokenBuffer &tokens) {
+        TokenStream stream(tokens);
+        parse(stream);
+    }
+
+    void Parser::parse(TokenStream &tokens) {
+        mTokens = &tokens;
 
-        while(mCurrentToken != mEndToken) {
+        while(mTokens->peek()) {
             if (expectFunctionDefinition()) {
 
+            } else if (mPanicking) {
+                if (!mCollectErrors) {
+                    mTokens = nullptr;
+                    mPanicking = false;
+                    throw runtime_error(mErrors.back().mMessage);
+                }
+                skipToDefinitionEnd();
             } else {
-                cerr << "Unknown identifier " << mCurrentToken->mText << "." << endl;
-                ++mCurrentToken;
+                *mDiagnostics << "Unknown identifier " << mTokens->next().text() << "." << endl;
             }
+            // Top-level definitions never backtrack into each other.
+            mTokens->release();
+            mKnownFailures.clear();
         }
+
+        mTokens = nullptr;
+    }
+
+    void Parser::runPasses(const PassManager &passes) {
+        passes.run(mFunctions);
     }
 
-    optional<Token> Parser::expectIdentifier(const string &name) {
-        if (mCurrentToken == mEndToken) { return nullopt; }
-        if (mCurrentToken->mType != IDENTIFIER) { return nullopt; }
-        if (!name.empty() && mCurrentToken->mText != name) { return nullopt; }
+    void Parser::parse(const TokenBuffer &tokens, WorkStealingScheduler &scheduler) {
+        // A few chunks per thread, so threads that drew cheap chunks can help with the rest.
+        size_t minimumChunkSize = max(tokens.size() / (scheduler.threadCount() * 8), kMinimumChunkSize);
+        vector<size_t> chunkEnds = findDefinitionEnds(tokens, minimumChunkSize);
+        if (chunkEnds.size() < 2) {
+            parse(tokens);
+            return;
+        }
 
-        Token returnToken = *mCurrentToken;
-        ++mCurrentToken;
-        return returnToken;
+        struct ChunkResult {
+            Parser mParser;
+            ostringstream mDiagnostics;
+            ParseStats mStats;
+            bool mClean{false}; // Parsed as nothing but function definitions.
+        };
+        vector<ChunkResult> chunks(chunkEnds.size());
+        scheduler.run(chunks.size(), [&](size_t index) {
+            size_t chunkStart = (index == 0) ? 0 : chunkEnds[index - 1];
+            ChunkResult &chunk = chunks[index];
+            chunk.mParser.setDiagnosticStream(chunk.mDiagnostics);
+            chunk.mParser.setStats(mStats ? &chunk.mStats : nullptr);
+            chunk.mParser.setMaxNestingDepth(mMaxNestingDepth);
+            try {
+                TokenStream stream(tokens, chunkStart, chunkEnds[index] - chunkStart);
+                chunk.mParser.parse(stream);
+                chunk.mClean = (chunk.mDiagnostics.tellp() == 0 && chunk.mParser.mErrors.empty());
+            } catch (exception &) {
+                // Reported by the sequential parse below, in the right place and the right mode.
+            }
+        });
+
+        if (mStats) {
+            for (const ChunkResult &chunk : chunks) { // Also the discarded ones, whose work was done all the same.
+                mStats->merge(chunk.mStats);
+            }
+        }
+
+        // Definitions never look past their closing brace, so a clean chunk parsed exactly as
+        // it would have in one go. Merging in order keeps the last of duplicate definitions.
+        size_t parsedEnd = 0;
+        for (size_t index = 0; index < chunks.size() && chunks[index].mClean; ++index) {
+            Parser &chunkParser = chunks[index].mParser;
+            for (auto &[name, function] : chunkParser.mFunctions) {
+                mFunctions.insert_or_assign(name, std::move(function));
+            }
+            mBacktrackCount += chunkParser.mBacktrackCount;
+            mMemoHitCount += chunkParser.mMemoHitCount;
+            parsedEnd = chunkEnds[index];
+        }
+
+        // After a chunk with errors, a sequential parse may resynchronize somewhere other than
+        // a chunk boundary, so everything from there on is parsed the ordinary way.
+        if (parsedEnd < tokens.size()) {
+            TokenStream rest(tokens, parsedEnd, tokens.size() - parsedEnd);
+            parse(rest);
+        }
+    }
+
+    bool Parser::isNextToken(size_t k, TokenType type, TokenKind kind) {
+        TokenRef token = mTokens->peek(k);
+        return token && token.type() == type && (kind == TokenKind::NONE || token.kind() == kind);
     }
 
-    optional<Token> Parser::expectOperator(const string &name) {
-        if (mCurrentToken == mEndToken) { return nullopt; }
-        if (mCurrentToken->mType != OPERATOR) { return nullopt; }
-        if (!name.empty() && mCurrentToken->mText != name) { return nullopt; }
+    void Parser::backtrack(size_t position) {
+        if (position != mTokens->mark()) {
+            ++mBacktrackCount;
+            if constexpr (ParseStats::enabled()) {
+                if (mStats) {
+                    ++mStats->mProductions[size_t(mActiveProduction)].mRewinds;
+                }
+            }
+            mTokens->rewind(position);
+        }
+    }
 
-        Token returnToken = *mCurrentToken;
-        ++mCurrentToken;
-        return returnToken;
+    bool Parser::isKnownFailure(ParserProduction production, size_t position) {
+        if (mKnownFailures.count(memoKey(production, position)) == 0) {
+            return false;
+        }
+        ++mMemoHitCount;
+        return true;
+    }
+
+    void Parser::rememberFailure(ParserProduction production, size_t position) {
+        mKnownFailures.insert(memoKey(production, position));
+    }
+
+    TokenRef Parser::expectIdentifier(TokenKind kind) {
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::IDENTIFIER);
+        TokenRef token = mTokens->peek();
+        if (!token) { return TokenRef(); }
+        if (token.type() != IDENTIFIER) { return TokenRef(); }
+        if (kind != TokenKind::NONE && token.kind() != kind) { return TokenRef(); }
+
+        mTokens->next();
+        probe.succeeded();
+        return token;
+    }
+
+    TokenRef Parser::expectOperator(TokenKind kind) {
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::OPERATOR);
+        TokenRef token = mTokens->peek();
+        if (!token) { return TokenRef(); }
+        if (token.type() != OPERATOR) { return TokenRef(); }
+        if (kind != TokenKind::NONE && token.kind() != kind) { return TokenRef(); }
+
+        mTokens->next();
+        probe.succeeded();
+        return token;
     }
 
     Parser::Parser() {
-        mTypes["void"] = Type("void", VOID);
-        mTypes["int"] = Type("signed int", INT32);
-        mTypes["unsigned"] = Type("unsigned int", UINT32);
-        mTypes["char"] = Type("signed char", INT8);
-        mTypes["uint8_t"] = Type("uint8_t", INT8);
-        mTypes["double"] = Type("double", DOUBLE);
+        addType("void", Type("void", VOID));
+        addType("int", Type("signed int", INT32));
+        addType("unsigned", Type("unsigned int", UINT32));
+        addType("char", Type("signed char", INT8));
+        addType("uint8_t", Type("uint8_t", INT8));
+        addType("double", Type("double", DOUBLE));
     }
 
-    optional<Type> Parser::expectType() {
-        optional<Token> possibleType = expectIdentifier();
-        if (!possibleType) { return nullopt; }
+    void Parser::addType(string_view name, const Type &type) {
+        TypeID id = TypeTable::global().intern(type);
+        mTypes.insert_or_assign(string(name), id);
+        TokenKind kind = keywordKind(name);
+        if (kind != TokenKind::NONE) {
+            mKeywordTypes[size_t(kind)] = id;
+        }
+    }
 
-        map<string, Type>::iterator foundType = mTypes.find(possibleType->mText);
-        if (foundType == mTypes.end()) {
-            --mCurrentToken;
-            return nullopt;
+    optional<TypeID> Parser::findType(TokenRef token) const {
+        if (!token || token.type() != IDENTIFIER) { return nullopt; }
+
+        // Built-in type names are keywords, whose kind indexes the type directly.
+        if (token.kind() != TokenKind::NONE) {
+            return mKeywordTypes[size_t(token.kind())];
         }
+        auto foundEntry = mTypes.find(token.text());
+        return (foundEntry != mTypes.end()) ? optional<TypeID>(foundEntry->second) : nullopt;
+    }
 
-        return foundType->second;
+    optional<TypeID> Parser::expectType() {
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::TYPE);
+        optional<TypeID> foundType = findType(mTokens->peek());
+        if (foundType) {
+            mTokens->next();
+            probe.succeeded();
+        }
+        return foundType;
     }
 
     optional<vector<Statement>> Parser::parseFunctionBody() {
-        if (!expectOperator("{").has_value()) {
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::FUNCTION_BODY);
+        if (!expectOperator(TokenKind::OPEN_BRACE)) {
             return nullopt;
         }
 
         vector<Statement> statements;
 
-        while(!expectOperator("}").has_value()) {
+        while(!expectOperator(TokenKind::CLOSE_BRACE)) {
             optional<Statement> statement = expectStatement();
             if (statement.has_value()) {
-                statements.push_back(statement.value());
+                statements.push_back(std::move(statement.value()));
             }
 
-            if (!expectOperator(";").has_value()) {
-                size_t lineNo = (mCurrentToken != mEndToken) ? mCurrentToken->mLineNumber : 999999;
-                throw runtime_error(string("Expected ';' at end of statement in line ") + to_string(lineNo) + ".");
+            if (!mPanicking && !expectOperator(TokenKind::SEMICOLON)) {
+                reportMissingSemicolon();
+            }
+            if (mPanicking && !recoverInBlock()) {
+                return nullopt;
             }
         }
 
+        probe.succeeded();
         return statements;
     }
 
-    void Parser::debugPrint() const {
-        for (auto funcPair : mFunctions) {
-            funcPair.second.debugPrint();
+    void Parser::reportError(string message) {
+        TokenRef token = mTokens->peek();
+        mErrors.push_back(Diagnostic{token ? token.lineNumber() : 0, std::move(message)});
+        mPanicking = true;
+    }
+
+    bool Parser::isNestedTooDeeply() {
+        if (mNestingDepth <= mMaxNestingDepth) {
+            return false;
+        }
+        reportError("Expressions and loops can't be nested more than " + to_string(mMaxNestingDepth) + " levels deep.");
+        return true;
+    }
+
+    void Parser::reportMissingSemicolon() {
+        TokenRef token = mTokens->peek();
+        size_t lineNo = token ? token.lineNumber() : 999999;
+        reportError(string("Expected ';' at end of statement in line ") + to_string(lineNo) + ".");
+    }
+
+    bool Parser::recoverInBlock() {
+        if (!mCollectErrors) {
+            return false;
         }
+        size_t depth = 0;
+        while (TokenRef token = mTokens->peek()) {
+            if (token.type() == OPERATOR) {
+                if (token.kind() == TokenKind::CLOSE_BRACE && depth == 0) {
+                    mPanicking = false; // Ends the block, so leave it to the caller.
+                    return true;
+                }
+                if (token.kind() == TokenKind::SEMICOLON && depth == 0) {
+                    mTokens->next();
+                    mPanicking = false;
+                    return true;
+                }
+                if (token.kind() == TokenKind::OPEN_BRACE) {
+                    ++depth;
+                } else if (token.kind() == TokenKind::CLOSE_BRACE) {
+                    --depth;
+                }
+            }
+            mTokens->next();
+        }
+        return false;
+    }
+
+    void Parser::skipToDefinitionEnd() {
+        size_t depth = 0;
+        while (TokenRef token = mTokens->next()) {
+            if (token.type() != OPERATOR) {
+                continue;
+            }
+            if (token.kind() == TokenKind::OPEN_BRACE) {
+                ++depth;
+            } else if (token.kind() == TokenKind::CLOSE_BRACE && depth > 0) {
+                --depth;
+            }
+            if (depth == 0 && (token.kind() == TokenKind::CLOSE_BRACE || token.kind() == TokenKind::SEMICOLON)) {
+                break;
+            }
+        }
+        mPanicking = false;
+    }
+
+    void Parser::debugPrint() const {
+        PrettyAstWriter(cout).write(mFunctions);
     }
 
     optional<Statement> Parser::expectOneValue() {
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::ONE_VALUE);
         optional<Statement> result;
-        auto savedToken = mCurrentToken;
+        TokenRef currentToken = mTokens->peek();
 
-        if (mCurrentToken != mEndToken && mCurrentToken->mType == DOUBLE_LITERAL) {
-            Statement doubleLiteralStatement;
+        if (currentToken && currentToken.type() == DOUBLE_LITERAL) {
+            Statement &doubleLiteralStatement = result.emplace();
             doubleLiteralStatement.mKind = StatementKind::LITERAL;
-            doubleLiteralStatement.mName = mCurrentToken->mText;
-            doubleLiteralStatement.mType = Type("double", DOUBLE);
-            result = doubleLiteralStatement;
-            ++mCurrentToken;
-        } else if (mCurrentToken != mEndToken && mCurrentToken->mType == INTEGER_LITERAL) {
-            Statement integerLiteralStatement;
+            doubleLiteralStatement.mName = currentToken.text();
+            doubleLiteralStatement.mType = TypeTable::kDouble;
+            string_view text = currentToken.text();
+            if (from_chars(text.data(), text.data() + text.size(), doubleLiteralStatement.mDoubleValue).ec != errc()) {
+                // Out of range, which from_chars leaves alone, but strtod rounds to infinity or zero.
+                doubleLiteralStatement.mDoubleValue = strtod(string(text).c_str(), nullptr);
+            }
+            mTokens->next();
+        } else if (currentToken && currentToken.type() == INTEGER_LITERAL) {
+            Statement &integerLiteralStatement = result.emplace();
             integerLiteralStatement.mKind = StatementKind::LITERAL;
-            integerLiteralStatement.mName = mCurrentToken->mText;
-            integerLiteralStatement.mType = Type("signed integer", INT32);
-            result = integerLiteralStatement;
-            ++mCurrentToken;
-        } else if (mCurrentToken != mEndToken && mCurrentToken->mType == STRING_LITERAL) {
-            Statement stringLiteralStatement;
+            integerLiteralStatement.mName = currentToken.text();
+            integerLiteralStatement.mType = TypeTable::kInteger;
+            string_view text = currentToken.text();
+            if (from_chars(text.data(), text.data() + text.size(), integerLiteralStatement.mIntegerValue).ec != errc()) {
+                reportError(string("Integer literal ") + string(text) + " is too large.");
+                result.reset();
+                return result;
+            }
+            mTokens->next();
+        } else if (currentToken && currentToken.type() == STRING_LITERAL) {
+            Statement &stringLiteralStatement = result.emplace();
             stringLiteralStatement.mKind = StatementKind::LITERAL;
-            stringLiteralStatement.mName = mCurrentToken->mText;
-            stringLiteralStatement.mType = Type("string", UINT8);
-            result = stringLiteralStatement;
-            ++mCurrentToken;
-        } else if (expectOperator("(").has_value()) {
+            stringLiteralStatement.mName = currentToken.text();
+            stringLiteralStatement.mType = TypeTable::kString;
+            mTokens->next();
+        } else if (expectOperator(TokenKind::OPEN_PARENTHESIS)) {
             result = expectExpression();
-            if (!expectOperator(")").has_value()) {
-                throw runtime_error("Unbalanced '(' in parenthesized expression.");
+            if (!mPanicking && !expectOperator(TokenKind::CLOSE_PARENTHESIS)) {
+                reportError("Unbalanced '(' in parenthesized expression.");
+                result.reset();
             }
-        } else if (auto variableName = expectIdentifier()) {
-            if (expectOperator("(")) {
-                mCurrentToken = savedToken;
+        } else if (currentToken && currentToken.type() == IDENTIFIER) {
+            if (isNextToken(1, OPERATOR, TokenKind::OPEN_PARENTHESIS)) {
+                result = expectFunctionCall();
             } else {
-                Statement variableNameStatement;
+                Statement &variableNameStatement = result.emplace();
                 variableNameStatement.mKind = StatementKind::VARIABLE_NAME;
-                variableNameStatement.mName = variableName->mText;
-                result = variableNameStatement;
+                variableNameStatement.mName = currentToken.text();
+                mTokens->next();
             }
         }
-        if (!result.has_value()) {
-            result = expectFunctionCall();
-        }
+        probe.succeeded(result.has_value());
         return result;
     }
 
     optional<Statement> Parser::expectVariableDeclaration() {
-        vector<Token>::iterator startToken = mCurrentToken;
-        optional<Type> possibleType = expectType();
-        if (!possibleType.has_value()) {
-            mCurrentToken = startToken;
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::VARIABLE_DECLARATION);
+        size_t startToken = mTokens->mark();
+        optional<TypeID> possibleType = expectType();
+        if (!possibleType) {
+            backtrack(startToken);
             return nullopt;
         }
 
-        optional<Token> possibleVariableName = expectIdentifier();
-        if (!possibleType.has_value()) {
-            mCurrentToken = startToken;
+        TokenRef possibleVariableName = expectIdentifier();
+        if (!possibleVariableName) {
+            backtrack(startToken);
             return nullopt;
         }
 
         Statement statement;
 
         statement.mKind = StatementKind::VARIABLE_DECLARATION;
-        statement.mName = possibleVariableName->mText;
-        statement.mType = possibleType.value();
+        statement.mName = possibleVariableName.text();
+        statement.mType = *possibleType;
 
-        if (expectOperator("=").has_value()) {
+        if (expectOperator(TokenKind::ASSIGN)) {
             optional<Statement> initialValue = expectExpression();
             if (!initialValue.has_value()) {
-                throw runtime_error("Expected initial value to right of '=' in variable declaration.");
+                if (!mPanicking) {
+                    reportError("Expected initial value to right of '=' in variable declaration.");
+                }
+                return nullopt;
             }
 
-            statement.mParameters.push_back(initialValue.value());
+            statement.mParameters.push_back(std::move(initialValue.value()));
         }
 
+        probe.succeeded();
         return statement;
     }
 
     optional<Statement> Parser::expectFunctionCall() {
-        vector<Token>::iterator startToken = mCurrentToken;
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::FUNCTION_CALL);
+        size_t startToken = mTokens->mark();
 
-        optional<Token> possibleFunctionName = expectIdentifier();
-        if (!possibleFunctionName.has_value()) {
-            mCurrentToken = startToken;
+        TokenRef possibleFunctionName = expectIdentifier();
+        if (!possibleFunctionName) {
+            backtrack(startToken);
             return nullopt;
         }
 
-        if (!expectOperator("(").has_value()) {
-            mCurrentToken = startToken;
+        if (!expectOperator(TokenKind::OPEN_PARENTHESIS)) {
+            backtrack(startToken);
             return nullopt;
         }
 
         Statement functionCall;
         functionCall.mKind = StatementKind::FUNCTION_CALL;
-        functionCall.mName = possibleFunctionName->mText;
+        functionCall.mName = possibleFunctionName.text();
 
-        while(!expectOperator(")").has_value()) {
+        while(!expectOperator(TokenKind::CLOSE_PARENTHESIS)) {
             optional<Statement> parameter = expectExpression();
             if (!parameter.has_value()) {
-                throw runtime_error("Expected expression as parameter.");
+                if (!mPanicking) {
+                    reportError("Expected expression as parameter.");
+                }
+                return nullopt;
             }
-            functionCall.mParameters.push_back(parameter.value());
+            functionCall.mParameters.push_back(std::move(parameter.value()));
 
-            if (expectOperator(")").has_value()) {
+            if (expectOperator(TokenKind::CLOSE_PARENTHESIS)) {
                 break;
             }
-            if (!expectOperator(",").has_value()) {
-                // TODO: Check whether we still have a current token.
-                throw runtime_error(string("Expected ',' to separate parameters, found '") + mCurrentToken->mText + "'.");
+            if (!expectOperator(TokenKind::COMMA)) {
+                TokenRef found = mTokens->peek();
+                reportError(string("Expected ',' to separate parameters, found '")
+                            + (found ? string(found.text()) : string("end of file")) + "'.");
+                return nullopt;
             }
         }
 
+        probe.succeeded();
         return functionCall;
     }
 
     optional<Statement> Parser::expectWhileLoop() {
-        Statement whileLoop{"", Type{"void", VOID}, {}, StatementKind::WHILE_LOOP };
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::WHILE_LOOP);
+        if (isNestedTooDeeply()) {
+            return nullopt;
+        }
+        NestingLevel level(mNestingDepth);
+        Statement whileLoop;
+        whileLoop.mKind = StatementKind::WHILE_LOOP;
 
-        size_t lineNo = (mCurrentToken != mEndToken) ? mCurrentToken->mLineNumber : SIZE_MAX;
-        if (!expectIdentifier("while")) {
+        // The token whose line errors mention. Its line number is only looked up for those.
+        TokenRef lineToken = mTokens->peek();
+        if (!expectIdentifier(TokenKind::WHILE_KEYWORD)) {
             return nullopt;
         }
 
-        if (!expectOperator("(")) {
-            throw runtime_error(string("Expected opening parenthesis after \"while\" on line ") + to_string(lineNo) + ".");
+        if (!expectOperator(TokenKind::OPEN_PARENTHESIS)) {
+            reportError(string("Expected opening parenthesis after \"while\" on line ") + to_string(lineToken.lineNumber()) + ".");
+            return nullopt;
         }
 
-        if (mCurrentToken != mEndToken) {
-            lineNo = mCurrentToken->mLineNumber;
+        if (mTokens->peek()) {
+            lineToken = mTokens->peek();
         }
         optional<Statement> condition = expectExpression();
         if (!condition) {
-            throw runtime_error(string("Expected loop condition after \"while\" statement on line ") + to_string(lineNo) + ".");
+            if (!mPanicking) {
+                reportError(string("Expected loop condition after \"while\" statement on line ") + to_string(lineToken.lineNumber()) + ".");
+            }
+            return nullopt;
         }
 
-        whileLoop.mParameters.push_back(condition.value());
+        whileLoop.mParameters.push_back(std::move(condition.value()));
 
-        if (!expectOperator(")")) {
-            throw runtime_error(string("Expected closing parenthesis after \"while\" condition on line ") + to_string(lineNo) + ".");
+        if (!expectOperator(TokenKind::CLOSE_PARENTHESIS)) {
+            reportError(string("Expected closing parenthesis after \"while\" condition on line ") + to_string(lineToken.lineNumber()) + ".");
+            return nullopt;
         }
 
-        if (!expectOperator("{")) {
-            throw runtime_error(string("Expected opening curly bracket after \"while\" condition on line ") + to_string(lineNo) + ".");
+        if (!expectOperator(TokenKind::OPEN_BRACE)) {
+            reportError(string("Expected opening curly bracket after \"while\" condition on line ") + to_string(lineToken.lineNumber()) + ".");
+            return nullopt;
         }
 
-        while (mCurrentToken != mEndToken && !expectOperator("}")) {
+        while (mTokens->peek() && !expectOperator(TokenKind::CLOSE_BRACE)) {
             auto currentStatement = expectStatement();
-            if (!currentStatement) {
+            if (currentStatement) {
+                whileLoop.mParameters.push_back(std::move(currentStatement.value()));
+            } else if (!mPanicking) {
                 break;
             }
-            whileLoop.mParameters.push_back(currentStatement.value());
 
-            if (!expectOperator(";").has_value()) {
-                size_t lineNo = (mCurrentToken != mEndToken) ? mCurrentToken->mLineNumber : 999999;
-                throw runtime_error(string("Expected ';' at end of statement in line ") + to_string(lineNo) + ".");
+            if (!mPanicking && !expectOperator(TokenKind::SEMICOLON)) {
+                reportMissingSemicolon();
+            }
+            if (mPanicking && !recoverInBlock()) {
+                return nullopt;
             }
         }
 
+        probe.succeeded();
         return whileLoop;
     }
 
     optional<Statement> Parser::expectStatement() {
-        optional<Statement> result = expectWhileLoop();
-        if (!result.has_value()) {
-            result = expectVariableDeclaration();
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::STATEMENT);
+
+        // One or two tokens tell which kind of statement this is, so nothing is tried and undone.
+        TokenRef token = mTokens->peek();
+        optional<Statement> statement;
+        if (!token) {
+            return statement;
         }
-        if (!result.has_value()) {
-            result = expectExpression();
+        if (token.kind() == TokenKind::WHILE_KEYWORD) {
+            statement = expectWhileLoop();
+        } else if (findType(token) && isNextToken(1, IDENTIFIER)) {
+            statement = expectVariableDeclaration();
+        } else {
+            statement = expectExpression();
         }
-        return result;
+        probe.succeeded(statement.has_value());
+        return statement;
     }
 
     optional<Statement> Parser::expectExpression() {
-        optional<Statement> lhs = expectOneValue();
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::EXPRESSION);
+        optional<Statement> expression = expectBinaryExpression(1);
+        probe.succeeded(expression.has_value());
+        return expression;
+    }
+
+    //! Precedence climbing: parses operators of at least minPrecedence, recursing only for
+    //! tighter-binding ones, so each token is looked at once and no subtree is ever copied.
+    optional<Statement> Parser::expectBinaryExpression(size_t minPrecedence) {
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::BINARY_EXPRESSION);
+        // Every kind of nested expression comes through here: operands in parentheses, of
+        // prefix operators, of right-associative and tighter-binding operators, and arguments.
+        if (isNestedTooDeeply()) {
+            return nullopt;
+        }
+        NestingLevel level(mNestingDepth);
+        optional<Statement> lhs = expectPrefixExpression();
         if (!lhs.has_value()) { return nullopt; }
 
         while (true) {
-            optional<Token> op = expectOperator();
-            if (!op.has_value()) { break; }
-            int rhsPrecedence = operatorPrecedence(op->mText);
-            if (rhsPrecedence == 0) {
-                --mCurrentToken;
-                return lhs;
-            }
-            optional<Statement> rhs = expectOneValue();
+            TokenRef op = mTokens->peek();
+            if (!op || op.type() != OPERATOR) { break; }
+            const OperatorEntry &entry = sBinaryOperators[size_t(op.kind())];
+            if (entry.mPrecedence == 0 || entry.mPrecedence < minPrecedence) { break; }
+
+            size_t operatorStart = mTokens->mark();
+            mTokens->next();
+
+            size_t rhsMinPrecedence = entry.mPrecedence + (entry.mAssociativity == Associativity::LEFT ? 1 : 0);
+            optional<Statement> rhs = expectBinaryExpression(rhsMinPrecedence);
             if (!rhs.has_value()) {
-                --mCurrentToken;
-                return lhs;
+                if (mPanicking) {
+                    return nullopt;
+                }
+                backtrack(operatorStart);
+                break;
             }
 
-            Statement * rightmostStatement = findRightmostStatement(&lhs.value(), rhsPrecedence);
-            if (rightmostStatement) {
-                Statement operatorCall;
-                operatorCall.mKind = StatementKind::OPERATOR_CALL;
-                operatorCall.mName = op->mText;
-                operatorCall.mParameters.push_back(rightmostStatement->mParameters.at(1));
-                operatorCall.mParameters.push_back(rhs.value());
-                rightmostStatement->mParameters[1] = operatorCall;
-            } else {
-                Statement operatorCall;
-                operatorCall.mKind = StatementKind::OPERATOR_CALL;
-                operatorCall.mName = op->mText;
-                operatorCall.mParameters.push_back(lhs.value());
-                operatorCall.mParameters.push_back(rhs.value());
-                lhs = operatorCall;
-            }
+            Statement operatorCall;
+            operatorCall.mKind = StatementKind::OPERATOR_CALL;
+            operatorCall.mName = op.text(); // Not before, since parsing rhs may read more input, moving the text.
+            operatorCall.mParameters.reserve(2);
+            operatorCall.mParameters.push_back(std::move(lhs.value()));
+            operatorCall.mParameters.push_back(std::move(rhs.value()));
+            lhs = std::move(operatorCall);
         }
 
+        probe.succeeded();
         return lhs;
     }
 
-    Statement * Parser::findRightmostStatement(Statement *lhs, size_t rhsPrecedence) {
-        if (lhs->mKind != StatementKind::OPERATOR_CALL) { return nullptr; }
-        if (operatorPrecedence(lhs->mName) >= rhsPrecedence) { return nullptr; }
-
-        Statement * rhs = &lhs->mParameters.at(1);
-        rhs = findRightmostStatement(rhs, rhsPrecedence);
-        if (rhs == nullptr) { return lhs; }
-        return rhs;
-    }
+    optional<Statement> Parser::expectPrefixExpression() {
+        TokenRef op = mTokens->peek();
+        if (!op || op.type() != OPERATOR || sPrefixOperators[size_t(op.kind())].mPrecedence == 0) {
+            return expectOneValue();
+        }
+        ProductionProbe probe(mStats, mActiveProduction, ParserProduction::PREFIX_EXPRESSION);
 
+        // A dangling prefix operator like the "-" in "a = b = -;" is retried once per enclosing
+        // right-associative operator, so remember that it failed.
+        size_t operatorStart = mTokens->mark();
+        if (isKnownFailure(ParserProduction::PREFIX_EXPRESSION, operatorStart)) {
+            return nullopt;
+        }
+        size_t operandMinPrecedence = sPrefixOperators[size_t(op.kind())].mPrecedence;
+        mTokens->next();
 
-    size_t Parser::operatorPrecedence(const string &operatorName) {
-        map<string, OperatorEntry>::iterator foundOperator = sOperators.find(operatorName);
-        if (foundOperator == sOperators.end()) {
-            return 0;
+        optional<Statement> operand = expectBinaryExpression(operandMinPrecedence);
+        if (!operand.has_value()) {
+            if (mPanicking) {
+                return nullopt;
+            }
+            backtrack(operatorStart);
+            rememberFailure(ParserProduction::PREFIX_EXPRESSION, operatorStart);
+            return nullopt;
         }
-        return foundOperator->second.mPrecedence;
+
+        Statement operatorCall;
+        operatorCall.mKind = StatementKind::OPERATOR_CALL;
+        operatorCall.mName = op.text();
+        operatorCall.mParameters.push_back(std::move(operand.value()));
+        probe.succeeded();
+        return operatorCall;
     }
 
 }
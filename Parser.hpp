@@ -1,42 +1,166 @@
 #pragma once
 
+#include "Diagnostic.hpp"
+#include "ParseStats.hpp"
 #include "Tokenizer.hpp"
-#include "Type.hpp"
+#include "TokenStream.hpp"
+#include "TypeTable.hpp"
 #include "FunctionDefinition.hpp"
 #include "Statement.hpp"
+#include <iostream>
 #include <optional>
+#include <ostream>
 #include <string>
+#include <string_view>
+#include <array>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace simpleparser {
 
     using namespace std;
 
+    struct TransparentStringHash {
+        using is_transparent = void;
+
+        size_t operator()(string_view text) const { return hash<string_view>()(text); }
+    };
+
+    class PassManager;
+
+    class WorkStealingScheduler;
+
     class Parser {
     public:
+        //! Bump whenever the functions parsed from the same source change, e.g. in an AstCache.
+        static constexpr uint32_t kVersion = 2;
+
+        //! Deep enough for any hand-written code, shallow enough that parsing it, and resolving and
+        //! compiling its while loops one level per call, fits in a thread's stack, even in a
+        //! sanitizer build.
+        static constexpr size_t kDefaultMaxNestingDepth = 1000;
+
         Parser();
 
-        void parse(vector<Token> &tokens);
+        // Copying would duplicate every parsed function, which is never what's wanted.
+        Parser(const Parser &) = delete;
+
+        Parser(Parser &&) = default;
+
+        Parser &operator=(const Parser &) = delete;
+
+        Parser &operator=(Parser &&) = default;
+
+        void parse(const TokenBuffer &tokens);
+
+        //! Parses tokens as they are read, e.g. from a FileTokenStream.
+        void parse(TokenStream &tokens);
+
+        //! Same result as parse(tokens), but splits the tokens at top-level closing braces and
+        //! parses the pieces on scheduler's threads. Don't call this from one of its tasks.
+        void parse(const TokenBuffer &tokens, WorkStealingScheduler &scheduler);
 
         void debugPrint() const;
 
-        map<string, FunctionDefinition> GetFunctions() const { return mFunctions; }
+        //! Where problems in the source are reported. cerr unless set.
+        void setDiagnosticStream(ostream &diagnostics) { mDiagnostics = &diagnostics; }
+
+        //! Normally the first syntax error is thrown as a runtime_error. When collecting, each
+        //! error is added to errors() instead, and parsing resumes after the next ';' or '}'.
+        void setCollectErrors(bool collectErrors) { mCollectErrors = collectErrors; }
+
+        //! The syntax errors found since construction, in source order. Without collecting,
+        //! each parse() stops at its first one, which is also thrown.
+        const vector<Diagnostic> &errors() const { return mErrors; }
+
+        //! How deeply expressions, parentheses and while loops may nest inside the outermost one.
+        //! Each level takes stack space while parsing, so deeper input is a syntax error rather
+        //! than a crash. Operator chains like a + b + c are parsed in a loop and don't nest.
+        void setMaxNestingDepth(size_t depth) { mMaxNestingDepth = depth; }
+
+        //! Count productions into stats while parsing, if ParseStats::enabled(). nullptr stops it.
+        void setStats(ParseStats *stats) { mStats = stats; }
+
+        const map<string, FunctionDefinition> &GetFunctions() const { return mFunctions; }
+
+        //! Runs passes over the functions parsed so far, e.g. PassManager::standard() to fold constants.
+        void runPasses(const PassManager &passes);
+
+        //! Hands the parsed functions over, leaving none in the parser.
+        map<string, FunctionDefinition> takeFunctions() { return exchange(mFunctions, {}); }
+
+        //! Ends of consecutive runs of at least minimumChunkSize tokens, each cut right after a
+        //! closing brace that ends a top-level block, i.e. where a function definition ends.
+        //! Any trailing tokens form a last run of their own.
+        static vector<size_t> findDefinitionEnds(const TokenBuffer &tokens, size_t minimumChunkSize = 1);
+
+        //! How often the parser had to return to an earlier token after a failed attempt.
+        size_t backtrackCount() const { return mBacktrackCount; }
+
+        //! How often a memoized failure saved re-parsing a range of tokens.
+        size_t memoHitCount() const { return mMemoHitCount; }
 
     private:
-        optional<Type> expectType();
+        static uint64_t memoKey(ParserProduction production, size_t position) { return (uint64_t(position) << 8) | uint64_t(production); }
+
+        bool isNextToken(size_t k, TokenType type, TokenKind kind = TokenKind::NONE);
+
+        void backtrack(size_t position);
+
+        bool isKnownFailure(ParserProduction production, size_t position);
+
+        void rememberFailure(ParserProduction production, size_t position);
+
+        //! Records a syntax error at the current token and enters panic mode: productions return
+        //! without a result until a caller recovers, instead of unwinding with an exception.
+        void reportError(string message);
+
+        void reportMissingSemicolon();
+
+        //! When collecting errors, skips to the start of the next statement of the current
+        //! block and ends panic mode. False if the error has to be passed up instead.
+        bool recoverInBlock();
+
+        //! Skips past the next ';' or '}' outside of braces and ends panic mode.
+        void skipToDefinitionEnd();
+
+        //! Reports an error if one more level of nesting would be too many. The outermost
+        //! expression or loop is level 0. If not, productions
+        //! that nest count themselves in mNestingDepth with a NestingLevel.
+        bool isNestedTooDeeply();
+
+        optional<TypeID> findType(TokenRef token) const;
+
+        optional<TypeID> expectType();
+
+        //! Interns type in the global TypeTable and registers it under name.
+        void addType(string_view name, const Type &type);
 
-        //! Empty string means match any identifier.
-        optional<Token> expectIdentifier(const string& name = string());
+        //! TokenKind::NONE means match any identifier.
+        TokenRef expectIdentifier(TokenKind kind = TokenKind::NONE);
 
-        //! Empty string means match any operator.
-        optional<Token> expectOperator(const string& name = string());
+        //! TokenKind::NONE means match any operator.
+        TokenRef expectOperator(TokenKind kind = TokenKind::NONE);
 
         bool expectFunctionDefinition();
 
-        vector<Token>::iterator mCurrentToken;
-        vector<Token>::iterator mEndToken;
-        map<string, Type> mTypes;
+        TokenStream *mTokens{nullptr};
+        ostream *mDiagnostics{&cerr};
+        unordered_map<string, TypeID, TransparentStringHash, equal_to<>> mTypes;
+        array<optional<TypeID>, size_t(TokenKind::COUNT)> mKeywordTypes{}; // Entries of mTypes named by keywords.
+        unordered_set<uint64_t> mKnownFailures; // memoKey()s of attempts that failed since the last definition.
+        size_t mBacktrackCount{0};
+        size_t mMemoHitCount{0};
+        ParseStats *mStats{nullptr};
+        bool mCollectErrors{false};
+        bool mPanicking{false}; // An error was reported and nothing has recovered from it yet.
+        size_t mMaxNestingDepth{kDefaultMaxNestingDepth};
+        size_t mNestingDepth{0};
+        vector<Diagnostic> mErrors;
+        ParserProduction mActiveProduction{ParserProduction::FUNCTION_DEFINITION}; // Charged with rewinds.
         map<string, FunctionDefinition> mFunctions;
 
         optional<vector<Statement>> parseFunctionBody();
@@ -51,11 +175,11 @@ namespace simpleparser {
 
         optional<Statement> expectFunctionCall();
 
-        optional <Statement> expectExpression();
+        optional<Statement> expectExpression();
 
-        size_t operatorPrecedence(const string &operatorName);
+        optional<Statement> expectBinaryExpression(size_t minPrecedence);
 
-        Statement *findRightmostStatement(Statement *lhs, size_t rhsPrecedence);
+        optional<Statement> expectPrefixExpression();
     };
 
 }
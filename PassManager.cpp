@@ -0,0 +1,49 @@
+#include "PassManager.hpp"
+#include "AstPasses.hpp"
+#include "ContentHash.hpp"
+
+namespace simpleparser {
+
+    using namespace std;
+
+    PassManager PassManager::standard() {
+        PassManager passes;
+        passes.add(make_unique<ConstantFoldingPass>());
+        passes.add(make_unique<IdentitySimplificationPass>());
+        passes.add(make_unique<DeadLoopEliminationPass>());
+        return passes;
+    }
+
+    void PassManager::add(unique_ptr<AstPass> pass) {
+        mPasses.push_back(std::move(pass));
+    }
+
+    size_t PassManager::run(FunctionDefinition &function) const {
+        size_t round = 0;
+        bool changed = true;
+        while (changed && round < kMaxRounds) {
+            changed = false;
+            for (const unique_ptr<AstPass> &pass : mPasses) {
+                changed |= pass->run(function);
+            }
+            ++round;
+        }
+        return round;
+    }
+
+    void PassManager::run(map<string, FunctionDefinition> &functions) const {
+        for (auto &funcPair : functions) {
+            run(funcPair.second);
+        }
+    }
+
+    uint16_t PassManager::cacheVariant() const {
+        string names = to_string(kVersion) + '\n';
+        for (const unique_ptr<AstPass> &pass : mPasses) {
+            names += pass->name();
+            names += '\n';
+        }
+        return uint16_t(xxHash64(names) % UINT16_MAX + 1);
+    }
+
+}
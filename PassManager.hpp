@@ -0,0 +1,56 @@
+#pragma once
+
+#include "FunctionDefinition.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! One transformation of parsed functions. Passes keep no state between calls, so one
+    //! pass can work on several functions on different threads at once.
+    class AstPass {
+    public:
+        virtual ~AstPass() = default;
+
+        virtual string_view name() const = 0;
+
+        //! Returns whether it changed anything.
+        virtual bool run(FunctionDefinition &function) const = 0;
+    };
+
+    //! Runs a list of passes over functions until none of them finds anything more to do.
+    class PassManager {
+    public:
+        //! Bump whenever a pass changes what it makes of the same functions, so results of the
+        //! old one aren't taken from an AstCache.
+        static constexpr uint32_t kVersion = 1;
+
+        //! Gives up after this many rounds, in case two passes keep undoing each other.
+        static constexpr size_t kMaxRounds = 8;
+
+        //! Constant folding, identity simplification and dead loop removal, in that order.
+        static PassManager standard();
+
+        void add(unique_ptr<AstPass> pass);
+
+        //! Runs all passes in order, and again while any of them changed something. Returns
+        //! the number of rounds.
+        size_t run(FunctionDefinition &function) const;
+
+        void run(map<string, FunctionDefinition> &functions) const;
+
+        //! Tells cached results of different pass lists apart. Never 0, which is for no passes.
+        uint16_t cacheVariant() const;
+
+    private:
+        vector<unique_ptr<AstPass>> mPasses;
+    };
+
+}
@@ -0,0 +1,266 @@
+#include "ProgramGenerator.hpp"
+#include <algorithm>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    static const char *const sBinaryOperators[] = {"+", "-", "*", "/", "<"};
+
+    static const char *const sTypeNames[] = {"int", "double", "unsigned", "char", "uint8_t"};
+
+    static const char *const sCommentWords[] = {"compute", "the", "next", "value", "before", "checking", "limit", "again"};
+
+    ProgramGenerator::ProgramGenerator(const ProgramGeneratorOptions &options)
+            : mOptions(options), mRandom(options.mSeed) {
+    }
+
+    string ProgramGenerator::generate() {
+        mOut.clear();
+        mFunctions.clear();
+        for (size_t index = 0; index < mOptions.mFunctionCount; ++index) {
+            appendFunction(index);
+        }
+        return std::move(mOut);
+    }
+
+    void ProgramGenerator::appendFunction(size_t index) {
+        Function function;
+        function.mName = "function_" + to_string(index);
+        function.mParameterCount = randomBelow(4);
+
+        mVariables.clear();
+        mNextVariable = 0;
+        mOut += (randomBelow(2) == 0) ? "void " : "int ";
+        mOut += function.mName;
+        mOut += '(';
+        for (size_t param = 0; param < function.mParameterCount; ++param) {
+            if (param != 0) {
+                mOut += ", ";
+            }
+            mVariables.push_back("p" + to_string(param));
+            mOut += sTypeNames[randomBelow(size(sTypeNames))];
+            mOut += ' ';
+            mOut += mVariables.back();
+        }
+        mOut += ") {\n";
+
+        appendStatements(mOptions.mStatementsPerFunction, 1, 0);
+        mOut += "}\n";
+        mFunctions.push_back(std::move(function));
+    }
+
+    void ProgramGenerator::appendStatements(size_t count, size_t indent, size_t loopDepth) {
+        for (size_t statement = 0; statement < count; ++statement) {
+            if (randomFraction() < mOptions.mCommentDensity) {
+                appendIndent(indent);
+                mOut += "//";
+                for (size_t word = 1 + randomBelow(6); word > 0; --word) {
+                    mOut += ' ';
+                    mOut += sCommentWords[randomBelow(size(sCommentWords))];
+                }
+                mOut += '\n';
+            }
+            appendStatement(indent, loopDepth);
+        }
+    }
+
+    void ProgramGenerator::appendStatement(size_t indent, size_t loopDepth) {
+        appendIndent(indent);
+        double kind = randomFraction();
+
+        if (kind < mOptions.mWhileLoopShare && loopDepth < 2) {
+            // Counts a fresh variable up, so the loop ends however often it is entered.
+            string counter = "v" + to_string(mNextVariable++);
+            mOut += "int " + counter + " = 0;\n";
+            appendIndent(indent);
+            mOut += "while (" + counter + " < " + to_string(1 + randomBelow(10)) + ") {\n";
+            appendIndent(indent + 1);
+            mOut += counter + " = " + counter + " + 1;\n";
+            mVariables.push_back(counter);
+            mLoopCounters.push_back(counter);
+            size_t variablesBeforeBody = mVariables.size();
+            appendStatements(1 + randomBelow(3), indent + 1, loopDepth + 1);
+            mVariables.resize(variablesBeforeBody); // Declared in the body, so out of scope after it.
+            mLoopCounters.pop_back();
+            appendIndent(indent);
+            mOut += "};\n";
+        } else if (kind < 0.5 || mVariables.empty()) {
+            string variable = "v" + to_string(mNextVariable++);
+            mOut += sTypeNames[randomBelow(2)]; // int or double
+            mOut += ' ';
+            mOut += variable;
+            mOut += " = ";
+            appendExpression(0);
+            mOut += ";\n";
+            mVariables.push_back(std::move(variable));
+        } else if (kind < 0.8 && mVariables.size() > mLoopCounters.size()) {
+            mOut += randomAssignableVariable();
+            mOut += " = ";
+            appendExpression(0);
+            mOut += ";\n";
+        } else {
+            appendCall(0);
+            mOut += ";\n";
+        }
+    }
+
+    void ProgramGenerator::appendExpression(size_t depth) {
+        appendOperand(depth);
+        for (size_t operatorCount = randomBelow(mOptions.mMaxExpressionLength + 1); operatorCount > 0; --operatorCount) {
+            mOut += ' ';
+            mOut += sBinaryOperators[randomBelow(size(sBinaryOperators))];
+            mOut += ' ';
+            appendOperand(depth);
+        }
+    }
+
+    void ProgramGenerator::appendOperand(size_t depth) {
+        double kind = randomFraction();
+        double limit = mOptions.mIntegerLiteralShare;
+        if (kind < limit) {
+            mOut += to_string(randomBelow(1000));
+            return;
+        }
+        limit += mOptions.mDoubleLiteralShare;
+        if (kind < limit) {
+            mOut += to_string(randomBelow(100));
+            mOut += '.';
+            mOut += to_string(randomBelow(100));
+            return;
+        }
+
+        double rest = (1.0 - limit) / 4;
+        if (depth < mOptions.mMaxExpressionDepth && kind < limit + rest) {
+            mOut += '(';
+            appendExpression(depth + 1);
+            mOut += ')';
+        } else if (depth < mOptions.mMaxExpressionDepth && kind < limit + 2 * rest) {
+            appendCall(depth + 1);
+        } else if (!mVariables.empty()) {
+            mOut += randomVariable();
+        } else {
+            mOut += to_string(randomBelow(1000));
+        }
+    }
+
+    void ProgramGenerator::appendCall(size_t depth) {
+        // printf takes anything, so it also stands in when there are no other functions yet.
+        size_t callee = randomBelow(mFunctions.size() + 1);
+        size_t argumentCount = (callee < mFunctions.size()) ? mFunctions[callee].mParameterCount : 1 + randomBelow(3);
+        mOut += (callee < mFunctions.size()) ? mFunctions[callee].mName : "printf";
+        mOut += '(';
+        for (size_t argument = 0; argument < argumentCount; ++argument) {
+            if (argument != 0) {
+                mOut += ", ";
+            }
+            if (randomFraction() < mOptions.mStringLiteralShare || (callee == mFunctions.size() && argument == 0)) {
+                mOut += "\"value %d\\n\"";
+            } else {
+                appendExpression(depth + 1);
+            }
+        }
+        mOut += ')';
+    }
+
+    void ProgramGenerator::appendIndent(size_t indent) {
+        mOut.append(4 * indent, ' ');
+    }
+
+    size_t ProgramGenerator::randomBelow(size_t bound) {
+        return (bound == 0) ? 0 : size_t(mRandom() % bound);
+    }
+
+    double ProgramGenerator::randomFraction() {
+        return double(mRandom() >> 11) * 0x1p-53;
+    }
+
+    const string &ProgramGenerator::randomVariable() {
+        return mVariables[randomBelow(mVariables.size())];
+    }
+
+    const string &ProgramGenerator::randomAssignableVariable() {
+        while (true) {
+            const string &variable = randomVariable();
+            if (find(mLoopCounters.begin(), mLoopCounters.end(), variable) == mLoopCounters.end()) {
+                return variable;
+            }
+        }
+    }
+
+    string ProgramGenerator::longOperatorChain(size_t termCount) {
+        string result = "int chain() {\n    int x = 1";
+        for (size_t term = 1; term < termCount; ++term) {
+            result += ' ';
+            result += sBinaryOperators[term % 4]; // No '<', which would make a mostly boolean chain.
+            result += ' ';
+            result += to_string(term % 97 + 1);
+        }
+        result += ";\n}\n";
+        return result;
+    }
+
+    string ProgramGenerator::deepParentheses(size_t depth) {
+        string result = "int nested() {\n    int x = ";
+        result.append(depth, '(');
+        result += '1';
+        result.append(depth, ')');
+        result += ";\n}\n";
+        return result;
+    }
+
+    string ProgramGenerator::hugeStringLiteral(size_t length) {
+        string result = "void big() {\n    printf(\"";
+        result.reserve(result.size() + length + length / 32 + 16);
+        for (size_t index = 0; index < length; ++index) {
+            if (index % 64 == 63) {
+                result += "\\t";
+            } else {
+                result += char('a' + index % 26);
+            }
+        }
+        result += "\");\n}\n";
+        return result;
+    }
+
+    string ProgramGenerator::arithmeticLoops(size_t iterations) {
+        string result = "void main() {\n"
+                        "    int total = 0;\n"
+                        "    double sum = 0.0;\n"
+                        "    int outer = 0;\n"
+                        "    while (outer < ";
+        result += to_string(max<size_t>(iterations / 1000, 1));
+        result += ") {\n"
+                  "        int inner = 0;\n"
+                  "        while (inner < 1000) {\n"
+                  "            total = total + inner * 3 - total / 7;\n"
+                  "            sum = sum + 0.5 * inner - sum / 1024.0;\n"
+                  "            inner = inner + 1;\n"
+                  "        };\n"
+                  "        outer = outer + 1;\n"
+                  "    };\n"
+                  "    printf(\"%d %f\\n\", total, sum);\n"
+                  "}\n";
+        return result;
+    }
+
+    string ProgramGenerator::callLoop(size_t iterations) {
+        string result = "void step(int n, double x) {\n"
+                        "    int scaled = n * 3 - n / 7;\n"
+                        "    double mixed = x * 0.5 + scaled;\n"
+                        "}\n"
+                        "\n"
+                        "void main() {\n"
+                        "    int count = 0;\n"
+                        "    while (count < ";
+        result += to_string(iterations);
+        result += ") {\n"
+                  "        step(count, count / 2.0);\n"
+                  "        count = count + 1;\n"
+                  "    };\n"
+                  "    printf(\"%d\\n\", count);\n"
+                  "}\n";
+        return result;
+    }
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    class ProgramGeneratorOptions {
+    public:
+        uint64_t mSeed{1};
+        size_t mFunctionCount{100};
+        size_t mStatementsPerFunction{8};
+        size_t mMaxExpressionDepth{3}; // How deeply parentheses and call arguments nest.
+        size_t mMaxExpressionLength{6}; // Most binary operators in one level of an expression.
+        // Output grows roughly like (length * nesting share) ^ depth, so raise both with care.
+        double mIntegerLiteralShare{0.3}; // Of expression operands. The rest are variables,
+        double mDoubleLiteralShare{0.1}; // calls and parenthesized expressions.
+        double mStringLiteralShare{0.05}; // Of call arguments.
+        double mCommentDensity{0.1}; // Chance of a comment line before a statement.
+        double mWhileLoopShare{0.1}; // Of statements.
+    };
+
+    //! Writes random but valid programs for benchmarks, the same ones for the same options on
+    //! every platform. Variables are declared before they are used, functions only call
+    //! functions defined before them with the right number of arguments, and loops count up
+    //! to a limit, so the programs also terminate when run.
+    class ProgramGenerator {
+    public:
+        explicit ProgramGenerator(const ProgramGeneratorOptions &options);
+
+        string generate();
+
+        //! One statement with termCount operands joined by binary operators.
+        static string longOperatorChain(size_t termCount);
+
+        //! One literal inside depth pairs of parentheses.
+        static string deepParentheses(size_t depth);
+
+        //! A printf of a string literal with length characters, some of them escaped.
+        static string hugeStringLiteral(size_t length);
+
+        //! A main function whose nested loops run their body about iterations times, with INT32
+        //! and double arithmetic on a few variables, and print the result.
+        static string arithmeticLoops(size_t iterations);
+
+        //! A main function that calls a small function iterations times.
+        static string callLoop(size_t iterations);
+
+    private:
+        class Function {
+        public:
+            string mName;
+            size_t mParameterCount{0};
+        };
+
+        void appendFunction(size_t index);
+
+        void appendStatements(size_t count, size_t indent, size_t loopDepth);
+
+        void appendStatement(size_t indent, size_t loopDepth);
+
+        void appendExpression(size_t depth);
+
+        void appendOperand(size_t depth);
+
+        void appendCall(size_t depth);
+
+        void appendIndent(size_t indent);
+
+        //! Uniform in [0, bound). Not uniform_int_distribution, whose results differ between libraries.
+        size_t randomBelow(size_t bound);
+
+        //! Uniform in [0, 1).
+        double randomFraction();
+
+        const string &randomVariable();
+
+        //! Any variable but the counters of the loops being written, so every loop ends.
+        const string &randomAssignableVariable();
+
+        ProgramGeneratorOptions mOptions;
+        mt19937_64 mRandom;
+        string mOut;
+        vector<Function> mFunctions; // Defined so far.
+        vector<string> mVariables; // In scope in the function being written.
+        vector<string> mLoopCounters; // Of the loops being written, which their bodies only read.
+        size_t mNextVariable{0};
+    };
+
+}
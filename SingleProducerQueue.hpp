@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! A bounded queue between exactly one thread that push()es and one that pop()s. Neither
+    //! takes a lock: each side only writes its own index, and reads the other's to see how far
+    //! it may go. A side that can't go on, because the queue is full or empty, waits on the
+    //! other's index until it moves.
+    template<class T>
+    class SingleProducerQueue {
+    public:
+        //! Room for at least capacity items. T must be default-constructible and movable.
+        explicit SingleProducerQueue(size_t capacity)
+                : mSlots(bit_ceil(max(capacity, size_t(1)))), mMask(mSlots.size() - 1) {
+        }
+
+        SingleProducerQueue(const SingleProducerQueue &) = delete;
+
+        SingleProducerQueue &operator=(const SingleProducerQueue &) = delete;
+
+        //! Only for the producer. Waits while the queue is full.
+        void push(T item) {
+            size_t tail = mTail.load(memory_order_relaxed);
+            size_t head = mHead.load(memory_order_acquire);
+            while (tail - head == mSlots.size()) {
+                mHead.wait(head, memory_order_acquire);
+                head = mHead.load(memory_order_acquire);
+            }
+            mSlots[tail & mMask] = std::move(item);
+            mTail.store(tail + 1, memory_order_release);
+            mTail.notify_one();
+        }
+
+        //! Only for the consumer. Waits while the queue is empty.
+        T pop() {
+            size_t head = mHead.load(memory_order_relaxed);
+            size_t tail = mTail.load(memory_order_acquire);
+            while (tail == head) {
+                mTail.wait(tail, memory_order_acquire);
+                tail = mTail.load(memory_order_acquire);
+            }
+            T item = std::move(mSlots[head & mMask]);
+            mHead.store(head + 1, memory_order_release);
+            mHead.notify_one();
+            return item;
+        }
+
+    private:
+        static constexpr size_t kCacheLineSize = 64;
+
+        vector<T> mSlots;
+        size_t mMask;
+        // Items popped and pushed so far, on lines of their own so the two threads don't keep
+        // taking a cache line from each other.
+        alignas(kCacheLineSize) atomic<size_t> mHead{0};
+        alignas(kCacheLineSize) atomic<size_t> mTail{0};
+    };
+
+}
@@ -1,15 +1,56 @@
 #include "Statement.hpp"
+#include "AstWriter.hpp"
 #include <iostream>
+#include <iterator>
+#include <utility>
 
 namespace simpleparser {
 
-    void Statement::debugPrint(size_t indent) {
-        cout << string(indent, '\t') << sStatementKindStrings[int(mKind)] << " ";
-        cout << mType.mName << " " << mName << " (\n";
-        for (Statement statement : mParameters) {
-            statement.debugPrint(indent + 1);
+    void Statement::copyOperands(const Statement &other) {
+        // Depth-first and in order, like a recursive copy, so the copy is laid out in memory
+        // the same way. Each vector is allocated at its final size before it's filled, so the
+        // copies that levels point to never move.
+        struct Level {
+            const Statement *mOriginal;
+            Statement *mCopy;
+            size_t mNext{0};
+        };
+        mParameters.reserve(other.mParameters.size());
+        vector<Level> pending{Level{&other, this}};
+        while (!pending.empty()) {
+            Level &level = pending.back();
+            if (level.mNext == level.mOriginal->mParameters.size()) {
+                pending.pop_back();
+                continue;
+            }
+            const Statement &operand = level.mOriginal->mParameters[level.mNext++];
+            level.mCopy->mParameters.push_back(Statement(operand, WithoutOperands()));
+            if (!operand.mParameters.empty()) {
+                Statement &copy = level.mCopy->mParameters.back();
+                copy.mParameters.reserve(operand.mParameters.size());
+                pending.push_back(Level{&operand, &copy}); // level is invalid from here on.
+            }
         }
-        cout << string(indent, '\t') << ")" << endl;
+    }
+
+    void Statement::destroyOperands() {
+        // Nodes are only ever destroyed once their operands have been moved out, onto this
+        // list, so no destructor runs another one that has operands.
+        vector<Statement> pending = std::move(mParameters);
+        while (!pending.empty()) {
+            Statement &last = pending.back();
+            if (last.mParameters.empty()) {
+                pending.pop_back();
+                continue;
+            }
+            vector<Statement> operands = std::move(last.mParameters);
+            pending.pop_back();
+            pending.insert(pending.end(), make_move_iterator(operands.begin()), make_move_iterator(operands.end()));
+        }
+    }
+
+    void Statement::debugPrint(size_t indent) const {
+        PrettyAstWriter(cout, indent).write(*this);
     }
 
 }
@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
-#include "Type.hpp"
+#include "TypeTable.hpp"
 
 namespace simpleparser {
 
@@ -28,11 +30,60 @@ namespace simpleparser {
 
     class Statement {
     public:
+        static constexpr uint32_t kUnresolved = UINT32_MAX;
+
         string mName;
-        Type mType{Type("void", VOID)};
         vector<Statement> mParameters;
+        TypeID mType{TypeTable::kVoid};
         StatementKind mKind{StatementKind::FUNCTION_CALL};
+        //! What NameResolver bound mName to: a variable's slot or a callee (see NameResolver).
+        uint32_t mSymbol{kUnresolved};
+        //! The value of a number LITERAL, parsed once by the parser so nothing downstream has to
+        //! parse mName again. DOUBLE literals use mDoubleValue, INT32 ones mIntegerValue.
+        union {
+            int64_t mIntegerValue{0};
+            double mDoubleValue;
+        };
+
+        Statement() = default;
+
+        //! Copies the operands without recursing, like the destructor frees them.
+        Statement(const Statement &other) : Statement(other, WithoutOperands()) {
+            if (!other.mParameters.empty()) {
+                copyOperands(other);
+            }
+        }
+
+        Statement(Statement &&) noexcept = default;
+
+        Statement &operator=(const Statement &other) {
+            if (this != &other) {
+                *this = Statement(other);
+            }
+            return *this;
+        }
+
+        Statement &operator=(Statement &&) noexcept = default;
+
+        //! Frees the operands without recursing, so trees of any depth can be destroyed.
+        ~Statement() {
+            if (!mParameters.empty()) {
+                destroyOperands();
+            }
+        }
+
+        void debugPrint(size_t indent) const;
+
+    private:
+        struct WithoutOperands {};
+
+        Statement(const Statement &other, WithoutOperands)
+                : mName(other.mName), mType(other.mType), mKind(other.mKind), mSymbol(other.mSymbol) {
+            memcpy(&mIntegerValue, &other.mIntegerValue, sizeof(mIntegerValue)); // Whichever is in use.
+        }
+
+        void copyOperands(const Statement &other);
 
-        void debugPrint(size_t indent);
+        void destroyOperands();
     };
 }
@@ -0,0 +1,149 @@
+#include "TokenBuffer.hpp"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    TokenBuffer::TokenBuffer()
+            : mOwnsSource(true), mLineTable(make_unique<LineTable>()) {
+    }
+
+    TokenBuffer::TokenBuffer(string_view source, size_t firstLineNumber)
+            : mSource(source), mFirstLineNumber(firstLineNumber), mLineTable(make_unique<LineTable>()) {
+        if (source.size() >= kUnescaped) {
+            throw length_error("Source text of 2 GB or more.");
+        }
+    }
+
+    TokenBuffer::TokenBuffer(TokenBuffer &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    TokenBuffer &TokenBuffer::operator=(TokenBuffer &&other) noexcept {
+        mSource = other.mSource;
+        mOwnedSource = std::move(other.mOwnedSource);
+        mOwnsSource = other.mOwnsSource;
+        mFirstLineNumber = other.mFirstLineNumber;
+        mTypes = std::move(other.mTypes);
+        mKinds = std::move(other.mKinds);
+        mOffsets = std::move(other.mOffsets);
+        mLengths = std::move(other.mLengths);
+        mUnescaped = std::move(other.mUnescaped);
+        mLineTable = std::move(other.mLineTable);
+        if (mOwnsSource) {
+            mSource = mOwnedSource; // A short string's characters move along with it.
+        }
+        return *this;
+    }
+
+    void TokenBuffer::LineTable::scan(string_view text, size_t end) {
+        for (size_t position = mScannedEnd; position < end; ++position) {
+            if (text[position] == '\r' || text[position] == '\n') {
+                mLineStarts.push_back(uint32_t(position + 1));
+            }
+        }
+        mScannedEnd = max(mScannedEnd, end);
+    }
+
+    size_t TokenBuffer::lineNumber(size_t index) const {
+        uint32_t offset = mOffsets[index];
+        lock_guard<mutex> lock(mLineTable->mMutex);
+        mLineTable->scan(mSource, offset);
+        const vector<uint32_t> &lineStarts = mLineTable->mLineStarts;
+        return mFirstLineNumber + size_t(upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin());
+    }
+
+    Token TokenBuffer::token(size_t index) const {
+        return Token{type(index), kind(index), text(index), lineNumber(index)};
+    }
+
+    void TokenBuffer::reserve(size_t count) {
+        mTypes.reserve(count);
+        mKinds.reserve(count);
+        mOffsets.reserve(count);
+        mLengths.reserve(count);
+    }
+
+    void TokenBuffer::add(TokenType type, TokenKind kind, size_t offset, size_t length) {
+        mTypes.push_back(type);
+        mKinds.push_back(kind);
+        mOffsets.push_back(uint32_t(offset));
+        mLengths.push_back(uint32_t(length));
+    }
+
+    void TokenBuffer::addUnescaped(size_t offset, string text) {
+        mUnescaped.push_back(std::move(text));
+        add(STRING_LITERAL, TokenKind::NONE, offset, kUnescaped | uint32_t(mUnescaped.size() - 1));
+    }
+
+    void TokenBuffer::append(const TokenBuffer &other) {
+        if (!mOwnsSource) {
+            throw logic_error("Appending to a TokenBuffer that doesn't copy its text.");
+        }
+        if (mOwnedSource.size() + other.mSource.size() >= kUnescaped) {
+            throw length_error("Source text of 2 GB or more.");
+        }
+        if (mOwnedSource.empty()) {
+            mFirstLineNumber = other.mFirstLineNumber;
+        }
+        uint32_t textBase = uint32_t(mOwnedSource.size());
+        uint32_t unescapedBase = uint32_t(mUnescaped.size());
+        mOwnedSource += other.mSource;
+        mSource = mOwnedSource;
+
+        mTypes.insert(mTypes.end(), other.mTypes.begin(), other.mTypes.end());
+        mKinds.insert(mKinds.end(), other.mKinds.begin(), other.mKinds.end());
+        for (size_t index = 0; index < other.size(); ++index) {
+            mOffsets.push_back(textBase + other.mOffsets[index]);
+            uint32_t length = other.mLengths[index];
+            mLengths.push_back((length & kUnescaped) ? (unescapedBase + length) : length);
+        }
+        mUnescaped.insert(mUnescaped.end(), other.mUnescaped.begin(), other.mUnescaped.end());
+    }
+
+    void TokenBuffer::eraseFront(size_t count) {
+        count = min(count, size());
+        mTypes.erase(mTypes.begin(), mTypes.begin() + ptrdiff_t(count));
+        mKinds.erase(mKinds.begin(), mKinds.begin() + ptrdiff_t(count));
+        mOffsets.erase(mOffsets.begin(), mOffsets.begin() + ptrdiff_t(count));
+        mLengths.erase(mLengths.begin(), mLengths.begin() + ptrdiff_t(count));
+
+        vector<string> keptUnescaped;
+        for (uint32_t &length : mLengths) {
+            if (length & kUnescaped) {
+                keptUnescaped.push_back(std::move(mUnescaped[length & ~kUnescaped]));
+                length = kUnescaped | uint32_t(keptUnescaped.size() - 1);
+            }
+        }
+        mUnescaped = std::move(keptUnescaped);
+
+        if (!mOwnsSource) {
+            return;
+        }
+        // Count the line breaks in the text about to go, so later line numbers stay right.
+        uint32_t cut = mOffsets.empty() ? uint32_t(mOwnedSource.size()) : mOffsets.front();
+        lock_guard<mutex> lock(mLineTable->mMutex);
+        mLineTable->scan(mSource, cut);
+        vector<uint32_t> &lineStarts = mLineTable->mLineStarts;
+        auto firstKept = upper_bound(lineStarts.begin(), lineStarts.end(), cut);
+        mFirstLineNumber += size_t(firstKept - lineStarts.begin());
+        lineStarts.erase(lineStarts.begin(), firstKept);
+        for (uint32_t &lineStart : lineStarts) {
+            lineStart -= cut;
+        }
+        mLineTable->mScannedEnd -= cut;
+        for (uint32_t &offset : mOffsets) {
+            offset -= cut;
+        }
+        mOwnedSource.erase(0, cut);
+        mSource = mOwnedSource;
+    }
+
+    void Token::debugPrint() const {
+        cout << "Token(" << sTokenTypeStrings[mType] << ", \"" << mText << "\", " << mLineNumber << ")" << endl;
+    }
+
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "TokenKind.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    enum TokenType : uint8_t {
+        WHITESPACE, // No token ever has this type.
+        IDENTIFIER,
+        INTEGER_LITERAL,
+        DOUBLE_LITERAL,
+        STRING_LITERAL,
+        OPERATOR,
+        STRING_ESCAPE_SEQUENCE,
+        POTENTIAL_DOUBLE,
+        POTENTIAL_COMMENT,
+        COMMENT
+    };
+
+    static const char *sTokenTypeStrings[] = {
+        "WHITESPACE",
+        "IDENTIFIER",
+        "INTEGER_LITERAL",
+        "DOUBLE_LITERAL",
+        "STRING_LITERAL",
+        "OPERATOR",
+        "STRING_ESCAPE_SEQUENCE",
+        "POTENTIAL_DOUBLE",
+        "POTENTIAL_COMMENT",
+        "COMMENT"
+    };
+
+    //! One token with all its columns gathered, for code that wants the whole of it at once.
+    class Token {
+    public:
+        enum TokenType mType{WHITESPACE};
+        TokenKind mKind{TokenKind::NONE};
+        string_view mText;
+        size_t mLineNumber{0};
+
+        void debugPrint() const;
+    };
+
+    class TokenRef;
+
+    //! Tokens stored column by column: types, kinds, and where their text is in the source,
+    //! each in its own array, so code that only looks at types reads a byte per token. Line
+    //! numbers aren't stored at all; lineNumber() looks them up in a table of line starts that
+    //! is only built, as far as needed, once something asks for one.
+    //!
+    //! A token's text is a span of the source, except for string literals with escape
+    //! sequences, whose unescaped text the buffer keeps itself.
+    class TokenBuffer {
+    public:
+        //! An empty buffer that keeps a copy of the text of whatever is append()ed to it.
+        TokenBuffer();
+
+        //! For tokens of source, which must outlive the buffer. Throws a length_error if source
+        //! is 2 GB or more.
+        explicit TokenBuffer(string_view source, size_t firstLineNumber = 1);
+
+        TokenBuffer(TokenBuffer &&other) noexcept;
+
+        TokenBuffer &operator=(TokenBuffer &&other) noexcept;
+
+        TokenBuffer(const TokenBuffer &) = delete;
+
+        TokenBuffer &operator=(const TokenBuffer &) = delete;
+
+        size_t size() const { return mTypes.size(); }
+
+        bool empty() const { return mTypes.empty(); }
+
+        TokenType type(size_t index) const { return mTypes[index]; }
+
+        TokenKind kind(size_t index) const { return mKinds[index]; }
+
+        span<const TokenType> types() const { return mTypes; }
+
+        span<const TokenKind> kinds() const { return mKinds; }
+
+        //! Valid until the buffer changes or goes away.
+        string_view text(size_t index) const {
+            uint32_t length = mLengths[index];
+            if (length & kUnescaped) {
+                return mUnescaped[length & ~kUnescaped];
+            }
+            return mSource.substr(mOffsets[index], length);
+        }
+
+        //! Where the token starts in the source, or for a buffer built by append(), in its copy.
+        size_t offset(size_t index) const { return mOffsets[index]; }
+
+        //! Thread-safe, so threads parsing different parts of a buffer can all report errors.
+        size_t lineNumber(size_t index) const;
+
+        Token token(size_t index) const;
+
+        TokenRef operator[](size_t index) const;
+
+        void reserve(size_t count);
+
+        void add(TokenType type, TokenKind kind, size_t offset, size_t length);
+
+        //! A STRING_LITERAL starting at offset whose text, unescaped, is text.
+        void addUnescaped(size_t offset, string text);
+
+        //! Adds other's tokens after this buffer's, along with a copy of other's source, which
+        //! must continue where the text appended before ended, line numbers and all.
+        void append(const TokenBuffer &other);
+
+        //! Drops the first count tokens and, if the buffer keeps a copy of its text, the text
+        //! before the first token kept.
+        void eraseFront(size_t count);
+
+    private:
+        static constexpr uint32_t kUnescaped = uint32_t(1) << 31; // In mLengths, or'ed with an index into mUnescaped.
+
+        class LineTable {
+        public:
+            mutex mMutex;
+            vector<uint32_t> mLineStarts; // Offsets just past each line break, of the text scanned so far.
+            size_t mScannedEnd{0};
+
+            //! Extends mLineStarts to cover text up to end.
+            void scan(string_view text, size_t end);
+        };
+
+        string_view mSource;
+        string mOwnedSource; // What mSource shows, for buffers that copy their text.
+        bool mOwnsSource{false};
+        size_t mFirstLineNumber{1};
+        vector<TokenType> mTypes;
+        vector<TokenKind> mKinds;
+        vector<uint32_t> mOffsets;
+        vector<uint32_t> mLengths;
+        vector<string> mUnescaped;
+        unique_ptr<LineTable> mLineTable;
+    };
+
+    //! A token in a TokenBuffer, whose columns are read only when asked for. A null TokenRef,
+    //! which converts to false, stands for the end of input.
+    class TokenRef {
+    public:
+        TokenRef() = default;
+
+        TokenRef(const TokenBuffer *buffer, size_t index) : mBuffer(buffer), mIndex(index) {}
+
+        explicit operator bool() const { return mBuffer != nullptr; }
+
+        TokenType type() const { return mBuffer->type(mIndex); }
+
+        TokenKind kind() const { return mBuffer->kind(mIndex); }
+
+        string_view text() const { return mBuffer->text(mIndex); }
+
+        size_t lineNumber() const { return mBuffer->lineNumber(mIndex); }
+
+        Token token() const { return mBuffer->token(mIndex); }
+
+    private:
+        const TokenBuffer *mBuffer{nullptr};
+        size_t mIndex{0};
+    };
+
+    inline TokenRef TokenBuffer::operator[](size_t index) const {
+        return TokenRef(this, index);
+    }
+
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Operators and keywords, classified once by the tokenizer so the parser can compare
+    //! small integers instead of text.
+    enum class TokenKind : uint8_t {
+        NONE, // Identifiers that aren't keywords, literals, and operators without a kind.
+        OPEN_BRACE,
+        CLOSE_BRACE,
+        OPEN_PARENTHESIS,
+        CLOSE_PARENTHESIS,
+        ASSIGN,
+        PLUS,
+        MINUS,
+        ASTERISK,
+        SLASH,
+        LESS_THAN,
+        SEMICOLON,
+        COMMA,
+        PERIOD,
+        BACKSLASH,
+        WHILE_KEYWORD,
+        VOID_KEYWORD,
+        INT_KEYWORD,
+        UNSIGNED_KEYWORD,
+        CHAR_KEYWORD,
+        UINT8_T_KEYWORD,
+        DOUBLE_KEYWORD,
+        COUNT
+    };
+
+    inline constexpr TokenKind kFirstKeyword = TokenKind::WHILE_KEYWORD;
+
+    inline constexpr string_view sTokenKindSpellings[] = {
+        "",
+        "{",
+        "}",
+        "(",
+        ")",
+        "=",
+        "+",
+        "-",
+        "*",
+        "/",
+        "<",
+        ";",
+        ",",
+        ".",
+        "\\",
+        "while",
+        "void",
+        "int",
+        "unsigned",
+        "char",
+        "uint8_t",
+        "double"
+    };
+
+    static_assert(size(sTokenKindSpellings) == size_t(TokenKind::COUNT));
+
+    constexpr array<TokenKind, 256> makeOperatorKindTable() {
+        array<TokenKind, 256> table{};
+        for (size_t kind = 1; kind < size_t(kFirstKeyword); ++kind) {
+            table[uint8_t(sTokenKindSpellings[kind][0])] = TokenKind(kind);
+        }
+        return table;
+    }
+
+    //! Operators are single characters, so their kind is a direct table lookup.
+    inline constexpr array<TokenKind, 256> sOperatorKinds = makeOperatorKindTable();
+
+    // Keywords go through a perfect hash: a seed is searched for at compile time so that
+    // every keyword lands in its own slot, and a lookup costs one hash and one compare.
+
+    inline constexpr size_t kKeywordSlotCount = 16;
+
+    constexpr size_t keywordSlot(string_view identifier, uint32_t seed) {
+        uint32_t hash = seed ^ uint32_t(identifier.size());
+        hash = hash * 0x9E3779B1u + uint8_t(identifier.front());
+        hash = hash * 0x9E3779B1u + uint8_t(identifier.back());
+        return (hash >> 16) & (kKeywordSlotCount - 1);
+    }
+
+    constexpr uint32_t findKeywordSeed() {
+        for (uint32_t seed = 0; seed < 10000; ++seed) {
+            bool slotUsed[kKeywordSlotCount]{};
+            bool collision = false;
+            for (size_t kind = size_t(kFirstKeyword); kind < size_t(TokenKind::COUNT) && !collision; ++kind) {
+                size_t slot = keywordSlot(sTokenKindSpellings[kind], seed);
+                collision = slotUsed[slot];
+                slotUsed[slot] = true;
+            }
+            if (!collision) {
+                return seed;
+            }
+        }
+        return UINT32_MAX;
+    }
+
+    inline constexpr uint32_t kKeywordSeed = findKeywordSeed();
+
+    static_assert(kKeywordSeed != UINT32_MAX, "No perfect hash seed found for the keyword list.");
+
+    constexpr array<TokenKind, kKeywordSlotCount> makeKeywordSlotTable() {
+        array<TokenKind, kKeywordSlotCount> table{};
+        for (size_t kind = size_t(kFirstKeyword); kind < size_t(TokenKind::COUNT); ++kind) {
+            table[keywordSlot(sTokenKindSpellings[kind], kKeywordSeed)] = TokenKind(kind);
+        }
+        return table;
+    }
+
+    inline constexpr array<TokenKind, kKeywordSlotCount> sKeywordSlots = makeKeywordSlotTable();
+
+    //! identifier must not be empty.
+    constexpr TokenKind keywordKind(string_view identifier) {
+        TokenKind kind = sKeywordSlots[keywordSlot(identifier, kKeywordSeed)];
+        return (sTokenKindSpellings[size_t(kind)] == identifier) ? kind : TokenKind::NONE;
+    }
+
+    static_assert(keywordKind("while") == TokenKind::WHILE_KEYWORD);
+    static_assert(keywordKind("whilf") == TokenKind::NONE);
+
+}
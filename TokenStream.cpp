@@ -0,0 +1,199 @@
+#include "TokenStream.hpp"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace simpleparser {
+
+    using namespace std;
+
+    TokenStream::TokenStream(const TokenBuffer &tokens)
+            : TokenStream(tokens, 0, tokens.size()) {
+    }
+
+    TokenStream::TokenStream(const TokenBuffer &tokens, size_t first, size_t count)
+            : mWindow(&tokens), mWindowFirst(first), mWindowCount(count), mOwnsTokens(false) {
+    }
+
+    TokenRef TokenStream::peekSlow(size_t k) {
+        while (mPosition + k - mWindowStart >= mWindowCount) {
+            if (!refill()) {
+                return TokenRef();
+            }
+        }
+        return (*mWindow)[mWindowFirst + (mPosition + k - mWindowStart)];
+    }
+
+    void TokenStream::release() {
+        if (!mOwnsTokens) {
+            return;
+        }
+        size_t releasedCount = min(mPosition - mWindowStart, mBuffer.size());
+        if (releasedCount == 0 || releasedCount < mBuffer.size() - releasedCount) {
+            return; // Erasing would move more tokens than it frees.
+        }
+        mBuffer.eraseFront(releasedCount);
+        mWindowStart += releasedCount;
+        bufferChanged();
+    }
+
+    void TokenStream::bufferChanged() {
+        mWindow = &mBuffer;
+        mWindowFirst = 0;
+        mWindowCount = mBuffer.size();
+    }
+
+    FileTokenStream::FileTokenStream(FILE *file, size_t chunkSize)
+            : mFile(file), mChunkSize(chunkSize) {
+    }
+
+    FileTokenStream::FileTokenStream(int fileDescriptor, size_t chunkSize)
+            : mFileDescriptor(fileDescriptor), mChunkSize(chunkSize) {
+    }
+
+    size_t FileTokenStream::readChunk(char *buffer, size_t size) {
+        if (mFile) {
+            size_t amountRead = fread(buffer, 1, size, mFile);
+            if (amountRead == 0 && ferror(mFile)) {
+                throw runtime_error("Error reading source file.");
+            }
+            return amountRead;
+        }
+
+#if defined(_WIN32)
+        int amountRead = _read(mFileDescriptor, buffer, unsigned(min(size, size_t(INT_MAX))));
+#else
+        ssize_t amountRead = read(mFileDescriptor, buffer, size);
+#endif
+        if (amountRead < 0) {
+            throw runtime_error("Error reading source file.");
+        }
+        return size_t(amountRead);
+    }
+
+    bool FileTokenStream::refill() {
+        while (!mAtEndOfFile || !mPendingText.empty()) {
+            if (!mAtEndOfFile) {
+                size_t oldSize = mPendingText.size();
+                mPendingText.resize(oldSize + mChunkSize);
+                size_t amountRead = readChunk(mPendingText.data() + oldSize, mChunkSize);
+                mPendingText.resize(oldSize + amountRead);
+                mAtEndOfFile = (amountRead == 0);
+            }
+
+            size_t cut = mPendingText.size();
+            if (!mAtEndOfFile) {
+                size_t lastLineBreak = mPendingText.find_last_of("\r\n");
+                if (lastLineBreak == string::npos) {
+                    continue; // A line longer than a chunk. Keep reading until it ends.
+                }
+                cut = lastLineBreak + 1;
+            }
+
+            string_view text(mPendingText.data(), cut);
+            TokenBuffer tokens = mTokenizer.parse(text, mLineNumber);
+            mLineNumber += size_t(count_if(text.begin(), text.end(),
+                                           [](char ch) { return ch == '\r' || ch == '\n'; }));
+            mBuffer.append(tokens);
+            mPendingText.erase(0, cut);
+            bufferChanged();
+
+            if (!tokens.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    PipelinedTokenStream::PipelinedTokenStream(string_view source, bool collectErrors, size_t chunkSize)
+            : mSource(source), mChunkSize(max(chunkSize, size_t(1))) {
+        mTokenizer.setCollectErrors(collectErrors);
+        mThread = thread(&PipelinedTokenStream::tokenize, this);
+    }
+
+    PipelinedTokenStream::~PipelinedTokenStream() {
+        mStopping.store(true, memory_order_relaxed);
+        drain();
+    }
+
+    void PipelinedTokenStream::tokenize() {
+        Chunk last;
+        last.mLast = true;
+        try {
+            size_t lineNumber = 1;
+            size_t start = 0;
+            while (start < mSource.size() && !mStopping.load(memory_order_relaxed)) {
+                // Cut after the chunk's last line break, or if a line is longer, after its end.
+                size_t end = mSource.size();
+                if (mSource.size() - start > mChunkSize) {
+                    size_t lastLineBreak = mSource.find_last_of("\r\n", start + mChunkSize - 1);
+                    if (lastLineBreak == string_view::npos || lastLineBreak < start) {
+                        lastLineBreak = mSource.find_first_of("\r\n", start + mChunkSize);
+                    }
+                    if (lastLineBreak != string_view::npos) {
+                        end = lastLineBreak + 1;
+                    }
+                }
+
+                string_view text = mSource.substr(start, end - start);
+                Chunk chunk;
+                chunk.mTokens = mTokenizer.parse(text, lineNumber);
+                mErrors.insert(mErrors.end(), mTokenizer.errors().begin(), mTokenizer.errors().end());
+                lineNumber += size_t(count_if(text.begin(), text.end(),
+                                              [](char ch) { return ch == '\r' || ch == '\n'; }));
+                start = end;
+                mQueue.push(std::move(chunk)); // Even without tokens, for its line breaks.
+            }
+        } catch (...) {
+            last.mError = current_exception();
+        }
+        mQueue.push(std::move(last));
+    }
+
+    bool PipelinedTokenStream::refill() {
+        if (mAtLastChunk) {
+            return false;
+        }
+        Chunk chunk = mQueue.pop();
+        if (chunk.mLast) {
+            mAtLastChunk = true;
+            mError = chunk.mError;
+            if (mError) {
+                rethrow_exception(mError);
+            }
+            return false;
+        }
+        mTokenCount += chunk.mTokens.size();
+        mBuffer.append(chunk.mTokens);
+        bufferChanged();
+        return true;
+    }
+
+    void PipelinedTokenStream::drain() {
+        while (!mAtLastChunk) {
+            Chunk chunk = mQueue.pop();
+            mTokenCount += chunk.mTokens.size();
+            if (chunk.mLast) {
+                mAtLastChunk = true;
+                mError = chunk.mError;
+            }
+        }
+        if (mThread.joinable()) {
+            mThread.join();
+        }
+    }
+
+    void PipelinedTokenStream::finish() {
+        drain();
+        if (mError) {
+            rethrow_exception(mError);
+        }
+    }
+
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "SingleProducerQueue.hpp"
+#include "Tokenizer.hpp"
+#include <atomic>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! A window of tokens that the parser reads with peek()/next(). Positions are absolute
+    //! token indices; any position obtained from mark() can be rewound to until release()
+    //! is called, which lets streaming subclasses free everything before the current token.
+    class TokenStream {
+    public:
+        //! Reads tokens someone else holds. Nothing is copied, and release() frees nothing.
+        explicit TokenStream(const TokenBuffer &tokens);
+
+        //! Like the above, for count tokens of tokens starting at index first. Positions start
+        //! at 0 all the same.
+        TokenStream(const TokenBuffer &tokens, size_t first, size_t count);
+
+        virtual ~TokenStream() = default;
+
+        //! The token k positions after the current one, or a null TokenRef past the end of
+        //! input. It is only valid until the next call that may read more input.
+        TokenRef peek(size_t k = 0) {
+            size_t index = mPosition + k - mWindowStart;
+            if (index < mWindowCount) {
+                return (*mWindow)[mWindowFirst + index];
+            }
+            return peekSlow(k);
+        }
+
+        TokenRef next() {
+            TokenRef token = peek();
+            if (token) {
+                ++mPosition;
+            }
+            return token;
+        }
+
+        size_t mark() const { return mPosition; }
+
+        void rewind(size_t position) { mPosition = position; }
+
+        //! Promise never to rewind before the current token again. Tokens are freed once they make
+        //! up half the window, so that freeing them costs little more than reading them did.
+        void release();
+
+    protected:
+        TokenStream() = default;
+
+        //! Append tokens to mBuffer and call bufferChanged(). Returns false at the end of input.
+        virtual bool refill() { return false; }
+
+        void bufferChanged();
+
+        TokenBuffer mBuffer; // The window, for subclasses that produce their own tokens.
+        size_t mWindowStart{0}; // Absolute index of mBuffer[0].
+
+    private:
+        TokenRef peekSlow(size_t k);
+
+        const TokenBuffer *mWindow{nullptr};
+        size_t mWindowFirst{0}; // Index in *mWindow of the token at mWindowStart.
+        size_t mWindowCount{0};
+        size_t mPosition{0};
+        bool mOwnsTokens{true};
+    };
+
+    //! Tokenizes a file in fixed-size chunks while the parser consumes it, so memory use is
+    //! bounded by the chunk size plus the tokens between the oldest mark and the current one.
+    //! Tokens never span a line break, so each chunk is cut after its last complete line. The
+    //! tokens of each chunk are append()ed to mBuffer, which keeps the text they need.
+    class FileTokenStream : public TokenStream {
+    public:
+        static constexpr size_t kDefaultChunkSize = 64 * 1024;
+
+        //! The file stays owned by the caller.
+        explicit FileTokenStream(FILE *file, size_t chunkSize = kDefaultChunkSize);
+
+        //! Reads from a file descriptor, which stays owned by the caller.
+        explicit FileTokenStream(int fileDescriptor, size_t chunkSize = kDefaultChunkSize);
+
+    protected:
+        bool refill() override;
+
+    private:
+        size_t readChunk(char *buffer, size_t size);
+
+        FILE *mFile{nullptr};
+        int mFileDescriptor{-1};
+        size_t mChunkSize;
+        string mPendingText; // Incomplete last line of the previous read.
+        Tokenizer mTokenizer;
+        size_t mLineNumber{1};
+        bool mAtEndOfFile{false};
+    };
+
+    //! Tokenizes a source on a thread of its own while the parser consumes its tokens, so on a
+    //! big source the two overlap instead of one waiting for the other to finish. The source is
+    //! cut into chunks after line breaks, like FileTokenStream's, and each chunk's tokens come
+    //! through a SingleProducerQueue of at most kQueueCapacity chunks, so the tokenizer never
+    //! gets far ahead. They are append()ed to mBuffer, which keeps them for rewinding as usual.
+    class PipelinedTokenStream : public TokenStream {
+    public:
+        static constexpr size_t kDefaultChunkSize = 64 * 1024;
+        static constexpr size_t kQueueCapacity = 8;
+
+        //! Starts tokenizing source, which must outlive the stream. See
+        //! Tokenizer::setCollectErrors() for collectErrors.
+        explicit PipelinedTokenStream(string_view source, bool collectErrors = false, size_t chunkSize = kDefaultChunkSize);
+
+        //! Stops tokenizing, if the parser didn't read everything.
+        ~PipelinedTokenStream() override;
+
+        PipelinedTokenStream(const PipelinedTokenStream &) = delete;
+
+        PipelinedTokenStream &operator=(const PipelinedTokenStream &) = delete;
+
+        //! Waits until the whole source has been tokenized, dropping tokens nobody read, and
+        //! rethrows what the tokenizer threw, if anything. After a parse, this tells whether
+        //! the source would have tokenized at all, however soon the parser stopped.
+        void finish();
+
+        //! What the tokenizer found wrong in the whole source, if collecting. Only complete
+        //! after finish().
+        const vector<Diagnostic> &errors() const { return mErrors; }
+
+        //! Of the whole source, after finish().
+        size_t tokenCount() const { return mTokenCount; }
+
+    protected:
+        bool refill() override;
+
+    private:
+        struct Chunk {
+            TokenBuffer mTokens; // Pointing into mSource.
+            exception_ptr mError; // What the tokenizer threw, in the last chunk.
+            bool mLast{false};
+        };
+
+        //! The tokenizer thread.
+        void tokenize();
+
+        //! Pops chunks up to the last one, and waits for the tokenizer thread to end.
+        void drain();
+
+        string_view mSource;
+        size_t mChunkSize;
+        Tokenizer mTokenizer; // Only used by the tokenizer thread, like mErrors until the last chunk.
+        vector<Diagnostic> mErrors;
+        SingleProducerQueue<Chunk> mQueue{kQueueCapacity};
+        atomic<bool> mStopping{false};
+        bool mAtLastChunk{false};
+        exception_ptr mError;
+        size_t mTokenCount{0};
+        thread mThread; // Last, so everything it uses exists before it starts.
+    };
+
+}
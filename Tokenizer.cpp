@@ -6,185 +6,140 @@ namespace simpleparser {
 
     using namespace std;
 
-    vector<Token> Tokenizer::parse(const std::string &inProgram) {
-        vector<Token> tokens;
-        Token currentToken;
-
-        currentToken.mLineNumber = 1;
-
-        for (char currCh : inProgram) {
-            if (currentToken.mType == STRING_ESCAPE_SEQUENCE) {
-                switch (currCh) {
-                    case 'n':
-                        currentToken.mText.append(1, '\n');
-                        break;
-                    case 'r':
-                        currentToken.mText.append(1, '\r');
-                        break;
-                    case 't':
-                        currentToken.mText.append(1, '\t');
-                        break;
-                    case '\\':
-                        currentToken.mText.append(1, '\\');
-                        break;
-                    default:
-                        throw runtime_error(string("unknown escape sequence: \\") + string(1, currCh) +
-                                            " in string on line " + to_string(currentToken.mLineNumber) + ".");
-                        break;
-                }
-                currentToken.mType = STRING_LITERAL;
-                continue;
-            } else if (currentToken.mType == POTENTIAL_COMMENT && currCh != '/') {
-                currentToken.mType = OPERATOR;
-                endToken(currentToken, tokens);
-                continue;
-            }
-
-            switch (currCh) {
-                case '0':
-                case '1':
-                case '2':
-                case '3':
-                case '4':
-                case '5':
-                case '6':
-                case '7':
-                case '8':
-                case '9':
-                    if (currentToken.mType == WHITESPACE) {
-                        currentToken.mType = INTEGER_LITERAL;
-                        currentToken.mText.append(1, currCh);
-                    } else if (currentToken.mType == POTENTIAL_DOUBLE) {
-                        currentToken.mType = DOUBLE_LITERAL;
-                        currentToken.mText.append(1, currCh);
-                    } else {
-                        currentToken.mText.append(1, currCh);
-                    }
+    TokenBuffer Tokenizer::parse(string_view inProgram, size_t firstLineNumber) {
+        TokenBuffer tokens(inProgram, firstLineNumber);
+        mErrors.clear();
+
+        const char *current = inProgram.data();
+        mSourceStart = current;
+        const char *end = current + inProgram.size();
+        const char *previousWordEnd = nullptr; // End of the last identifier or number.
+        size_t lineNumber = firstLineNumber;
+
+        while (current < end) {
+            const char *tokenStart = current;
+
+            switch (sCharacterClasses[uint8_t(*current)]) {
+                case SPACE_CHARACTER:
+                    current = mScanner->mSkipSpaces(current + 1, end);
                     break;
 
-                case '.':
-                    if (currentToken.mType == WHITESPACE) {
-                        currentToken.mType = POTENTIAL_DOUBLE;
-                        currentToken.mText.append(1, currCh);
-                    } else if (currentToken.mType == INTEGER_LITERAL) {
-                        currentToken.mType = DOUBLE_LITERAL;
-                        currentToken.mText.append(1, currCh);
-                    } else if (currentToken.mType == STRING_LITERAL) {
-                        currentToken.mText.append(1, currCh);
-                    } else {
-                        endToken(currentToken, tokens);
-                        currentToken.mType = OPERATOR;
-                        currentToken.mText.append(1, currCh);
-                        endToken(currentToken, tokens);
-                    }
+                case NEWLINE_CHARACTER:
+                    ++lineNumber;
+                    ++current;
                     break;
 
-                case '{':
-                case '}':
-                case '(':
-                case ')':
-                case '=':
-                case '+':
-                case '-':
-                case '*':
-                case '<':
-                case ';':
-                case ',':
-                    if (currentToken.mType != STRING_LITERAL) {
-                        endToken(currentToken, tokens);
-                        currentToken.mType = OPERATOR;
-                        currentToken.mText.append(1, currCh);
-                        endToken(currentToken, tokens);
-                    } else {
-                        currentToken.mText.append(1, currCh);
+                case DIGIT_CHARACTER: {
+                    TokenType type = INTEGER_LITERAL;
+                    current = mScanner->mSkipDigits(current + 1, end);
+                    if (current < end && *current == '.') {
+                        type = DOUBLE_LITERAL;
+                        current = mScanner->mSkipDigits(current + 1, end);
                     }
+                    tokens.add(type, TokenKind::NONE, size_t(tokenStart - mSourceStart), size_t(current - tokenStart));
+                    previousWordEnd = current;
                     break;
+                }
 
-                case ' ':
-                case '\t':
-                    if (currentToken.mType == STRING_LITERAL || currentToken.mType == COMMENT) {
-                        currentToken.mText.append(1, currCh);
+                case PERIOD_CHARACTER:
+                    // A period glued to the end of a word is an operator, otherwise it may start a number like ".5".
+                    if (previousWordEnd != current && current + 1 < end
+                        && sCharacterClasses[uint8_t(current[1])] == DIGIT_CHARACTER) {
+                        current = mScanner->mSkipDigits(current + 1, end);
+                        tokens.add(DOUBLE_LITERAL, TokenKind::NONE, size_t(tokenStart - mSourceStart), size_t(current - tokenStart));
+                        previousWordEnd = current;
                     } else {
-                        endToken(currentToken, tokens);
+                        ++current;
+                        tokens.add(OPERATOR, sOperatorKinds[uint8_t(*tokenStart)], size_t(tokenStart - mSourceStart), 1);
                     }
                     break;
 
-                case '\r':
-                case '\n':
-                    endToken(currentToken, tokens);
-                    ++currentToken.mLineNumber;
-                    break;
-
-                case '"':
-                    if (currentToken.mType != STRING_LITERAL) {
-                        endToken(currentToken, tokens);
-                        currentToken.mType = STRING_LITERAL;
-                    } else if (currentToken.mType == STRING_LITERAL) {
-                        endToken(currentToken, tokens);
-                    }
+                case OPERATOR_CHARACTER:
+                case BACKSLASH_CHARACTER:
+                    ++current;
+                    tokens.add(OPERATOR, sOperatorKinds[uint8_t(*tokenStart)], size_t(tokenStart - mSourceStart), 1);
                     break;
 
-                case '\\':
-                    if (currentToken.mType == STRING_LITERAL) {
-                        currentToken.mType = STRING_ESCAPE_SEQUENCE;
+                case SLASH_CHARACTER:
+                    if (current + 1 < end && current[1] == '/') {
+                        current = mScanner->mSkipCommentBody(current + 2, end);
                     } else {
-                        endToken(currentToken, tokens);
-                        currentToken.mType = OPERATOR;
-                        currentToken.mText.append(1, currCh);
-                        endToken(currentToken, tokens);
+                        ++current;
+                        tokens.add(OPERATOR, sOperatorKinds[uint8_t(*tokenStart)], size_t(tokenStart - mSourceStart), 1);
                     }
                     break;
 
-                case '/':
-                    if (currentToken.mType == STRING_LITERAL) {
-                        currentToken.mText.append(1, currCh);
-                    } else if (currentToken.mType == POTENTIAL_COMMENT) {
-                        currentToken.mType = COMMENT;
-                        currentToken.mText.erase();
-                    } else {
-                        endToken(currentToken, tokens);
-                        currentToken.mType = POTENTIAL_COMMENT;
-                        currentToken.mText.append(1, currCh);
-                    }
+                case QUOTE_CHARACTER:
+                    current = parseStringLiteral(current + 1, end, lineNumber, tokens);
                     break;
 
-                default:
-                    if (currentToken.mType == WHITESPACE || currentToken.mType == INTEGER_LITERAL
-                                                            || currentToken.mType == DOUBLE_LITERAL) {
-                        endToken(currentToken, tokens);
-                        currentToken.mType = IDENTIFIER;
-                        currentToken.mText.append(1, currCh);
-                    } else {
-                        currentToken.mText.append(1, currCh);
-                    }
+                case IDENTIFIER_CHARACTER: {
+                    current = mScanner->mSkipIdentifierBody(current + 1, end);
+                    string_view text(tokenStart, current - tokenStart);
+                    tokens.add(IDENTIFIER, keywordKind(text), size_t(tokenStart - mSourceStart), text.size());
+                    previousWordEnd = current;
                     break;
+                }
             }
         }
 
-        endToken(currentToken, tokens);
-
+        mSourceStart = nullptr;
         return tokens;
     }
 
+    //! current is just past the opening quote. Strings end at the closing quote or at the end of the line.
+    const char *Tokenizer::parseStringLiteral(const char *current, const char *end, size_t lineNumber, TokenBuffer &tokens) {
+        const char *textStart = current;
+        current = mScanner->mSkipStringBody(current, end);
 
-    void Tokenizer::endToken(Token &token, vector<Token> &tokens) {
-        if (token.mType == COMMENT) {
-            cout << "Ignoring comment " << token.mText << endl;
-        } else if (token.mType != WHITESPACE) {
-            tokens.push_back(token);
-        }
-        if (token.mType == POTENTIAL_DOUBLE) {
-            if (token.mText.compare(".") == 0) {
-                token.mType = OPERATOR;
-            } else {
-                token.mType = DOUBLE_LITERAL;
+        if (current < end && *current == '\\') {
+            // Escape sequences make the text differ from the source, so only these strings get copied.
+            string unescapedText(textStart, current);
+            while (current < end && *current == '\\') {
+                if (++current == end) {
+                    break;
+                }
+                switch (*current) {
+                    case 'n':
+                        unescapedText.append(1, '\n');
+                        break;
+                    case 'r':
+                        unescapedText.append(1, '\r');
+                        break;
+                    case 't':
+                        unescapedText.append(1, '\t');
+                        break;
+                    case '\\':
+                        unescapedText.append(1, '\\');
+                        break;
+                    default: {
+                        string message = string("unknown escape sequence: \\") + string(1, *current) +
+                                         " in string on line " + to_string(lineNumber) + ".";
+                        if (!mCollectErrors) {
+                            throw runtime_error(message);
+                        }
+                        mErrors.push_back(Diagnostic{lineNumber, std::move(message)});
+                        unescapedText.append(1, '\\');
+                        if (*current == '\n' || *current == '\r') {
+                            --current; // Leave the line break to parse(), which counts it. It ends the string.
+                        } else {
+                            unescapedText.append(1, *current);
+                        }
+                        break;
+                    }
+                }
+                const char *runStart = ++current;
+                current = mScanner->mSkipStringBody(current, end);
+                unescapedText.append(runStart, current);
             }
+            tokens.addUnescaped(size_t(textStart - mSourceStart), std::move(unescapedText));
+        } else {
+            tokens.add(STRING_LITERAL, TokenKind::NONE, size_t(textStart - mSourceStart), size_t(current - textStart));
         }
-        token.mType = WHITESPACE;
-        token.mText.erase();
-    }
 
-    void Token::debugPrint() const {
-        cout << "Token(" << sTokenTypeStrings[mType] << ", \"" << mText << "\", " << mLineNumber << ")" << endl;
+        if (current < end && *current == '"') {
+            ++current;
+        }
+        return current;
     }
 }
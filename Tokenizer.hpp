@@ -1,53 +1,38 @@
 #pragma once
 
+#include "CharacterScanner.hpp"
+#include "Diagnostic.hpp"
+#include "TokenBuffer.hpp"
+#include "TokenKind.hpp"
 #include <vector>
 #include <string>
+#include <string_view>
 
 namespace simpleparser {
 
     using namespace std;
 
-    enum TokenType {
-        WHITESPACE, // No token ever has this type.
-        IDENTIFIER,
-        INTEGER_LITERAL,
-        DOUBLE_LITERAL,
-        STRING_LITERAL,
-        OPERATOR,
-        STRING_ESCAPE_SEQUENCE,
-        POTENTIAL_DOUBLE,
-        POTENTIAL_COMMENT,
-        COMMENT
-    };
-
-    static const char *sTokenTypeStrings[] = {
-        "WHITESPACE",
-        "IDENTIFIER",
-        "INTEGER_LITERAL",
-        "DOUBLE_LITERAL",
-        "STRING_LITERAL",
-        "OPERATOR",
-        "STRING_ESCAPE_SEQUENCE",
-        "POTENTIAL_DOUBLE",
-        "POTENTIAL_COMMENT",
-        "COMMENT"
-    };
-
-    class Token {
+    class Tokenizer {
     public:
-        enum TokenType mType{WHITESPACE};
-        string mText;
-        size_t mLineNumber{0};
+        explicit Tokenizer(const CharacterScanner &scanner = CharacterScanner::best()) : mScanner(&scanner) {}
 
-        void debugPrint() const;
-    };
+        //! The returned tokens point into inProgram, which must outlive them.
+        TokenBuffer parse(string_view inProgram, size_t firstLineNumber = 1);
 
-    class Tokenizer {
-    public:
-        vector<Token> parse(const string &inProgram);
+        //! Normally an unknown escape sequence is thrown as a runtime_error. When collecting, it
+        //! is added to errors() and kept in the string as written.
+        void setCollectErrors(bool collectErrors) { mCollectErrors = collectErrors; }
+
+        //! What the last parse() found wrong, in source order.
+        const vector<Diagnostic> &errors() const { return mErrors; }
 
     private:
-        void endToken(Token &token, vector<Token> &tokens);
+        const char *parseStringLiteral(const char *current, const char *end, size_t lineNumber, TokenBuffer &tokens);
+
+        const CharacterScanner *mScanner;
+        const char *mSourceStart{nullptr}; // Of the source being tokenized, which offsets are relative to.
+        bool mCollectErrors{false};
+        vector<Diagnostic> mErrors;
     };
 
 }
@@ -0,0 +1,64 @@
+#include "TypeTable.hpp"
+#include <stdexcept>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    TypeTable &TypeTable::global() {
+        static TypeTable sTable;
+        return sTable;
+    }
+
+    TypeTable::TypeTable() {
+        intern(Type("void", VOID));
+        intern(Type("double", DOUBLE));
+        intern(Type("signed integer", INT32));
+        intern(Type("string", UINT8));
+    }
+
+    TypeTable::~TypeTable() {
+        for (atomic<Type *> &chunk : mChunks) {
+            delete[] chunk.load(memory_order_relaxed);
+        }
+    }
+
+    TypeID TypeTable::intern(const Type &type) {
+        // Fields first, since interning them takes the lock too.
+        vector<TypeID> fieldIDs;
+        fieldIDs.reserve(type.mFields.size());
+        for (const Type &field : type.mFields) {
+            fieldIDs.push_back(intern(field));
+        }
+
+        string key;
+        key.reserve(1 + type.mName.size() + 1 + 4 * fieldIDs.size());
+        key += char(type.mType);
+        key += type.mName;
+        key += '\0';
+        for (TypeID field : fieldIDs) {
+            key.append(reinterpret_cast<const char *>(&field.mIndex), sizeof(field.mIndex));
+        }
+
+        lock_guard<mutex> lock(mMutex);
+        auto found = mIDs.find(key);
+        if (found != mIDs.end()) {
+            return found->second;
+        }
+        size_t index = mSize.load(memory_order_relaxed);
+        if (index >= kMaxChunks * kChunkSize) {
+            throw length_error("Too many types.");
+        }
+        atomic<Type *> &chunk = mChunks[index >> kChunkBits];
+        if (!chunk.load(memory_order_relaxed)) {
+            chunk.store(new Type[kChunkSize], memory_order_release);
+        }
+        chunk.load(memory_order_relaxed)[index & (kChunkSize - 1)] = type;
+        TypeID id{uint32_t(index)};
+        mIDs.emplace(std::move(key), id);
+        mSize.store(index + 1, memory_order_release);
+        return id;
+    }
+
+}
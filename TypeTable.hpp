@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Type.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! A handle to a Type in the TypeTable. Two TypeIDs are equal exactly if their types are,
+    //! so comparing types is comparing integers.
+    class TypeID {
+    public:
+        uint32_t mIndex{0};
+
+        bool operator==(const TypeID &other) const = default;
+
+        //! The interned type, which never moves.
+        const Type &type() const;
+
+        BUILTIN_TYPE builtin() const { return type().mType; }
+
+        const string &name() const { return type().mName; }
+    };
+
+    //! Interns every Type the process uses, so each distinct type is stored once and everything
+    //! else holds a TypeID. Types are the same if their names, built-in types and field types
+    //! are, so STRUCTs are deduplicated by structure.
+    //!
+    //! Interning locks; looking up an interned type doesn't, since types live in chunks that are
+    //! never moved or freed while the table exists.
+    class TypeTable {
+    public:
+        //! Interned before anything else, so code can use them without a lookup.
+        static constexpr TypeID kVoid{0};
+        static constexpr TypeID kDouble{1};
+        static constexpr TypeID kInteger{2}; // Of integer literals.
+        static constexpr TypeID kString{3}; // Of string literals.
+
+        static TypeTable &global();
+
+        ~TypeTable();
+
+        TypeTable(const TypeTable &) = delete;
+
+        TypeTable &operator=(const TypeTable &) = delete;
+
+        //! Thread-safe. Throws a length_error once the table is full.
+        TypeID intern(const Type &type);
+
+        //! Thread-safe for any ID intern() returned.
+        const Type &get(TypeID id) const {
+            return mChunks[id.mIndex >> kChunkBits].load(memory_order_acquire)[id.mIndex & (kChunkSize - 1)];
+        }
+
+        size_t size() const { return mSize.load(memory_order_acquire); }
+
+    private:
+        static constexpr uint32_t kChunkBits = 8;
+        static constexpr uint32_t kChunkSize = uint32_t(1) << kChunkBits;
+        static constexpr size_t kMaxChunks = 4096;
+
+        TypeTable();
+
+        mutex mMutex;
+        unordered_map<string, TypeID> mIDs; // By name, built-in type and field IDs.
+        array<atomic<Type *>, kMaxChunks> mChunks{};
+        atomic<size_t> mSize{0};
+    };
+
+    inline const Type &TypeID::type() const {
+        return TypeTable::global().get(*this);
+    }
+
+}
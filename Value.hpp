@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Type.hpp"
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! What a Value holds. Programs compute with INT32 wrapping around and IEEE 754 doubles,
+    //! like ConstantValue, and only pass strings on to native functions.
+    enum class ValueKind : uint8_t {
+        INTEGER,
+        DOUBLE,
+        STRING
+    };
+
+    //! One number or string of a running program. Which member is set is known from the code
+    //! that made it, so Values carry no tag. A zeroed Value is 0 and 0.0 alike.
+    union Value {
+        int32_t mInteger;
+        double mDouble;
+        const string *mString;
+
+        static Value integer(int32_t value) {
+            Value result{};
+            result.mInteger = value;
+            return result;
+        }
+
+        static Value floating(double value) {
+            Value result;
+            result.mDouble = value;
+            return result;
+        }
+
+        static Value text(const string *value) {
+            Value result;
+            result.mString = value;
+            return result;
+        }
+    };
+
+    //! The kind variables of type are stored as. nullopt for types that can't hold a number.
+    inline optional<ValueKind> storageKind(BUILTIN_TYPE type) {
+        switch (type) {
+            case INT8:
+            case UINT8:
+            case INT32:
+            case UINT32:
+                return ValueKind::INTEGER;
+            case DOUBLE:
+                return ValueKind::DOUBLE;
+            default:
+                return nullopt;
+        }
+    }
+
+    //! Two's complement wrap-around, which C++20 defines for conversions to signed types.
+    inline int32_t wrapToInt32(int64_t value) {
+        return int32_t(uint32_t(uint64_t(value)));
+    }
+
+    //! Rounds towards zero like C. Values out of range, and NaN, give INT32_MIN, as x86's
+    //! cvttsd2si does, instead of being undefined.
+    inline int32_t doubleToInteger(double value) {
+        if (!(value > -2147483649.0 && value < 2147483648.0)) {
+            return INT32_MIN;
+        }
+        return int32_t(value);
+    }
+
+    //! What storing value in a variable of an integral type keeps of it. unsigned variables hold
+    //! the same 32 bits as int ones and compute like them.
+    inline int32_t narrowInteger(BUILTIN_TYPE type, int32_t value) {
+        switch (type) {
+            case INT8: return int8_t(value);
+            case UINT8: return uint8_t(value);
+            default: return value;
+        }
+    }
+
+    //! Throws a runtime_error on division by zero, which traps on most CPUs. INT32_MIN / -1,
+    //! which traps too, wraps around to INT32_MIN instead.
+    inline int32_t divideIntegers(int32_t lhs, int32_t rhs, string_view functionName) {
+        if (rhs == 0) {
+            throw runtime_error("Division by zero in " + string(functionName) + ".");
+        }
+        if (rhs == -1) {
+            return wrapToInt32(-int64_t(lhs));
+        }
+        return lhs / rhs;
+    }
+
+}
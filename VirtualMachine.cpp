@@ -0,0 +1,301 @@
+#include "VirtualMachine.hpp"
+#include "NativeFunctions.hpp"
+#include <stdexcept>
+#include <string>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    VirtualMachine::VirtualMachine(const Program &program, ostream &out)
+            : mProgram(program), mOut(&out), mStack(make_unique_for_overwrite<Value[]>(kStackSize)) {
+        mFrames.reserve(kMaxCallDepth);
+        mJitContext.mMachine = this;
+    }
+
+    void VirtualMachine::setJitCode(const JitCode *jit) {
+        mJitEntries.clear();
+        if (jit) {
+            for (size_t index = 0; index < mProgram.mFunctions.size(); ++index) {
+                mJitEntries.push_back(jit->entry(uint32_t(index)));
+            }
+        }
+    }
+
+    Value VirtualMachine::run(string_view functionName, span<const Value> arguments) {
+        optional<uint32_t> function = mProgram.findFunction(functionName);
+        if (!function) {
+            throw runtime_error("No function named " + string(functionName) + ".");
+        }
+        return run(*function, arguments);
+    }
+
+    static void checkFrameFits(const CompiledFunction &function, const Value *framePointer, const Value *stackEnd, size_t depth) {
+        if (depth >= VirtualMachine::kMaxCallDepth || size_t(stackEnd - framePointer) < size_t(function.mLocalCount) + function.mMaxStackDepth) {
+            throw runtime_error("Calls nested too deeply in " + function.mName + ".");
+        }
+    }
+
+    Value VirtualMachine::run(uint32_t functionIndex, span<const Value> arguments) {
+        const CompiledFunction *function = &mProgram.mFunctions.at(functionIndex);
+        if (arguments.size() != function->mParameterCount) {
+            throw runtime_error(function->mName + " takes " + to_string(function->mParameterCount) + " arguments, not "
+                                + to_string(arguments.size()) + ".");
+        }
+        mFrames.clear();
+        mCallDepth = 0;
+        mJitContext.mFailed = false;
+        Value *fp = mStack.get();
+        if (JitEntry entry = jitEntry(functionIndex)) {
+            mStackTop = fp;
+            callJit(entry, arguments.data());
+            return Value::integer(0);
+        }
+        checkFrameFits(*function, fp, fp + kStackSize, 0);
+        copy(arguments.begin(), arguments.end(), fp);
+        return interpret(function, fp);
+    }
+
+    void VirtualMachine::callJit(JitEntry entry, const Value *arguments) {
+        mJitContext.mCallDepth = uint32_t(mCallDepth);
+        entry(arguments, &mJitContext);
+        if (mJitContext.mFailed) {
+            throw runtime_error(mJitError);
+        }
+    }
+
+    void VirtualMachine::callFromJit(uint32_t functionIndex, const Value *arguments) {
+        const CompiledFunction &function = mProgram.mFunctions[functionIndex];
+        size_t callerDepth = mCallDepth;
+        uint32_t jitDepth = mJitContext.mCallDepth;
+        Value *callerStackTop = mStackTop;
+        Value *fp = mStackTop;
+        checkFrameFits(function, fp, mStack.get() + kStackSize, jitDepth);
+        copy(arguments, arguments + function.mParameterCount, fp);
+        mCallDepth = jitDepth;
+        interpret(&function, fp);
+        mCallDepth = callerDepth;
+        mJitContext.mCallDepth = jitDepth;
+        mStackTop = callerStackTop;
+    }
+
+    Value VirtualMachine::interpret(const CompiledFunction *function, Value *fp) {
+        Value *stackEnd = mStack.get() + kStackSize;
+        size_t callerFrames = mFrames.size();
+        ++mCallDepth;
+        Value *sp = fp + function->mLocalCount;
+        const uint32_t *pc = function->mCode.data();
+        const Value *constants = mProgram.mConstants.data();
+        const string *strings = mProgram.mStrings.data();
+        uint32_t instruction;
+
+#if SIMPLEPARSER_COMPUTED_GOTO
+        // In the order of Opcode.
+        static const void *const sHandlers[] = {
+            &&handle_PUSH_INTEGER, &&handle_PUSH_CONSTANT, &&handle_PUSH_STRING, &&handle_LOAD, &&handle_STORE,
+            &&handle_POP, &&handle_ADD_I, &&handle_SUBTRACT_I, &&handle_MULTIPLY_I, &&handle_DIVIDE_I,
+            &&handle_LESS_I, &&handle_NEGATE_I, &&handle_ADD_D, &&handle_SUBTRACT_D, &&handle_MULTIPLY_D,
+            &&handle_DIVIDE_D, &&handle_LESS_D, &&handle_NEGATE_D, &&handle_INTEGER_TO_DOUBLE,
+            &&handle_INTEGER_TO_DOUBLE_BELOW, &&handle_DOUBLE_TO_INTEGER, &&handle_WRAP_INT8, &&handle_WRAP_UINT8,
+            &&handle_JUMP, &&handle_JUMP_IF_NONZERO_I, &&handle_JUMP_IF_NONZERO_D, &&handle_JUMP_IF_LESS_I,
+            &&handle_JUMP_IF_LESS_D, &&handle_CALL, &&handle_CALL_NATIVE, &&handle_RETURN
+        };
+        static_assert(size(sHandlers) == size_t(Opcode::COUNT));
+#define HANDLE(opcode) handle_##opcode:
+#define NEXT() do { instruction = *pc++; goto *sHandlers[instruction & 0xFF]; } while (false)
+#define DISPATCH_LOOP NEXT();
+#define END_DISPATCH_LOOP
+#else
+#define HANDLE(opcode) case Opcode::opcode:
+#define NEXT() continue
+#define DISPATCH_LOOP for (;;) { instruction = *pc++; switch (Instruction::opcode(instruction)) {
+#define END_DISPATCH_LOOP default: throw runtime_error("Invalid instruction."); } }
+#endif
+#define OPERAND Instruction::operand(instruction)
+
+        DISPATCH_LOOP
+
+        HANDLE(PUSH_INTEGER) {
+            *sp++ = Value::integer(OPERAND);
+            NEXT();
+        }
+        HANDLE(PUSH_CONSTANT) {
+            *sp++ = constants[OPERAND];
+            NEXT();
+        }
+        HANDLE(PUSH_STRING) {
+            *sp++ = Value::text(&strings[OPERAND]);
+            NEXT();
+        }
+        HANDLE(LOAD) {
+            *sp++ = fp[OPERAND];
+            NEXT();
+        }
+        HANDLE(STORE) {
+            fp[OPERAND] = *--sp;
+            NEXT();
+        }
+        HANDLE(POP) {
+            --sp;
+            NEXT();
+        }
+        HANDLE(ADD_I) {
+            --sp;
+            sp[-1].mInteger = int32_t(uint32_t(sp[-1].mInteger) + uint32_t(sp[0].mInteger));
+            NEXT();
+        }
+        HANDLE(SUBTRACT_I) {
+            --sp;
+            sp[-1].mInteger = int32_t(uint32_t(sp[-1].mInteger) - uint32_t(sp[0].mInteger));
+            NEXT();
+        }
+        HANDLE(MULTIPLY_I) {
+            --sp;
+            sp[-1].mInteger = int32_t(uint32_t(sp[-1].mInteger) * uint32_t(sp[0].mInteger));
+            NEXT();
+        }
+        HANDLE(DIVIDE_I) {
+            --sp;
+            sp[-1].mInteger = divideIntegers(sp[-1].mInteger, sp[0].mInteger, function->mName);
+            NEXT();
+        }
+        HANDLE(LESS_I) {
+            --sp;
+            sp[-1].mInteger = (sp[-1].mInteger < sp[0].mInteger) ? 1 : 0;
+            NEXT();
+        }
+        HANDLE(NEGATE_I) {
+            sp[-1].mInteger = int32_t(0u - uint32_t(sp[-1].mInteger));
+            NEXT();
+        }
+        HANDLE(ADD_D) {
+            --sp;
+            sp[-1].mDouble += sp[0].mDouble;
+            NEXT();
+        }
+        HANDLE(SUBTRACT_D) {
+            --sp;
+            sp[-1].mDouble -= sp[0].mDouble;
+            NEXT();
+        }
+        HANDLE(MULTIPLY_D) {
+            --sp;
+            sp[-1].mDouble *= sp[0].mDouble;
+            NEXT();
+        }
+        HANDLE(DIVIDE_D) {
+            --sp;
+            sp[-1].mDouble /= sp[0].mDouble;
+            NEXT();
+        }
+        HANDLE(LESS_D) {
+            --sp;
+            sp[-1] = Value::integer((sp[-1].mDouble < sp[0].mDouble) ? 1 : 0);
+            NEXT();
+        }
+        HANDLE(NEGATE_D) {
+            sp[-1].mDouble = -sp[-1].mDouble;
+            NEXT();
+        }
+        HANDLE(INTEGER_TO_DOUBLE) {
+            sp[-1].mDouble = double(sp[-1].mInteger);
+            NEXT();
+        }
+        HANDLE(INTEGER_TO_DOUBLE_BELOW) {
+            sp[-2].mDouble = double(sp[-2].mInteger);
+            NEXT();
+        }
+        HANDLE(DOUBLE_TO_INTEGER) {
+            sp[-1] = Value::integer(doubleToInteger(sp[-1].mDouble));
+            NEXT();
+        }
+        HANDLE(WRAP_INT8) {
+            sp[-1].mInteger = int8_t(sp[-1].mInteger);
+            NEXT();
+        }
+        HANDLE(WRAP_UINT8) {
+            sp[-1].mInteger = uint8_t(sp[-1].mInteger);
+            NEXT();
+        }
+        HANDLE(JUMP) {
+            pc += OPERAND;
+            NEXT();
+        }
+        HANDLE(JUMP_IF_NONZERO_I) {
+            if ((--sp)->mInteger != 0) {
+                pc += OPERAND;
+            }
+            NEXT();
+        }
+        HANDLE(JUMP_IF_NONZERO_D) {
+            if ((--sp)->mDouble != 0) {
+                pc += OPERAND;
+            }
+            NEXT();
+        }
+        HANDLE(JUMP_IF_LESS_I) {
+            sp -= 2;
+            if (sp[0].mInteger < sp[1].mInteger) {
+                pc += OPERAND;
+            }
+            NEXT();
+        }
+        HANDLE(JUMP_IF_LESS_D) {
+            sp -= 2;
+            if (sp[0].mDouble < sp[1].mDouble) {
+                pc += OPERAND;
+            }
+            NEXT();
+        }
+        HANDLE(CALL) {
+            const CompiledFunction *callee = &mProgram.mFunctions[size_t(OPERAND)];
+            Value *calleeFp = sp - callee->mParameterCount;
+            if (JitEntry entry = jitEntry(uint32_t(OPERAND))) {
+                mStackTop = sp;
+                callJit(entry, calleeFp);
+                sp = calleeFp;
+                *sp++ = Value::integer(0);
+                NEXT();
+            }
+            checkFrameFits(*callee, calleeFp, stackEnd, mCallDepth);
+            ++mCallDepth;
+            mFrames.push_back(Frame{pc, fp, function});
+            function = callee;
+            fp = calleeFp;
+            sp = fp + callee->mLocalCount;
+            pc = callee->mCode.data();
+            NEXT();
+        }
+        HANDLE(CALL_NATIVE) {
+            const NativeCall &call = mProgram.mNativeCalls[size_t(OPERAND)];
+            size_t argumentCount = call.mArgumentKinds.size();
+            sp -= argumentCount;
+            *sp = call.mFunction->mCall(span<const Value>(sp, argumentCount), call.mArgumentKinds, *mOut);
+            ++sp;
+            NEXT();
+        }
+        HANDLE(RETURN) {
+            *fp = Value::integer(0);
+            --mCallDepth;
+            if (mFrames.size() == callerFrames) {
+                return *fp;
+            }
+            sp = fp + 1;
+            const Frame &caller = mFrames.back();
+            pc = caller.mReturnAddress;
+            fp = caller.mFramePointer;
+            function = caller.mFunction;
+            mFrames.pop_back();
+            NEXT();
+        }
+
+        END_DISPATCH_LOOP
+
+#undef HANDLE
+#undef NEXT
+#undef DISPATCH_LOOP
+#undef END_DISPATCH_LOOP
+#undef OPERAND
+    }
+
+}
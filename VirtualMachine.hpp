@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Bytecode.hpp"
+#include "JitCompiler.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if !defined(SIMPLEPARSER_SWITCH_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+#define SIMPLEPARSER_COMPUTED_GOTO 1
+#else
+#define SIMPLEPARSER_COMPUTED_GOTO 0
+#endif
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! Runs a Program. Each call gets a frame on one value stack: the arguments the caller
+    //! pushed become its first local slots, its other variables follow, and its operand stack
+    //! sits on top. Instructions are dispatched with computed goto where the compiler supports
+    //! it, each handler jumping straight to the next one, and with a switch elsewhere or in
+    //! builds with SIMPLEPARSER_SWITCH_DISPATCH. Functions with JitCode run that instead, and
+    //! interpreted and compiled functions can call each other.
+    class VirtualMachine {
+    public:
+        //! Deeper calls throw, since the language can't stop a runaway recursion any other way.
+        static constexpr size_t kMaxCallDepth = 1000;
+
+        //! Values on the stack, for all frames together.
+        static constexpr size_t kStackSize = size_t(1) << 20;
+
+        static constexpr bool usesComputedGoto() { return SIMPLEPARSER_COMPUTED_GOTO != 0; }
+
+        //! Native functions like printf write to out. program must outlive the VirtualMachine.
+        explicit VirtualMachine(const Program &program, ostream &out = cout);
+
+        VirtualMachine(const VirtualMachine &) = delete; // JIT code holds on to its address.
+
+        VirtualMachine &operator=(const VirtualMachine &) = delete;
+
+        //! Runs a function of the program with arguments of the kinds of its parameters and
+        //! returns its result. Throws a runtime_error if the function fails, e.g. divides by zero.
+        Value run(uint32_t function, span<const Value> arguments = {});
+
+        //! Throws a runtime_error if there is no function of that name.
+        Value run(string_view functionName, span<const Value> arguments = {});
+
+        //! From now on, runs the functions jit has code for with that code. jit must be compiled
+        //! from the same Program and outlive the VirtualMachine, or be nullptr to interpret all.
+        void setJitCode(const JitCode *jit);
+
+    private:
+        friend class JitCompiler;
+
+        class Frame {
+        public:
+            const uint32_t *mReturnAddress{nullptr};
+            Value *mFramePointer{nullptr};
+            const CompiledFunction *mFunction{nullptr};
+        };
+
+        //! Runs function until it returns to whoever called interpret. Its arguments are at
+        //! framePointer and mCallDepth calls are running.
+        Value interpret(const CompiledFunction *function, Value *framePointer);
+
+        JitEntry jitEntry(uint32_t function) const { return (function < mJitEntries.size()) ? mJitEntries[function] : nullptr; }
+
+        void callJit(JitEntry entry, const Value *arguments);
+
+        //! For JitCompiler's calls of functions without JIT code.
+        void callFromJit(uint32_t function, const Value *arguments);
+
+        const Program &mProgram;
+        ostream *mOut;
+        unique_ptr<Value[]> mStack;
+        vector<Frame> mFrames; // Of the callers of the running function.
+        size_t mCallDepth{0}; // Calls running, including those in JIT code.
+        vector<JitEntry> mJitEntries; // Per function, or empty without JitCode.
+        JitContext mJitContext;
+        string mJitError; // Of the call that set mJitContext.mFailed.
+        Value *mStackTop{nullptr}; // Where calls from JIT code can put their frames.
+    };
+
+}
@@ -0,0 +1,121 @@
+#include "WorkStealingScheduler.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    WorkStealingScheduler::WorkStealingScheduler(size_t threadCount) {
+        threadCount = max(threadCount, size_t(1));
+        for (size_t worker = 0; worker < threadCount; ++worker) {
+            mQueues.push_back(make_unique<WorkerQueue>());
+        }
+        for (size_t worker = 1; worker < threadCount; ++worker) {
+            mThreads.emplace_back(&WorkStealingScheduler::workerLoop, this, worker);
+        }
+    }
+
+    WorkStealingScheduler::~WorkStealingScheduler() {
+        {
+            lock_guard<mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mWorkAvailable.notify_all();
+        for (thread &workerThread : mThreads) {
+            workerThread.join();
+        }
+    }
+
+    void WorkStealingScheduler::run(size_t taskCount, const function<void(size_t)> &task) {
+        if (taskCount == 0) {
+            return;
+        }
+
+        lock_guard<mutex> runLock(mRunMutex);
+        mTask = &task;
+        mFirstError = nullptr;
+        mRemainingTasks = taskCount;
+        for (size_t index = 0; index < taskCount; ++index) {
+            WorkerQueue &queue = *mQueues[index % mQueues.size()];
+            lock_guard<mutex> lock(queue.mMutex);
+            queue.mTasks.push_back(index);
+        }
+
+        {
+            lock_guard<mutex> lock(mMutex);
+            ++mBatchNumber;
+        }
+        mWorkAvailable.notify_all();
+
+        runTasks(0);
+
+        unique_lock<mutex> lock(mMutex);
+        mBatchDone.wait(lock, [this] { return mRemainingTasks == 0; });
+        mTask = nullptr;
+        if (mFirstError) {
+            rethrow_exception(exchange(mFirstError, nullptr));
+        }
+    }
+
+    void WorkStealingScheduler::workerLoop(size_t worker) {
+        size_t batchesSeen = 0;
+        unique_lock<mutex> lock(mMutex);
+        while (true) {
+            mWorkAvailable.wait(lock, [&] { return mStopping || mBatchNumber != batchesSeen; });
+            if (mStopping) {
+                return;
+            }
+            batchesSeen = mBatchNumber;
+
+            lock.unlock();
+            runTasks(worker);
+            lock.lock();
+        }
+    }
+
+    void WorkStealingScheduler::runTasks(size_t worker) {
+        size_t task = 0;
+        while (takeTask(worker, task)) {
+            // Any task we got belongs to the running batch, so mTask is still valid.
+            try {
+                (*mTask)(task);
+            } catch (...) {
+                lock_guard<mutex> lock(mMutex);
+                if (!mFirstError) {
+                    mFirstError = current_exception();
+                }
+            }
+
+            if (mRemainingTasks.fetch_sub(1) == 1) {
+                lock_guard<mutex> lock(mMutex);
+                mBatchDone.notify_all();
+            }
+        }
+    }
+
+    bool WorkStealingScheduler::takeTask(size_t worker, size_t &task) {
+        {
+            WorkerQueue &ownQueue = *mQueues[worker];
+            lock_guard<mutex> lock(ownQueue.mMutex);
+            if (!ownQueue.mTasks.empty()) {
+                task = ownQueue.mTasks.front();
+                ownQueue.mTasks.pop_front();
+                return true;
+            }
+        }
+
+        // Steal from the back: the owner works from the front, so we rarely fight over a task.
+        for (size_t offset = 1; offset < mQueues.size(); ++offset) {
+            WorkerQueue &victim = *mQueues[(worker + offset) % mQueues.size()];
+            lock_guard<mutex> lock(victim.mMutex);
+            if (!victim.mTasks.empty()) {
+                task = victim.mTasks.back();
+                victim.mTasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+}
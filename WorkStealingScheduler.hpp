@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! A fixed set of worker threads that run batches of indexed tasks. Every worker has its
+    //! own queue and takes tasks from its front; a worker whose queue is empty steals from the
+    //! back of another one, so a few long tasks don't leave the other workers idle.
+    class WorkStealingScheduler {
+    public:
+        //! The calling thread of run() is one of the workers, so threadCount - 1 threads are started.
+        explicit WorkStealingScheduler(size_t threadCount = thread::hardware_concurrency());
+
+        ~WorkStealingScheduler();
+
+        WorkStealingScheduler(const WorkStealingScheduler &) = delete;
+
+        WorkStealingScheduler &operator=(const WorkStealingScheduler &) = delete;
+
+        size_t threadCount() const { return mQueues.size(); }
+
+        //! Calls task(0) to task(taskCount - 1) and returns once all of them have finished.
+        //! Tasks are dealt out in index order, so put the longest ones first. If tasks throw,
+        //! the first exception is rethrown after the others have finished.
+        void run(size_t taskCount, const function<void(size_t)> &task);
+
+    private:
+        struct WorkerQueue {
+            mutex mMutex;
+            deque<size_t> mTasks;
+        };
+
+        void workerLoop(size_t worker);
+
+        void runTasks(size_t worker);
+
+        bool takeTask(size_t worker, size_t &task);
+
+        vector<unique_ptr<WorkerQueue>> mQueues;
+        vector<thread> mThreads;
+
+        mutex mRunMutex; // One batch at a time.
+        mutex mMutex; // Guards everything below except mRemainingTasks.
+        condition_variable mWorkAvailable;
+        condition_variable mBatchDone;
+        const function<void(size_t)> *mTask{nullptr};
+        size_t mBatchNumber{0};
+        bool mStopping{false};
+        exception_ptr mFirstError;
+        atomic<size_t> mRemainingTasks{0};
+    };
+
+}
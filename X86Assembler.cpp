@@ -0,0 +1,290 @@
+#include "X86Assembler.hpp"
+#include <stdexcept>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    Label X86Assembler::newLabel() {
+        mLabelPositions.push_back(-1);
+        return Label{uint32_t(mLabelPositions.size() - 1)};
+    }
+
+    void X86Assembler::bind(Label label) {
+        mLabelPositions[label.mIndex] = int64_t(mCode.size());
+    }
+
+    vector<uint8_t> X86Assembler::finish() {
+        for (const Fixup &fixup : mFixups) {
+            int64_t target = mLabelPositions[fixup.mLabel];
+            if (target < 0) {
+                throw runtime_error("Jump to a label that was never bound.");
+            }
+            uint32_t displacement = uint32_t(target - int64_t(fixup.mPosition + 4));
+            for (size_t index = 0; index < 4; ++index) {
+                mCode[fixup.mPosition + index] = uint8_t(displacement >> (8 * index));
+            }
+        }
+        mFixups.clear();
+        return mCode;
+    }
+
+    void X86Assembler::encode(uint8_t prefix, bool wide, initializer_list<uint8_t> opcode, uint8_t reg, const Operand &rm,
+                              bool byteRegister) {
+        if (prefix != 0) {
+            emit8(prefix);
+        }
+        uint8_t rmRegister = rm.mIsMemory ? uint8_t(rm.mMemory.mBase) : rm.mRegister;
+        uint8_t rex = 0x40 | (wide ? 0x8 : 0) | ((reg & 8) ? 0x4 : 0) | ((rmRegister & 8) ? 0x1 : 0);
+        if (rex != 0x40 || (byteRegister && ((reg & 7) >= 4 || (!rm.mIsMemory && (rmRegister & 7) >= 4)))) {
+            emit8(rex);
+        }
+        for (uint8_t byte : opcode) {
+            emit8(byte);
+        }
+        if (!rm.mIsMemory) {
+            emit8(uint8_t(0xC0 | ((reg & 7) << 3) | (rmRegister & 7)));
+            return;
+        }
+        // Always with a displacement, since a base of RBP or R13 without one would mean RIP.
+        int32_t displacement = rm.mMemory.mDisplacement;
+        bool shortDisplacement = displacement >= -128 && displacement <= 127;
+        emit8(uint8_t((shortDisplacement ? 0x40 : 0x80) | ((reg & 7) << 3) | (rmRegister & 7)));
+        if ((rmRegister & 7) == 4) {
+            emit8(0x24); // A base of RSP or R12 needs a SIB byte.
+        }
+        if (shortDisplacement) {
+            emit8(uint8_t(displacement));
+        } else {
+            emit32(uint32_t(displacement));
+        }
+    }
+
+    void X86Assembler::emitJump(initializer_list<uint8_t> opcode, Label target) {
+        for (uint8_t byte : opcode) {
+            emit8(byte);
+        }
+        mFixups.push_back(Fixup{mCode.size(), target.mIndex});
+        emit32(0);
+    }
+
+    void X86Assembler::emit32(uint32_t value) {
+        for (size_t index = 0; index < 4; ++index) {
+            emit8(uint8_t(value >> (8 * index)));
+        }
+    }
+
+    void X86Assembler::emit64(uint64_t value) {
+        emit32(uint32_t(value));
+        emit32(uint32_t(value >> 32));
+    }
+
+    void X86Assembler::mov(Gpr destination, Operand source) {
+        if (!source.mIsMemory && source.mRegister == uint8_t(destination)) {
+            return;
+        }
+        encode(0, true, {0x8B}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::mov(Memory destination, Gpr source) {
+        encode(0, true, {0x89}, uint8_t(source), destination);
+    }
+
+    void X86Assembler::mov(Memory destination, int32_t immediate) {
+        encode(0, true, {0xC7}, 0, destination);
+        emit32(uint32_t(immediate));
+    }
+
+    void X86Assembler::movImmediate(Gpr destination, uint64_t immediate) {
+        uint8_t reg = uint8_t(destination);
+        if (immediate <= UINT32_MAX) {
+            if (reg & 8) {
+                emit8(0x41);
+            }
+            emit8(uint8_t(0xB8 + (reg & 7)));
+            emit32(uint32_t(immediate));
+            return;
+        }
+        emit8((reg & 8) ? 0x49 : 0x48);
+        emit8(uint8_t(0xB8 + (reg & 7)));
+        emit64(immediate);
+    }
+
+    void X86Assembler::lea(Gpr destination, Memory source) {
+        encode(0, true, {0x8D}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::add(Gpr destination, Operand source) {
+        encode(0, false, {0x03}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::add(Operand destination, int32_t immediate) {
+        encode(0, false, {0x81}, 0, destination);
+        emit32(uint32_t(immediate));
+    }
+
+    void X86Assembler::sub(Gpr destination, Operand source) {
+        encode(0, false, {0x2B}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::sub(Operand destination, int32_t immediate) {
+        encode(0, false, {0x81}, 5, destination);
+        emit32(uint32_t(immediate));
+    }
+
+    void X86Assembler::imul(Gpr destination, Operand source) {
+        encode(0, false, {0x0F, 0xAF}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::imul(Gpr destination, Operand source, int32_t immediate) {
+        encode(0, false, {0x69}, uint8_t(destination), source);
+        emit32(uint32_t(immediate));
+    }
+
+    void X86Assembler::cmp(Gpr left, Operand right) {
+        encode(0, false, {0x3B}, uint8_t(left), right);
+    }
+
+    void X86Assembler::cmp(Operand left, int32_t immediate) {
+        encode(0, false, {0x81}, 7, left);
+        emit32(uint32_t(immediate));
+    }
+
+    void X86Assembler::cmpByte(Memory left, int8_t immediate) {
+        encode(0, false, {0x80}, 7, left);
+        emit8(uint8_t(immediate));
+    }
+
+    void X86Assembler::test(Gpr left, Gpr right) {
+        encode(0, false, {0x85}, uint8_t(right), left);
+    }
+
+    void X86Assembler::neg(Gpr reg) {
+        encode(0, false, {0xF7}, 3, reg);
+    }
+
+    void X86Assembler::cdq() {
+        emit8(0x99);
+    }
+
+    void X86Assembler::idiv(Gpr divisor) {
+        encode(0, false, {0xF7}, 7, divisor);
+    }
+
+    void X86Assembler::set(Condition condition, Gpr destination) {
+        encode(0, false, {0x0F, uint8_t(0x90 + uint8_t(condition))}, 0, destination, true);
+    }
+
+    void X86Assembler::movzxByte(Gpr destination, Gpr source) {
+        encode(0, false, {0x0F, 0xB6}, uint8_t(destination), source, true);
+    }
+
+    void X86Assembler::movsxByte(Gpr destination, Gpr source) {
+        encode(0, false, {0x0F, 0xBE}, uint8_t(destination), source, true);
+    }
+
+    void X86Assembler::btc(Gpr reg, uint8_t bit) {
+        encode(0, true, {0x0F, 0xBA}, 7, reg);
+        emit8(bit);
+    }
+
+    void X86Assembler::add64(Gpr destination, int32_t immediate) {
+        encode(0, true, {0x81}, 0, destination);
+        emit32(uint32_t(immediate));
+    }
+
+    void X86Assembler::sub64(Gpr destination, int32_t immediate) {
+        encode(0, true, {0x81}, 5, destination);
+        emit32(uint32_t(immediate));
+    }
+
+    void X86Assembler::push(Gpr reg) {
+        if (uint8_t(reg) & 8) {
+            emit8(0x41);
+        }
+        emit8(uint8_t(0x50 + (uint8_t(reg) & 7)));
+    }
+
+    void X86Assembler::pop(Gpr reg) {
+        if (uint8_t(reg) & 8) {
+            emit8(0x41);
+        }
+        emit8(uint8_t(0x58 + (uint8_t(reg) & 7)));
+    }
+
+    void X86Assembler::call(Gpr target) {
+        encode(0, false, {0xFF}, 2, target);
+    }
+
+    void X86Assembler::call(Label target) {
+        emitJump({0xE8}, target);
+    }
+
+    void X86Assembler::jmp(Label target) {
+        emitJump({0xE9}, target);
+    }
+
+    void X86Assembler::j(Condition condition, Label target) {
+        emitJump({0x0F, uint8_t(0x80 + uint8_t(condition))}, target);
+    }
+
+    void X86Assembler::ret() {
+        emit8(0xC3);
+    }
+
+    void X86Assembler::movsd(Xmm destination, Operand source) {
+        if (!source.mIsMemory && source.mRegister == uint8_t(destination)) {
+            return;
+        }
+        encode(0xF2, false, {0x0F, 0x10}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::movsd(Memory destination, Xmm source) {
+        encode(0xF2, false, {0x0F, 0x11}, uint8_t(source), destination);
+    }
+
+    void X86Assembler::movq(Xmm destination, Gpr source) {
+        encode(0x66, true, {0x0F, 0x6E}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::movq(Gpr destination, Xmm source) {
+        encode(0x66, true, {0x0F, 0x7E}, uint8_t(source), destination);
+    }
+
+    void X86Assembler::addsd(Xmm destination, Operand source) {
+        encode(0xF2, false, {0x0F, 0x58}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::subsd(Xmm destination, Operand source) {
+        encode(0xF2, false, {0x0F, 0x5C}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::mulsd(Xmm destination, Operand source) {
+        encode(0xF2, false, {0x0F, 0x59}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::divsd(Xmm destination, Operand source) {
+        encode(0xF2, false, {0x0F, 0x5E}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::xorpd(Xmm destination, Xmm source) {
+        encode(0x66, false, {0x0F, 0x57}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::comisd(Xmm left, Operand right) {
+        encode(0x66, false, {0x0F, 0x2F}, uint8_t(left), right);
+    }
+
+    void X86Assembler::ucomisd(Xmm left, Operand right) {
+        encode(0x66, false, {0x0F, 0x2E}, uint8_t(left), right);
+    }
+
+    void X86Assembler::cvtsi2sd(Xmm destination, Operand source) {
+        encode(0xF2, false, {0x0F, 0x2A}, uint8_t(destination), source);
+    }
+
+    void X86Assembler::cvttsd2si(Gpr destination, Operand source) {
+        encode(0xF2, false, {0x0F, 0x2C}, uint8_t(destination), source);
+    }
+
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace simpleparser {
+
+    using namespace std;
+
+    //! General purpose registers, numbered as in their encoding.
+    enum class Gpr : uint8_t {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15
+    };
+
+    enum class Xmm : uint8_t {
+        XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7, XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15
+    };
+
+    //! The condition codes of Jcc and SETcc.
+    enum class Condition : uint8_t {
+        BELOW = 0x2,
+        ABOVE_OR_EQUAL = 0x3,
+        EQUAL = 0x4,
+        NOT_EQUAL = 0x5,
+        ABOVE = 0x7,
+        PARITY = 0xA,
+        LESS = 0xC,
+        GREATER_OR_EQUAL = 0xD
+    };
+
+    //! [mBase + mDisplacement].
+    class Memory {
+    public:
+        Gpr mBase{Gpr::RSP};
+        int32_t mDisplacement{0};
+    };
+
+    //! A register or a Memory operand, for instructions that take either.
+    class Operand {
+    public:
+        Operand(Gpr reg) : mRegister(uint8_t(reg)) {}
+
+        Operand(Xmm reg) : mRegister(uint8_t(reg)) {}
+
+        Operand(Memory memory) : mIsMemory(true), mMemory(memory) {}
+
+        bool mIsMemory{false};
+        uint8_t mRegister{0};
+        Memory mMemory;
+    };
+
+    //! A position in the code, possibly jumped to before it is bound.
+    class Label {
+    public:
+        uint32_t mIndex{0};
+    };
+
+    //! Encodes the x86-64 instructions JitCompiler needs. Operands are in Intel order, destination
+    //! first. Integer arithmetic is 32 bits wide, which is all INT32 needs, while moves between
+    //! general purpose registers and memory are 64 bits, so they also carry doubles and pointers.
+    class X86Assembler {
+    public:
+        Label newLabel();
+
+        void bind(Label label);
+
+        size_t size() const { return mCode.size(); }
+
+        //! The code with all jumps resolved. Throws a runtime_error if a label was never bound.
+        vector<uint8_t> finish();
+
+        void mov(Gpr destination, Operand source);
+
+        void mov(Memory destination, Gpr source);
+
+        //! Sign-extends immediate to 64 bits.
+        void mov(Memory destination, int32_t immediate);
+
+        //! Zero-extends immediate, with the shortest encoding that can.
+        void movImmediate(Gpr destination, uint64_t immediate);
+
+        void lea(Gpr destination, Memory source);
+
+        void add(Gpr destination, Operand source);
+
+        void add(Operand destination, int32_t immediate);
+
+        void sub(Gpr destination, Operand source);
+
+        void sub(Operand destination, int32_t immediate);
+
+        void imul(Gpr destination, Operand source);
+
+        void imul(Gpr destination, Operand source, int32_t immediate);
+
+        void cmp(Gpr left, Operand right);
+
+        void cmp(Operand left, int32_t immediate);
+
+        void cmpByte(Memory left, int8_t immediate);
+
+        void test(Gpr left, Gpr right);
+
+        void neg(Gpr reg);
+
+        //! Sign-extends EAX into EDX for idiv.
+        void cdq();
+
+        //! Divides EDX:EAX by divisor, leaving the quotient in EAX.
+        void idiv(Gpr divisor);
+
+        //! Sets the low byte of destination to 0 or 1.
+        void set(Condition condition, Gpr destination);
+
+        //! From the low byte of source.
+        void movzxByte(Gpr destination, Gpr source);
+
+        void movsxByte(Gpr destination, Gpr source);
+
+        //! Flips bit of the 64-bit register.
+        void btc(Gpr reg, uint8_t bit);
+
+        void add64(Gpr destination, int32_t immediate);
+
+        void sub64(Gpr destination, int32_t immediate);
+
+        void push(Gpr reg);
+
+        void pop(Gpr reg);
+
+        void call(Gpr target);
+
+        void call(Label target);
+
+        void jmp(Label target);
+
+        void j(Condition condition, Label target);
+
+        void ret();
+
+        void movsd(Xmm destination, Operand source);
+
+        void movsd(Memory destination, Xmm source);
+
+        void movq(Xmm destination, Gpr source);
+
+        void movq(Gpr destination, Xmm source);
+
+        void addsd(Xmm destination, Operand source);
+
+        void subsd(Xmm destination, Operand source);
+
+        void mulsd(Xmm destination, Operand source);
+
+        void divsd(Xmm destination, Operand source);
+
+        void xorpd(Xmm destination, Xmm source);
+
+        //! Compares left with right, setting the flags of an unsigned comparison.
+        void comisd(Xmm left, Operand right);
+
+        void ucomisd(Xmm left, Operand right);
+
+        //! From a 32-bit integer.
+        void cvtsi2sd(Xmm destination, Operand source);
+
+        //! Truncates to a 32-bit integer, giving INT32_MIN for NaN and values out of range.
+        void cvttsd2si(Gpr destination, Operand source);
+
+    private:
+        class Fixup {
+        public:
+            size_t mPosition{0}; // Of the 32-bit displacement.
+            uint32_t mLabel{0};
+        };
+
+        //! An instruction with a ModRM byte: prefix (if not 0), REX if needed, opcode, ModRM and
+        //! any SIB and displacement. byteRegister forces REX, so that registers 4 to 7 in an
+        //! 8-bit operation mean SPL to DIL rather than AH to BH.
+        void encode(uint8_t prefix, bool wide, initializer_list<uint8_t> opcode, uint8_t reg, const Operand &rm,
+                    bool byteRegister = false);
+
+        void emitJump(initializer_list<uint8_t> opcode, Label target);
+
+        void emit8(uint8_t byte) { mCode.push_back(byte); }
+
+        void emit32(uint32_t value);
+
+        void emit64(uint64_t value);
+
+        vector<uint8_t> mCode;
+        vector<int64_t> mLabelPositions; // -1 while unbound.
+        vector<Fixup> mFixups;
+    };
+
+}
@@ -1,42 +1,398 @@
+#include "AllocationCounter.hpp"
+#include "AstWriter.hpp"
+#include "BatchParser.hpp"
+#include "BytecodeCompiler.hpp"
+#include "JitCompiler.hpp"
+#include "MappedFile.hpp"
+#include "NameResolver.hpp"
+#include "ParseStats.hpp"
+#include "PassManager.hpp"
 #include "Tokenizer.hpp"
 #include "Parser.hpp"
+#include "VirtualMachine.hpp"
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 using namespace std;
 using namespace simpleparser;
 
-int main() {
+struct DriverOptions {
+    bool mDumpTokens{false};
+    bool mDumpAST{false};
+    AstFormat mAstFormat{AstFormat::PRETTY};
+    bool mCountAllocations{false};
+    bool mStats{false};
+    bool mOptimize{false};
+    bool mDumpBytecode{false};
+    bool mRun{false};
+    bool mJitAll{false};
+    vector<string> mJitFunctions;
+    bool mCheckJit{false};
+    size_t mJobCount{thread::hardware_concurrency()};
+    size_t mMaxNestingDepth{Parser::kDefaultMaxNestingDepth};
+    bool mPipelined{false};
+    string mCacheDirectory; // No cache if empty.
+    uint64_t mCacheLimit{AstCache::kDefaultMaxSize};
+};
+
+static void printUsage(ostream &out) {
+    out << "simpleparser 0.1\n\n"
+        << "Usage: simpleparser [options] <file or directory>...\n\n"
+        << "Directories are searched recursively for .myc files.\n\n"
+        << "  -q, --quiet      Only report errors (the default).\n"
+        << "  --dump-tokens    Print every token.\n"
+        << "  --dump-ast       Print the parsed functions.\n"
+        << "  --ast-format <pretty|json|sexpr>\n"
+        << "                   Print the parsed functions in this format. Implies --dump-ast.\n"
+        << "                   json prints one line per file.\n"
+        << "  --dump-bytecode  Print the functions compiled for --run.\n"
+        << "  --run            Run each file's main function, with its parameters 0.\n"
+        << "  --jit            Compile all functions to machine code for --run.\n"
+        << "  --jit-function <name>\n"
+        << "                   Compile only this function to machine code for --run.\n"
+        << "                   Can be given more than once.\n"
+        << "  --check-jit      Run main both interpreted and compiled to machine code, and\n"
+        << "                   report an error if the output differs.\n"
+        << "  --count-allocations\n"
+        << "                   Report heap allocations per token while parsing.\n"
+        << "                   Needs a build with SIMPLEPARSER_COUNT_ALLOCATIONS.\n"
+        << "  --stats          Report time per phase, token, node and production counts,\n"
+        << "                   and peak memory. Needs a build with SIMPLEPARSER_STATS.\n"
+        << "  -O, --optimize   Fold constants, drop identities like x * 1 and remove\n"
+        << "                   while loops that never run.\n"
+        << "  --max-nesting <n>\n"
+        << "                   Report expressions and loops nested more than n levels deep\n"
+        << "                   as errors (default " << Parser::kDefaultMaxNestingDepth << "). Deeper input needs more stack.\n"
+        << "  -j, --jobs <n>   Parse n files at a time (default: one per core).\n"
+        << "  --pipeline       Tokenize big files on a thread of their own while parsing them,\n"
+        << "                   instead of spreading their functions over all threads.\n"
+        << "  --cache <dir>    Reuse parse results of unchanged files from dir.\n"
+        << "  --cache-limit <megabytes>\n"
+        << "                   Delete the least recently used results beyond this (default 1024).\n"
+        << "  -h, --help       Show this help.\n";
+}
+
+static void addInputs(const string &path, vector<string> &inputs) {
+    if (!filesystem::is_directory(path)) {
+        inputs.push_back(path);
+        return;
+    }
+
+    vector<string> filesInDirectory;
+    for (const filesystem::directory_entry &entry : filesystem::recursive_directory_iterator(path)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".myc") {
+            filesInDirectory.push_back(entry.path().string());
+        }
+    }
+    sort(filesInDirectory.begin(), filesInDirectory.end()); // Same order on every run.
+    inputs.insert(inputs.end(), filesInDirectory.begin(), filesInDirectory.end());
+}
+
+//! What main printed, and the error it failed with, if any.
+static pair<string, string> runCapturingOutput(const Program &program, uint32_t entry, span<const Value> arguments,
+                                               const JitCode *jit) {
+    ostringstream out;
+    VirtualMachine machine(program, out);
+    machine.setJitCode(jit);
     try {
-        std::cout << "simpleparser 0.1\n" << endl;
+        machine.run(entry, arguments);
+    } catch (exception &err) {
+        return {out.str(), err.what()};
+    }
+    return {out.str(), ""};
+}
 
-        FILE *fh = fopen("D:\\CLionProjects\\ParserAndCompiler\\simpleparser\\test.myc", "r");
-        if (!fh) { cerr << "Can't find file." << endl; }
-        fseek(fh, 0, SEEK_END);
-        size_t fileSize = ftell(fh);
-        fseek(fh, 0, SEEK_SET);
-        string fileContents(fileSize, ' ');
-        fread(fileContents.data(), 1, fileSize, fh);
+static JitCode compileSelectedFunctions(const Program &program, const DriverOptions &options) {
+    if (options.mJitAll) {
+        return JitCompiler::compile(program);
+    }
+    vector<uint32_t> functions;
+    for (const string &name : options.mJitFunctions) {
+        optional<uint32_t> function = program.findFunction(name);
+        if (!function) {
+            throw runtime_error("No function named " + name + " to compile.");
+        }
+        functions.push_back(*function);
+    }
+    return JitCompiler::compile(program, functions);
+}
 
-        cout << fileContents << endl << endl;
+static void printErrors(const string &path, const vector<Diagnostic> &errors) {
+    for (const Diagnostic &error : errors) {
+        cerr << path;
+        if (error.mLineNumber != 0) {
+            cerr << ":" << error.mLineNumber;
+        }
+        cerr << ": Error: " << error.mMessage << endl;
+    }
+}
+
+//! Takes the functions out of result.
+static bool runFile(const string &path, ParseResult &result, const DriverOptions &options) {
+    map<string, FunctionDefinition> functions = result.mCachedAST ? result.mCachedAST->toFunctions()
+                                                                  : result.mParser.takeFunctions();
+    vector<Diagnostic> undefinedNames = NameResolver::resolve(functions);
+    if (!undefinedNames.empty()) {
+        printErrors(path, undefinedNames);
+        return false;
+    }
+    try {
+        Program program = BytecodeCompiler::compile(functions);
+        if (options.mDumpBytecode) {
+            program.disassemble(cout);
+        }
+        if (options.mRun) {
+            optional<uint32_t> entry = program.findFunction("main");
+            if (!entry) {
+                throw runtime_error("No main function to run.");
+            }
+            vector<Value> arguments(program.mFunctions[*entry].mParameterCount);
+            if (options.mCheckJit) {
+                auto [interpretedOutput, interpretedError] = runCapturingOutput(program, *entry, arguments, nullptr);
+                JitCode jit = JitCompiler::compile(program);
+                auto [compiledOutput, compiledError] = runCapturingOutput(program, *entry, arguments, &jit);
+                cout << interpretedOutput;
+                if (compiledOutput != interpretedOutput || compiledError != interpretedError) {
+                    throw runtime_error("The JIT code printed\n" + compiledOutput + "\nand failed with \"" + compiledError
+                                        + "\" instead.");
+                }
+                if (!interpretedError.empty()) {
+                    throw runtime_error(interpretedError);
+                }
+            } else {
+                JitCode jit;
+                if (options.mJitAll || !options.mJitFunctions.empty()) {
+                    jit = compileSelectedFunctions(program, options);
+                }
+                VirtualMachine machine(program);
+                machine.setJitCode(&jit);
+                machine.run(*entry, arguments);
+            }
+            cout.flush();
+        }
+    } catch (exception &err) {
+        cout.flush();
+        cerr << path << ": Error: " << err.what() << endl;
+        return false;
+    }
+    return true;
+}
+
+//! Reports errors itself, so one bad file doesn't stop the others from being reported.
+static bool reportFile(const string &path, ParseResult &result, const DriverOptions &options, AstWriter &astWriter,
+                       bool printFileName) {
+    // Other formats name the file in their own way.
+    bool prettyAST = options.mDumpAST && options.mAstFormat == AstFormat::PRETTY;
+    if (printFileName && result.mTokenized && (options.mDumpTokens || prettyAST)) {
+        cout << "// " << path << "\n";
+    }
+    if (options.mDumpTokens) {
+        for (size_t index = 0; index < result.mTokens.size(); ++index) {
+            result.mTokens.token(index).debugPrint();
+        }
+    }
+    cerr << result.mDiagnostics;
+    printErrors(path, result.mErrors);
+    if (!result.mError.empty()) {
+        cerr << path << ": Error: " << result.mError << endl;
+    }
+    if (!result.succeeded()) {
+        return false;
+    }
 
-        Tokenizer tokenizer;
-        vector<Token> tokens = tokenizer.parse(fileContents);
+    if (options.mCountAllocations) {
+        cerr << path << ": " << result.mAllocationCount << " allocations for " << result.mTokenCount << " tokens ("
+             << (result.mTokenCount == 0 ? 0.0 : double(result.mAllocationCount) / double(result.mTokenCount))
+             << " per token)\n";
+    }
+    if (options.mDumpAST) {
+        result.write(astWriter, (printFileName && !prettyAST) ? string_view(path) : string_view());
+    }
+    if (options.mDumpBytecode || options.mRun) {
+        return runFile(path, result, options);
+    }
+    return true;
+}
 
-        for(Token currToken : tokens) {
-            currToken.debugPrint();
+static size_t parseCount(string_view option, string_view argument) {
+    size_t count = 0;
+    for (char ch : argument) {
+        if (ch < '0' || ch > '9') {
+            throw runtime_error(string(option) + " needs a number, not " + string(argument) + ".");
         }
+        count = count * 10 + size_t(ch - '0');
+    }
+    if (argument.empty() || count == 0) {
+        throw runtime_error(string(option) + " needs a number above zero.");
+    }
+    return count;
+}
+
+static string_view optionValue(int argc, const char *argv[], int &i) {
+    if (i + 1 == argc) {
+        throw runtime_error(string(argv[i]) + " needs a value.");
+    }
+    return argv[++i];
+}
 
-        Parser parser;
-        parser.parse(tokens);
+int main(int argc, const char *argv[]) {
+    DriverOptions options;
+    vector<string> inputs;
 
-        parser.debugPrint();
-    } catch (exception& err) {
+    try {
+        for (int i = 1; i < argc; ++i) {
+            string_view argument(argv[i]);
+            if (argument == "-q" || argument == "--quiet") {
+                options.mDumpTokens = false;
+                options.mDumpAST = false;
+            } else if (argument == "--dump-tokens") {
+                options.mDumpTokens = true;
+            } else if (argument == "--dump-ast") {
+                options.mDumpAST = true;
+            } else if (argument == "--ast-format") {
+                string_view formatName = optionValue(argc, argv, i);
+                optional<AstFormat> format = astFormatNamed(formatName);
+                if (!format) {
+                    throw runtime_error("Unknown AST format " + string(formatName) + ".");
+                }
+                options.mAstFormat = *format;
+                options.mDumpAST = true;
+            } else if (argument == "--dump-bytecode") {
+                options.mDumpBytecode = true;
+            } else if (argument == "--run") {
+                options.mRun = true;
+            } else if (argument == "--jit" || argument == "--jit-function" || argument == "--check-jit") {
+                if (!JitCompiler::available()) {
+                    cerr << argument << " needs an x86-64 build.\n";
+                    return 1;
+                }
+                if (argument == "--jit") {
+                    options.mJitAll = true;
+                } else if (argument == "--jit-function") {
+                    options.mJitFunctions.emplace_back(optionValue(argc, argv, i));
+                } else {
+                    options.mCheckJit = true;
+                    options.mRun = true;
+                }
+            } else if (argument == "--count-allocations") {
+                if (!AllocationCounter::enabled()) {
+                    cerr << "--count-allocations needs a build with SIMPLEPARSER_COUNT_ALLOCATIONS=ON.\n";
+                    return 1;
+                }
+                options.mCountAllocations = true;
+            } else if (argument == "--stats") {
+                if (!ParseStats::enabled()) {
+                    cerr << "--stats needs a build with SIMPLEPARSER_STATS=ON.\n";
+                    return 1;
+                }
+                options.mStats = true;
+            } else if (argument == "-O" || argument == "--optimize") {
+                options.mOptimize = true;
+            } else if (argument == "-j" || argument == "--jobs") {
+                options.mJobCount = parseCount("--jobs", optionValue(argc, argv, i));
+            } else if (argument == "--max-nesting") {
+                options.mMaxNestingDepth = parseCount("--max-nesting", optionValue(argc, argv, i));
+            } else if (argument == "--pipeline") {
+                options.mPipelined = true;
+            } else if (argument == "--cache") {
+                options.mCacheDirectory = optionValue(argc, argv, i);
+            } else if (argument == "--cache-limit") {
+                options.mCacheLimit = uint64_t(parseCount("--cache-limit", optionValue(argc, argv, i))) << 20;
+            } else if (argument == "-h" || argument == "--help") {
+                printUsage(cout);
+                return 0;
+            } else if (argument.size() > 1 && argument[0] == '-') {
+                cerr << "Unknown option " << argument << ".\n\n";
+                printUsage(cerr);
+                return 1;
+            } else {
+                addInputs(string(argument), inputs);
+            }
+        }
+    } catch (exception &err) {
         cerr << "Error: " << err.what() << endl;
         return 2;
-    } catch (...) {
-        cerr << "Unknown Error." << endl;
+    }
+
+    if (inputs.empty()) {
+        printUsage(cerr);
         return 1;
     }
 
-    return 0;
+    ParseStats totalStats;
+    ParseStats *stats = options.mStats ? &totalStats : nullptr;
+
+    // Map everything up front, so the batch can start on the biggest files. Pages are only
+    // read when touched, so most of the reading shows up as tokenizing.
+    vector<unique_ptr<MappedFile>> files(inputs.size());
+    vector<string> openErrors(inputs.size());
+    vector<string_view> sources(inputs.size());
+    PhaseTimer readTimer(stats, ParsePhase::READ);
+    for (size_t index = 0; index < inputs.size(); ++index) {
+        try {
+            files[index] = make_unique<MappedFile>(inputs[index]);
+            sources[index] = files[index]->contents();
+        } catch (exception &err) {
+            openErrors[index] = err.what();
+        }
+    }
+    readTimer.stop();
+
+    unique_ptr<AstCache> cache;
+    if (!options.mCacheDirectory.empty()) {
+        try {
+            cache = make_unique<AstCache>(options.mCacheDirectory, options.mCacheLimit);
+        } catch (exception &err) {
+            cerr << "Error: Can't use cache: " << err.what() << endl;
+            return 2;
+        }
+    }
+
+    BatchParser batchParser(options.mJobCount);
+    batchParser.setKeepTokens(options.mDumpTokens);
+    batchParser.setCache(cache.get());
+    batchParser.setCollectErrors(true);
+    PassManager passes = PassManager::standard();
+    batchParser.setPasses(options.mOptimize ? &passes : nullptr);
+    batchParser.setCollectStats(options.mStats);
+    batchParser.setMaxNestingDepth(options.mMaxNestingDepth);
+    batchParser.setPipelined(options.mPipelined);
+    vector<ParseResult> results = batchParser.parse(sources);
+    if (cache) {
+        cache->trim();
+    }
+
+    unique_ptr<AstWriter> astWriter = AstWriter::create(options.mAstFormat, cout);
+    size_t failureCount = 0;
+    for (size_t index = 0; index < inputs.size(); ++index) {
+        if (!openErrors[index].empty()) {
+            results[index].mError = openErrors[index];
+        }
+        if (!reportFile(inputs[index], results[index], options, *astWriter, inputs.size() > 1)) {
+            ++failureCount;
+        }
+        if (stats) {
+            stats->merge(results[index].mStats);
+        }
+    }
+
+    if (stats) {
+        {
+            PhaseTimer teardownTimer(stats, ParsePhase::TEARDOWN);
+            results.clear();
+        }
+        stats->print(cerr);
+    }
+
+    return (failureCount == 0) ? 0 : 2;
 }